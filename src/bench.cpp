@@ -0,0 +1,317 @@
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "renderer.hpp"
+#include "headless.hpp"
+#include "camera_controller.hpp"
+#include "timing.hpp"
+
+struct BenchPath
+{
+    std::string name;
+    std::vector<Camera> cameras;
+};
+
+struct BenchResult
+{
+    std::string name;
+    uint32_t frameCount;
+    double meanMilliseconds;
+    double p50Milliseconds;
+    double p95Milliseconds;
+    double p99Milliseconds;
+    double maxMilliseconds;
+    double raysPerSecond;
+    // Counted by the cpu traversal at full resolution whatever the backend, so
+    // it does not reflect the gpu's level of detail or block raster.
+    double cpuStepsPerRay;
+};
+
+BenchOptions defaultBenchOptions()
+{
+    BenchOptions options{};
+    options.extent = VkExtent2D{800, 600};
+    options.framesPerPath = 120;
+    options.outputFile = "bench.json";
+    options.regressionTolerance = 0.05;
+    options.lod = true;
+    options.pixelOrder = DEFAULT_PIXEL_ORDER;
+    options.blockRaster = false;
+    return options;
+}
+
+// Every path is a pure function of the scene size and frame count, so runs on
+// the same scene are comparable.
+std::vector<BenchPath> createBenchPaths(VoxObject object, uint32_t frameCount)
+{
+    glm::vec3 size = glm::vec3(
+        object.blockScale * object.blockWidth,
+        object.blockScale * object.blockHeight,
+        object.blockScale * object.blockDepth);
+    glm::vec3 center = size * 0.5f;
+
+    BenchPath start{"start", {}};
+    BenchPath orbit{"orbit", {}};
+    BenchPath flyThrough{"fly-through", {}};
+    BenchPath fullDepth{"full-depth", {}};
+
+    for (uint32_t i = 0; i < frameCount; i++){
+        float t = (float)i / frameCount;
+
+        // The pose mainLoop starts in.
+        start.cameras.push_back(createStartCamera());
+
+        // A full circle around the scene looking at its center from above.
+        float angle = t * 2.0f * (float)M_PI;
+        float radius = 0.9f * std::max(size.x, size.z);
+        orbit.cameras.push_back(createLookAtCamera(
+            center + glm::vec3(radius * sinf(angle), 0.4f * size.y, radius * cosf(angle)),
+            center));
+
+        // Close to the ground along the x axis, rays graze the floor.
+        glm::vec3 flyPosition = glm::vec3(size.x * (t * 1.2f - 0.1f), 0.1f * size.y + 1.0f, center.z);
+        flyThrough.cameras.push_back(createLookAtCamera(flyPosition, flyPosition + glm::vec3(1.0f, -0.05f, 0.0f)));
+
+        // From in front of the grid along z, sweeping across so rays cross the whole depth.
+        glm::vec3 depthPosition = glm::vec3(center.x, center.y, -1.0f);
+        glm::vec3 depthTarget = glm::vec3(size.x * t, center.y * 0.5f, size.z);
+        fullDepth.cameras.push_back(createLookAtCamera(depthPosition, depthTarget));
+    }
+
+    return std::vector<BenchPath>{start, orbit, flyThrough, fullDepth};
+}
+
+uint64_t countPathSteps(WorkerPool *pool, const CpuScene *scene, BenchPath *path, VkExtent2D extent)
+{
+    uint64_t totalSteps = 0;
+    for (Camera camera : path->cameras){
+        CamInfoBuffer camInfo = createCamInfo(camera);
+        std::vector<uint64_t> rowSteps(extent.height);
+        parallelFor(pool, extent.height, [&](uint32_t row, uint32_t){
+            rowSteps[row] = cpuTraversalSteps(scene, &camInfo, extent.width, extent.height, row);
+        });
+        for (uint64_t steps : rowSteps)
+            totalSteps += steps;
+    }
+    return totalSteps;
+}
+
+BenchResult summarizeBenchPath(BenchPath *path, std::vector<double> frameMilliseconds, uint64_t steps, VkExtent2D extent)
+{
+    BenchResult result{};
+    result.name = path->name;
+    result.frameCount = frameMilliseconds.size();
+
+    double totalMilliseconds = 0;
+    for (double milliseconds : frameMilliseconds)
+        totalMilliseconds += milliseconds;
+    std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+
+    double rays = (double)extent.width * extent.height * result.frameCount;
+    result.meanMilliseconds = totalMilliseconds / result.frameCount;
+    result.p50Milliseconds = sortedPercentile(frameMilliseconds, 50);
+    result.p95Milliseconds = sortedPercentile(frameMilliseconds, 95);
+    result.p99Milliseconds = sortedPercentile(frameMilliseconds, 99);
+    result.maxMilliseconds = frameMilliseconds.back();
+    result.raysPerSecond = rays / (totalMilliseconds / 1000.0);
+    result.cpuStepsPerRay = steps / rays;
+    return result;
+}
+
+void writeBenchJson(std::string filename, std::string backend, VkExtent2D extent, const std::vector<BenchResult> &results)
+{
+    FILE *file;
+    if ((file = fopen(filename.c_str(), "w")) == NULL)
+        throw std::runtime_error("cant open bench output file " + filename);
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"backend\": \"%s\",\n", backend.c_str());
+    fprintf(file, "  \"width\": %u,\n", extent.width);
+    fprintf(file, "  \"height\": %u,\n", extent.height);
+    fprintf(file, "  \"paths\": [\n");
+    for (size_t i = 0; i < results.size(); i++){
+        const BenchResult &result = results[i];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"name\": \"%s\",\n", result.name.c_str());
+        fprintf(file, "      \"frames\": %u,\n", result.frameCount);
+        fprintf(file, "      \"mean_ms\": %.4f,\n", result.meanMilliseconds);
+        fprintf(file, "      \"p50_ms\": %.4f,\n", result.p50Milliseconds);
+        fprintf(file, "      \"p95_ms\": %.4f,\n", result.p95Milliseconds);
+        fprintf(file, "      \"p99_ms\": %.4f,\n", result.p99Milliseconds);
+        fprintf(file, "      \"max_ms\": %.4f,\n", result.maxMilliseconds);
+        fprintf(file, "      \"rays_per_second\": %.0f,\n", result.raysPerSecond);
+        fprintf(file, "      \"cpu_steps_per_ray\": %.3f\n", result.cpuStepsPerRay);
+        fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+    fclose(file);
+}
+
+// Reads a number field of the named path from json written by writeBenchJson.
+// Returns false if the baseline has no such path.
+bool readBaselineField(const std::string &json, std::string path, std::string field, double *value)
+{
+    size_t pathStart = json.find("\"name\": \"" + path + "\"");
+    if (pathStart == std::string::npos)
+        return false;
+    size_t pathEnd = json.find("}", pathStart);
+    size_t fieldStart = json.find("\"" + field + "\":", pathStart);
+    if (fieldStart == std::string::npos || fieldStart > pathEnd)
+        return false;
+
+    *value = strtod(json.c_str() + fieldStart + field.size() + 3, nullptr);
+    return true;
+}
+
+// Reads the backend written by writeBenchJson, empty if there is none.
+std::string readBaselineBackend(const std::string &json)
+{
+    std::string key = "\"backend\": \"";
+    size_t start = json.find(key);
+    if (start == std::string::npos)
+        return "";
+    start += key.size();
+    return json.substr(start, json.find("\"", start) - start);
+}
+
+// Cpu and gpu runs are never compared. Gpu runs with other options are, that is
+// how make bench-pixel-order and bench-block-raster measure them, but the
+// difference is printed so it is not mistaken for a regression.
+bool compareWithBaseline(
+    std::string baselineFile, std::string backend, const std::vector<BenchResult> &results, double tolerance)
+{
+    std::ifstream file(baselineFile);
+    if (!file)
+        throw std::runtime_error("cant open bench baseline file " + baselineFile);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string json = contents.str();
+
+    std::string baselineBackend = readBaselineBackend(json);
+    if (baselineBackend.substr(0, 4) != backend.substr(0, 4))
+        throw std::runtime_error(
+            "bench baseline " + baselineFile + " ran on " + baselineBackend + ", cant compare with " + backend);
+
+    bool passed = true;
+    printf("compared with %s:\n", baselineFile.c_str());
+    if (baselineBackend != backend)
+        printf("\tbaseline backend %s differs from %s\n", baselineBackend.c_str(), backend.c_str());
+    for (const BenchResult &result : results){
+        double baselineRays, baselineP99;
+        if (!readBaselineField(json, result.name, "rays_per_second", &baselineRays) ||
+            !readBaselineField(json, result.name, "p99_ms", &baselineP99)){
+            printf("\t%-12s not in baseline\n", result.name.c_str());
+            continue;
+        }
+
+        double raysChange = result.raysPerSecond / baselineRays - 1.0;
+        double p99Change = result.p99Milliseconds / baselineP99 - 1.0;
+        bool regressed = raysChange < -tolerance;
+        passed = passed && !regressed;
+        printf(
+            "\t%-12s rays/s %+6.1f%%  p99 %+6.1f%%%s\n",
+            result.name.c_str(), raysChange * 100.0, p99Change * 100.0,
+            regressed ? "  REGRESSION" : "");
+    }
+    return passed;
+}
+
+bool runBench(
+    BenchOptions options,
+    bool enableValidationLayers,
+    VoxObject object,
+    const unsigned char *voxBlocks,
+    MemPool<Palette> *palettes,
+    CpuRenderer *cpuRenderer)
+{
+    std::vector<BenchPath> paths = createBenchPaths(object, options.framesPerPath);
+    CpuScene scene = createCpuScene(object, voxBlocks, palettes);
+
+    Renderer renderer{};
+    std::string backend;
+    if (cpuRenderer != nullptr){
+        resizeCpuFramebuffer(&cpuRenderer->framebuffer, options.extent.width, options.extent.height);
+        backend = std::string("cpu-") + cpuRaycastPathName(cpuRenderer->path);
+    }else{
+        SceneLimits limits = voxObjectLimits(object, voxBlocks);
+        if (!options.lod)
+            limits.mipCount = 0;
+        limits.blockRaster = options.blockRaster;
+        renderer = createHeadlessRenderer(options.extent, limits, options.pixelOrder, enableValidationLayers, nullptr);
+        uploadVoxObject(&renderer, object, voxBlocks, palettes);
+        backend = std::string("gpu-") + pixelOrderName(options.pixelOrder) + (options.lod ? "" : "-no-lod") +
+            (options.blockRaster ? "-block-raster" : "");
+    }
+
+    // Traversal steps are counted on the cpu whichever backend renders.
+    WorkerPool stepPool;
+    WorkerPool *pool = cpuRenderer != nullptr ? cpuRenderer->pool : &stepPool;
+    if (cpuRenderer == nullptr)
+        startWorkerPool(&stepPool, 0);
+
+    // Gpu frames are timed with the profiler's timestamps, so they stay in flight
+    // and are read back asynchronously like in headless mode. Without timestamps
+    // each frame is waited on, readback included, and timed on the host.
+    bool gpuTimestamps = cpuRenderer == nullptr && renderer.profiler.timestampPool != VK_NULL_HANDLE;
+    if (cpuRenderer == nullptr && !gpuTimestamps)
+        printf("gpu has no timestamps, frames are timed on the host one at a time\n");
+
+    std::vector<BenchResult> results;
+    for (BenchPath &path : paths){
+        std::vector<double> frameMilliseconds(path.cameras.size());
+        std::vector<uint32_t> frameSlots(path.cameras.size());
+        OffscreenFrameCallback keepFrameTime = [&](int64_t frameId, const uint8_t *, VkExtent2D){
+            if (gpuTimestamps)
+                frameMilliseconds[frameId] = offscreenFrameGpuMilliseconds(&renderer, frameSlots[frameId]);
+        };
+        for (uint32_t i = 0; i < path.cameras.size(); i++){
+            CamInfoBuffer camInfo = createCamInfo(path.cameras[i]);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (cpuRenderer != nullptr){
+                renderCpuFrame(cpuRenderer, &camInfo);
+            }else{
+                frameSlots[i] = renderer.currentFrame;
+                drawOffscreenFrame(&renderer, &camInfo, i, keepFrameTime);
+                if (!gpuTimestamps)
+                    finishOffscreenFrames(&renderer, keepFrameTime);
+            }
+            if (!gpuTimestamps)
+                frameMilliseconds[i] = millisecondsSince(start);
+        }
+        if (cpuRenderer == nullptr)
+            finishOffscreenFrames(&renderer, keepFrameTime);
+
+        uint64_t steps = countPathSteps(pool, &scene, &path, options.extent);
+        results.push_back(summarizeBenchPath(&path, frameMilliseconds, steps, options.extent));
+
+        const BenchResult &result = results.back();
+        printf(
+            "%-12s p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms  %8.2f Mrays/s  %6.1f cpu reference steps/ray\n",
+            result.name.c_str(),
+            result.p50Milliseconds, result.p95Milliseconds, result.p99Milliseconds, result.maxMilliseconds,
+            result.raysPerSecond / 1e6, result.cpuStepsPerRay);
+    }
+
+    if (cpuRenderer == nullptr){
+        stopWorkerPool(&stepPool);
+        vkDeviceWaitIdle(renderer.device);
+        cleanupRenderer(&renderer);
+    }
+
+    writeBenchJson(options.outputFile, backend, options.extent, results);
+    printf("wrote %s\n", options.outputFile.c_str());
+
+    if (options.baselineFile.empty())
+        return true;
+    return compareWithBaseline(options.baselineFile, backend, results, options.regressionTolerance);
+}
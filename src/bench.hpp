@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "vox_object.hpp"
+#include "cpu/tile_renderer.hpp"
+#include "renderer.hpp"
+
+struct BenchOptions
+{
+    VkExtent2D extent;
+    uint32_t framesPerPath;
+    // Results are written here as json.
+    std::string outputFile;
+    // Results of an earlier run to compare against, empty to skip the comparison.
+    std::string baselineFile;
+    // Fraction rays per second may drop below the baseline before the run fails.
+    double regressionTolerance;
+    // Trace distant rays through the block mips on the gpu, see SceneLimits::mipCount.
+    bool lod;
+    PixelOrder pixelOrder;
+    // Start rays at the rasterized block bounding boxes, see SceneLimits::blockRaster.
+    bool blockRaster;
+};
+
+BenchOptions defaultBenchOptions();
+
+// Renders a fixed set of camera paths and reports frame time percentiles, rays
+// per second and, as a reference, the full resolution cpu traversal's steps per
+// ray. A cpuRenderer benchmarks the cpu backend, otherwise a headless Vulkan
+// renderer is used and timed on the gpu. Returns false if any path regressed
+// against the baseline, throws if the baseline ran on the other backend.
+bool runBench(
+    BenchOptions options,
+    bool enableValidationLayers,
+    VoxObject object,
+    const unsigned char *voxBlocks,
+    MemPool<Palette> *palettes,
+    CpuRenderer *cpuRenderer);
@@ -0,0 +1,70 @@
+#version 450
+
+// Draws the bounding box of every block in the grid into a depth buffer ahead of
+// shader.comp, whose rays then start at the nearest box instead of walking the
+// empty grid in front of it. The projection puts each pixel's centre on the ray
+// shader.comp casts for it, depth is reversed: NEAR_PLANE over the distance along
+// the view axis, 0 where no box was drawn.
+
+layout (binding = 1) uniform CamInfo{
+    vec4 pos;
+    mat4 rot;
+} camInfo;
+
+layout (binding = 4) readonly buffer ObjectInfo{
+	uint paletteIndex;
+	uint blockWidth;
+	uint blockHeight;
+	uint blockDepth;
+	uint blockIndices[];
+}objectInfo;
+
+// A VkDrawIndirectCommand drawing one box per gridBlocks entry, then the grid
+// index of every block that is not empty.
+layout (binding = 11) readonly buffer BlockBounds{
+	uint vertexCount;
+	uint instanceCount;
+	uint firstVertex;
+	uint firstInstance;
+	uint gridBlocks[];
+}blockBounds;
+
+layout (push_constant) uniform Target{
+	vec2 extent;
+} target;
+
+layout (constant_id = 0) const uint VOX_BLOCK_SCALE = 16;
+// BLOCK_RASTER_NEAR_PLANE and BLOCK_BOUNDS_MARGIN in shader.comp.
+const float NEAR_PLANE = 0.01;
+// Voxels each box grows by on every side, so rays grazing an edge are not missed.
+const float BOUNDS_MARGIN = 0.5;
+
+// Two triangles per face, corners with x in bit 0, y in bit 1 and z in bit 2.
+const int CUBE_CORNERS[36] = int[](
+	0, 2, 1, 1, 2, 3,
+	4, 5, 6, 5, 7, 6,
+	0, 1, 4, 1, 5, 4,
+	2, 6, 3, 3, 6, 7,
+	0, 4, 2, 2, 4, 6,
+	1, 3, 5, 3, 7, 5);
+
+void main(){
+	uint gridBlock = blockBounds.gridBlocks[gl_InstanceIndex];
+	vec3 blockPos = vec3(
+		gridBlock % objectInfo.blockWidth,
+		gridBlock / objectInfo.blockWidth % objectInfo.blockHeight,
+		gridBlock / (objectInfo.blockWidth * objectInfo.blockHeight));
+	uint corner = uint(CUBE_CORNERS[gl_VertexIndex]);
+	vec3 cornerOffset = vec3(corner & 1u, (corner >> 1) & 1u, corner >> 2);
+	vec3 cornerPos = (blockPos + cornerOffset) * float(VOX_BLOCK_SCALE) + (cornerOffset * 2.0 - 1.0) * BOUNDS_MARGIN;
+
+	vec3 view = transpose(mat3(camInfo.rot)) * (cornerPos - vec3(camInfo.pos));
+	float aspectRatio = target.extent.x / target.extent.y;
+	// shader.comp casts the ray of pixel p through the corner of the pixel, the
+	// rasterizer samples its centre half a pixel further.
+	gl_Position = vec4(
+		view.x / aspectRatio + view.z / target.extent.x,
+		-view.y + view.z / target.extent.y,
+		NEAR_PLANE,
+		view.z);
+}
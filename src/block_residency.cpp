@@ -0,0 +1,93 @@
+#include "block_residency.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+#include <stdexcept>
+
+ResidencyOptions defaultResidencyOptions()
+{
+    ResidencyOptions options{};
+    options.readbackInterval = 8;
+    options.evictAfterReadbacks = 16;
+    options.maxLoadsPerReadback = 1024;
+    options.budgetMegabytes = 0;
+    return options;
+}
+
+SceneLimits blockResidencyLimits(SceneLimits limits, ResidencyOptions options)
+{
+    limits.blockFeedback = true;
+    if (options.budgetMegabytes != 0){
+        uint64_t words = (uint64_t)options.budgetMegabytes * (1 << 20) / sizeof(uint32_t);
+        words = std::max<uint64_t>(words, encodedVoxBlockWords(limits.blockScale, VOX_BLOCK_ENCODING_RAW));
+        limits.voxBlockWords = std::min<uint64_t>(limits.voxBlockWords, words);
+    }
+    return limits;
+}
+
+void startBlockResidency(BlockResidency *residency, ResidencyOptions options, Renderer *renderer, const unsigned char *voxBlocks)
+{
+    if (!renderer->sceneLimits.blockFeedback)
+        throw std::runtime_error("block residency needs a renderer with block feedback");
+    residency->options = options;
+    residency->options.readbackInterval = std::max(1u, options.readbackInterval);
+    residency->voxBlocks = voxBlocks;
+    residency->frame = 0;
+    residency->readback = 0;
+    residency->lastNeeded = std::vector<uint32_t>(renderer->sceneLimits.voxBlockCount, 0);
+    residency->residentBlocks.clear();
+    residency->loads = 0;
+    residency->evictions = 0;
+    residency->moves = 0;
+    residency->deferredLoads = 0;
+}
+
+void updateBlockResidency(BlockResidency *residency, Renderer *renderer)
+{
+    if (++residency->frame % residency->options.readbackInterval != 0)
+        return;
+    if (!readBlockFeedback(renderer, &residency->feedback))
+        return;
+    uint32_t readback = ++residency->readback;
+
+    // Slots are taken and freed on the host right away, the gpu slot table is only
+    // written once the loads are uploaded and no frame is in flight.
+    ResidencyPlan plan = planBlockResidency(
+        residency->options, readback, residency->feedback, residency->voxBlocks, residency->residentBlocks,
+        &residency->lastNeeded, &renderer->voxBlockHeap, &renderer->voxBlockSlots);
+    residency->deferredLoads += plan.deferred;
+    if (plan.loaded.empty() && plan.evicted.empty())
+        return;
+
+    // Moved blocks are encoded into their new slot like loads.
+    uint32_t blockScale = renderer->sceneLimits.blockScale;
+    size_t blockSize = (size_t)blockScale * blockScale * blockScale;
+    std::vector<uint32_t> uploaded = plan.loaded;
+    uploaded.insert(uploaded.end(), plan.moved.begin(), plan.moved.end());
+    std::vector<const unsigned char *> uploadedVoxels;
+    for (uint32_t block : uploaded)
+        uploadedVoxels.push_back(residency->voxBlocks + block * blockSize);
+
+    vkQueueWaitIdle(renderer->computeAndPresentQueue);
+    updateBlocks(renderer, uploaded.size(), uploaded.data(), uploadedVoxels.data());
+    evictBlocks(renderer, plan.evicted.size(), plan.evicted.data());
+    residency->loads += plan.loaded.size();
+    residency->moves += plan.moved.size();
+    residency->evictions += plan.evicted.size();
+    residency->residentBlocks = std::move(plan.residentBlocks);
+}
+
+void printBlockResidencyStats(const BlockResidency *residency, Renderer *renderer)
+{
+    const VoxBlockHeap *heap = &renderer->voxBlockHeap;
+    printf(
+        "block residency: %zu of %u blocks resident, voxBlocks %.1f of %.1f MiB used, "
+        "%llu loads, %llu evictions, %llu moves to pack voxBlocks, %llu loads deferred for lack of room\n",
+        residency->residentBlocks.size(), renderer->sceneLimits.voxBlockCount,
+        (heap->top - heap->freeWords) * sizeof(uint32_t) / (1024.0 * 1024.0),
+        heap->capacity * sizeof(uint32_t) / (1024.0 * 1024.0),
+        (unsigned long long)residency->loads,
+        (unsigned long long)residency->evictions,
+        (unsigned long long)residency->moves,
+        (unsigned long long)residency->deferredLoads);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "renderer.hpp"
+#include "block_residency_plan.hpp"
+
+// Keeps only the blocks the image needs at full resolution in the voxBlocks
+// buffer. The shader reports every block it traces at level 0 in a feedback
+// bitmask and draws blocks that are not resident from their first mip. Every few
+// frames the feedback is read back, reported blocks are loaded and blocks not
+// reported for a while are evicted, so voxBlocks can be sized for what is on
+// screen rather than for the whole scene. See ResidencyOptions.
+ResidencyOptions defaultResidencyOptions();
+// limits with block feedback on and voxBlocks shrunk to the budget of options.
+SceneLimits blockResidencyLimits(SceneLimits limits, ResidencyOptions options);
+
+struct BlockResidency
+{
+    ResidencyOptions options;
+    // Every block of the pool back to back, see voxBlockBytes.
+    const unsigned char *voxBlocks;
+    uint64_t frame;
+    uint32_t readback;
+    std::vector<uint32_t> feedback;
+    // Readback each block was last reported in.
+    std::vector<uint32_t> lastNeeded;
+    std::vector<uint32_t> residentBlocks;
+
+    uint64_t loads;
+    uint64_t evictions;
+    // Resident blocks moved to another slot to gather free room for a load.
+    uint64_t moves;
+    // Blocks reported that did not fit, even after evicting the ones not reported.
+    uint64_t deferredLoads;
+};
+
+// renderer must have been created with blockResidencyLimits and the object
+// uploaded with uploadVoxObject, which leaves every block to be loaded.
+void startBlockResidency(BlockResidency *residency, ResidencyOptions options, Renderer *renderer, const unsigned char *voxBlocks);
+// Called once per frame from the render loop, between frames.
+void updateBlockResidency(BlockResidency *residency, Renderer *renderer);
+void printBlockResidencyStats(const BlockResidency *residency, Renderer *renderer);
@@ -0,0 +1,117 @@
+#include "block_residency_plan.hpp"
+
+#include <algorithm>
+
+// Frees a block's slot, as releaseBlock does for the renderer.
+void releasePlannedBlock(VoxBlockHeap *heap, std::vector<VoxBlockSlot> *slots, uint32_t block)
+{
+    if ((*slots)[block] != VOX_BLOCK_SLOT_NONE)
+        freeVoxBlockSlot(heap, (*slots)[block]);
+    (*slots)[block] = VOX_BLOCK_SLOT_NONE;
+}
+
+// Packs every slot to the bottom of heap, which merges the free runs into the
+// room above them. The blocks whose slot changes are added to moved.
+void packPlannedBlocks(VoxBlockHeap *heap, std::vector<VoxBlockSlot> *slots, std::vector<uint32_t> *moved)
+{
+    std::vector<uint32_t> placed;
+    for (uint32_t block = 0; block < slots->size(); block++)
+        if ((*slots)[block] != VOX_BLOCK_SLOT_NONE){
+            freeVoxBlockSlot(heap, (*slots)[block]);
+            placed.push_back(block);
+        }
+    for (uint32_t block : placed){
+        VoxBlockSlot slot = allocateVoxBlockSlot(heap, voxBlockSlotEncoding((*slots)[block]));
+        if (slot != (*slots)[block] && std::find(moved->begin(), moved->end(), block) == moved->end())
+            moved->push_back(block);
+        (*slots)[block] = slot;
+    }
+}
+
+ResidencyPlan planBlockResidency(
+    ResidencyOptions options,
+    uint32_t readback,
+    const std::vector<uint32_t> &feedback,
+    const unsigned char *voxBlocks,
+    const std::vector<uint32_t> &residentBlocks,
+    std::vector<uint32_t> *lastNeeded,
+    VoxBlockHeap *heap,
+    std::vector<VoxBlockSlot> *slots)
+{
+    uint32_t blockScale = heap->blockScale;
+    size_t blockSize = (size_t)blockScale * blockScale * blockScale;
+    ResidencyPlan plan{};
+
+    std::vector<uint32_t> wanted;
+    for (uint32_t word = 0; word < feedback.size(); word++){
+        uint32_t bits = feedback[word];
+        while (bits != 0){
+            uint32_t block = word * 32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (block >= lastNeeded->size())
+                continue;
+            (*lastNeeded)[block] = readback;
+            if ((*slots)[block] == VOX_BLOCK_SLOT_NONE)
+                wanted.push_back(block);
+        }
+    }
+
+    // Blocks not reported for long enough go, the others not reported this time
+    // make room for wanted blocks, oldest first. Freed slots of any encoding merge
+    // into runs a wanted block of another encoding can take, and if the runs stay
+    // too small the heap is packed.
+    std::vector<uint32_t> candidates;
+    for (uint32_t block : residentBlocks){
+        uint32_t age = readback - (*lastNeeded)[block];
+        if (age > options.evictAfterReadbacks)
+            plan.evicted.push_back(block);
+        else if (age > 0)
+            candidates.push_back(block);
+    }
+    if (plan.evicted.empty() && wanted.empty()){
+        plan.residentBlocks = residentBlocks;
+        return plan;
+    }
+    std::sort(candidates.begin(), candidates.end(), [lastNeeded](uint32_t a, uint32_t b){
+        return (*lastNeeded)[a] > (*lastNeeded)[b];
+    });
+
+    for (uint32_t block : plan.evicted)
+        releasePlannedBlock(heap, slots, block);
+
+    // Each load takes its slot as it is picked, so later loads see the room left.
+    // updateBlocks frees the slot before encoding the block into one of the same
+    // size, so it always finds room.
+    for (uint32_t block : wanted){
+        if (plan.loaded.size() == options.maxLoadsPerReadback)
+            break;
+        uint32_t encoding = chooseVoxBlockEncoding(voxBlocks + block * blockSize, blockScale);
+        while (!voxBlockHeapHasRoom(heap, encoding) && !candidates.empty()){
+            releasePlannedBlock(heap, slots, candidates.back());
+            plan.evicted.push_back(candidates.back());
+            candidates.pop_back();
+        }
+        // Rare, the room is there but split into runs too small for the block.
+        if (!voxBlockHeapHasRoom(heap, encoding) &&
+            voxBlockHeapFreeWords(heap) >= encodedVoxBlockWords(blockScale, encoding))
+            packPlannedBlocks(heap, slots, &plan.moved);
+        if (!voxBlockHeapHasRoom(heap, encoding)){
+            plan.deferred++;
+            continue;
+        }
+        (*slots)[block] = allocateVoxBlockSlot(heap, encoding);
+        plan.loaded.push_back(block);
+    }
+    // Loads are uploaded anyway.
+    plan.moved.erase(
+        std::remove_if(plan.moved.begin(), plan.moved.end(), [&plan](uint32_t block){
+            return std::find(plan.loaded.begin(), plan.loaded.end(), block) != plan.loaded.end();
+        }),
+        plan.moved.end());
+
+    for (uint32_t block : residentBlocks)
+        if ((*slots)[block] != VOX_BLOCK_SLOT_NONE)
+            plan.residentBlocks.push_back(block);
+    plan.residentBlocks.insert(plan.residentBlocks.end(), plan.loaded.begin(), plan.loaded.end());
+    return plan;
+}
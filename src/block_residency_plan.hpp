@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "vox_block_encoding.hpp"
+
+struct ResidencyOptions
+{
+    // Frames between feedback readbacks.
+    uint32_t readbackInterval;
+    // Resident blocks not reported for this many readbacks are evicted.
+    uint32_t evictAfterReadbacks;
+    // Blocks loaded per readback, bounds the stall of a single readback.
+    uint32_t maxLoadsPerReadback;
+    // Size of the voxBlocks buffer in MiB, 0 keeps room for the whole scene.
+    uint32_t budgetMegabytes;
+};
+
+// What one feedback readback of block residency loads and evicts, worked out on
+// the host alone so it can be checked without a gpu.
+struct ResidencyPlan
+{
+    std::vector<uint32_t> loaded;
+    std::vector<uint32_t> evicted;
+    // Resident blocks given another slot to pack the heap, uploaded again like loads.
+    std::vector<uint32_t> moved;
+    // Blocks with a slot, the loaded ones included.
+    std::vector<uint32_t> residentBlocks;
+    // Reported blocks that did not fit, even after evicting the ones not reported.
+    uint32_t deferred;
+};
+
+// feedback has a bit per pool block, lastNeeded the readback each block was last
+// reported in and is updated to readback. voxBlocks holds every block of the pool
+// back to back. Evicted blocks' slots are freed in heap and set to
+// VOX_BLOCK_SLOT_NONE in slots, loaded blocks get a slot in both.
+ResidencyPlan planBlockResidency(
+    ResidencyOptions options,
+    uint32_t readback,
+    const std::vector<uint32_t> &feedback,
+    const unsigned char *voxBlocks,
+    const std::vector<uint32_t> &residentBlocks,
+    std::vector<uint32_t> *lastNeeded,
+    VoxBlockHeap *heap,
+    std::vector<VoxBlockSlot> *slots);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Layout of the CamInfo uniform buffer in shader.comp.
+struct CamInfoBuffer
+{
+    glm::vec4 camPos;
+    glm::mat4 camRotMat;
+};
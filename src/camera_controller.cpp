@@ -36,6 +36,30 @@ glm::mat4 Camera::camToWorldRotMat()
     return glm::toMat4(camRotation);
 }
 
+Camera createStartCamera()
+{
+    Camera camera;
+    camera.position = glm::vec3(107.9, 52.4, 89.7);
+    camera.degreesRotation = glm::vec3(-125, -22, 0);
+    camera.speed = 30;
+    camera.rotateSpeed = 70;
+    return camera;
+}
+
+Camera createLookAtCamera(glm::vec3 position, glm::vec3 target)
+{
+    Camera camera = createStartCamera();
+    camera.position = position;
+
+    // Inverse of forwardDirection.
+    glm::vec3 direction = glm::normalize(target - position);
+    camera.degreesRotation = glm::vec3(
+        glm::degrees(atan2(direction.x, direction.z)),
+        glm::degrees(asin(direction.y)),
+        0);
+    return camera;
+}
+
 void updateCamera(Camera *camera, InputState inputState, float deltaTime)
 {
     if (inputState.d)
@@ -18,4 +18,8 @@ struct Camera
     glm::mat4 camToWorldRotMat();
 };
 
+// The pose the interactive viewer starts in, looking over scene.ply.
+Camera createStartCamera();
+// A camera at position whose forward direction points at target.
+Camera createLookAtCamera(glm::vec3 position, glm::vec3 target);
 void updateCamera(Camera *camera, InputState inputState, float deltaTime);
\ No newline at end of file
@@ -0,0 +1,441 @@
+#include "chunk_streamer.hpp"
+
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+
+#include "timing.hpp"
+
+// Generator voxel coordinate of world voxel 0 along x and z. The generator works
+// in unsigned coordinates, so the world starts far enough in for the camera to
+// wander off in any direction; noise stays exact well past twice this.
+const uint32_t STREAMING_WORLD_ORIGIN = 1 << 20;
+
+StreamingOptions defaultStreamingOptions()
+{
+    StreamingOptions options{};
+    options.radius = 8;
+    options.frameBudgetMilliseconds = 2.0;
+    options.coldChunkCapacity = 4096;
+    options.workerCount = 0;
+    return options;
+}
+
+uint32_t streamingWindowSide(StreamingOptions options)
+{
+    return options.radius * 2 + 1;
+}
+
+uint32_t streamingChunkHeight(SceneGeneratorOptions sceneOptions, uint32_t blockScale)
+{
+    return (sceneOptions.height + blockScale - 1) / blockScale;
+}
+
+size_t streamingWindowBlockCount(StreamingOptions options, SceneGeneratorOptions sceneOptions, uint32_t blockScale)
+{
+    size_t side = streamingWindowSide(options);
+    return side * side * streamingChunkHeight(sceneOptions, blockScale);
+}
+
+size_t streamingBlockCapacity(StreamingOptions options, SceneGeneratorOptions sceneOptions, uint32_t blockScale)
+{
+    // Retired blocks are held until the frames in flight are done with them, while
+    // each update places up to a batch more.
+    return streamingWindowBlockCount(options, sceneOptions, blockScale) +
+        (MAX_FRAMES_IN_FLIGHT + 1) * VOX_BLOCK_UPLOAD_BATCH;
+}
+
+SceneLimits streamingSceneLimits(StreamingOptions options, SceneGeneratorOptions sceneOptions, uint32_t blockScale)
+{
+    SceneLimits limits{};
+    limits.blockScale = blockScale;
+    limits.paletteCount = DEFAULT_PALETTE_ROWS;
+    limits.mipCount = voxBlockMipCount(blockScale);
+    limits.voxBlockCount = streamingBlockCapacity(options, sceneOptions, blockScale);
+    limits.objectBlockCount = streamingWindowBlockCount(options, sceneOptions, blockScale);
+    limits.streamed = true;
+    // Whatever gets streamed in has to fit, so every block gets room to be raw.
+    limits.voxBlockWords = std::min<uint64_t>(
+        (uint64_t)limits.voxBlockCount * encodedVoxBlockWords(blockScale, VOX_BLOCK_ENCODING_RAW), UINT32_MAX / 4);
+    return limits;
+}
+
+uint64_t chunkKey(int32_t x, int32_t z)
+{
+    return (uint64_t)(uint32_t)x << 32 | (uint32_t)z;
+}
+
+template<uint32_t N>
+bool chunkInWindow(const ChunkStreamer<N> *streamer, int32_t x, int32_t z)
+{
+    int64_t side = streamingWindowSide(streamer->options);
+    return x >= streamer->originX && x - (int64_t)streamer->originX < side &&
+        z >= streamer->originZ && z - (int64_t)streamer->originZ < side;
+}
+
+// Distance in chunks from the window's centre, along the longer axis.
+template<uint32_t N>
+int64_t chunkWindowDistance(const ChunkStreamer<N> *streamer, int32_t x, int32_t z)
+{
+    int64_t radius = streamer->options.radius;
+    return std::max(
+        std::abs(x - (streamer->originX + radius)),
+        std::abs(z - (streamer->originZ + radius)));
+}
+
+// Runs on a worker: decodes the chunk if it was cold, otherwise generates it.
+template<uint32_t N>
+void fillStreamedChunk(const ChunkStreamer<N> *streamer, StreamedChunk *chunk)
+{
+    uint32_t height = streamer->chunkHeight;
+    chunk->voxels.resize((size_t)height * sizeof(VoxBlock<N>));
+    chunk->empty.reset(new bool[height]);
+    VoxBlock<N> *blocks = (VoxBlock<N> *)chunk->voxels.data();
+
+    if (chunk->archived.empty()){
+        int32_t originBlock = STREAMING_WORLD_ORIGIN / N;
+        generateVoxBlockColumn<N>(
+            streamer->sceneOptions, (uint32_t)(chunk->x + originBlock), (uint32_t)(chunk->z + originBlock),
+            height, blocks, chunk->empty.get());
+        return;
+    }
+    for (uint32_t y = 0; y < height; y++){
+        chunk->empty[y] = chunk->archived[y].bytes.empty();
+        if (chunk->empty[y])
+            memset(&blocks[y], 0, sizeof(VoxBlock<N>));
+        else
+            unarchiveVoxBlock(&chunk->archived[y], N, blocks[y].voxels);
+    }
+    chunk->archived.clear();
+}
+
+template<uint32_t N>
+void runChunkGenerator(ChunkStreamer<N> *streamer)
+{
+    while (true){
+        std::vector<StreamedChunk> batch;
+        {
+            std::unique_lock<std::mutex> lock(streamer->mutex);
+            streamer->requested.wait(lock, [streamer]{
+                return streamer->stopping || !streamer->requests.empty();
+            });
+            if (streamer->stopping)
+                return;
+            // Small batches, so requests sorted again after the camera moves are seen soon.
+            while (!streamer->requests.empty() && batch.size() < streamer->workers.workerCount * 2){
+                batch.push_back(std::move(streamer->requests.front()));
+                streamer->requests.pop_front();
+            }
+        }
+
+        parallelFor(&streamer->workers, batch.size(), [streamer, &batch](uint32_t task, uint32_t){
+            fillStreamedChunk(streamer, &batch[task]);
+        });
+
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        for (StreamedChunk &chunk : batch)
+            streamer->finished.push_back(std::move(chunk));
+    }
+}
+
+template<uint32_t N>
+void storeColdChunk(ChunkStreamer<N> *streamer, uint64_t key, std::vector<ArchivedVoxBlock> blocks)
+{
+    if (streamer->options.coldChunkCapacity == 0)
+        return;
+    auto existing = streamer->coldChunks.find(key);
+    if (existing != streamer->coldChunks.end()){
+        streamer->coldOrder.erase(existing->second.order);
+        streamer->coldChunks.erase(existing);
+    }
+    streamer->coldOrder.push_back(key);
+    streamer->coldChunks[key] = ColdChunk{std::move(blocks), std::prev(streamer->coldOrder.end())};
+    if (streamer->coldChunks.size() > streamer->options.coldChunkCapacity){
+        streamer->coldChunks.erase(streamer->coldOrder.front());
+        streamer->coldOrder.pop_front();
+    }
+}
+
+// Moves a cold chunk's blocks out of the cold store, empty if it has none.
+template<uint32_t N>
+std::vector<ArchivedVoxBlock> takeColdChunk(ChunkStreamer<N> *streamer, uint64_t key)
+{
+    auto cold = streamer->coldChunks.find(key);
+    if (cold == streamer->coldChunks.end())
+        return std::vector<ArchivedVoxBlock>();
+    std::vector<ArchivedVoxBlock> blocks = std::move(cold->second.blocks);
+    streamer->coldOrder.erase(cold->second.order);
+    streamer->coldChunks.erase(cold);
+    return blocks;
+}
+
+template<uint32_t N>
+void writeChunkColumn(ChunkStreamer<N> *streamer, int32_t x, int32_t z, const std::vector<uint32_t> &blockIndices)
+{
+    VoxObject *window = streamer->window;
+    uint32_t windowX = x - streamer->originX;
+    uint32_t windowZ = z - streamer->originZ;
+    for (uint32_t y = 0; y < streamer->chunkHeight; y++)
+        window->blockIndices[windowX + y * window->blockWidth + windowZ * window->blockWidth * window->blockHeight] =
+            blockIndices[y];
+}
+
+// Archives a resident chunk into the cold store and retires its blocks, to be
+// given back once the frames in flight are done with them.
+template<uint32_t N>
+void retireChunk(ChunkStreamer<N> *streamer, Renderer *renderer, uint64_t key, const std::vector<uint32_t> &blockIndices)
+{
+    if (streamer->retiredBlocks.empty() || streamer->retiredBlocks.back().frame != renderer->submittedFrames)
+        streamer->retiredBlocks.push_back(RetiredBlocks{renderer->submittedFrames, {}});
+    std::vector<ArchivedVoxBlock> archived(streamer->chunkHeight);
+    for (uint32_t y = 0; y < streamer->chunkHeight; y++){
+        if (blockIndices[y] == 0)
+            continue;
+        uint32_t poolIndex = blockIndices[y] - 1;
+        archived[y] = archiveVoxBlock(streamer->voxBlocks->getBlock(poolIndex)->voxels, N);
+        streamer->retiredBlocks.back().poolIndices.push_back(poolIndex);
+    }
+    storeColdChunk(streamer, key, std::move(archived));
+}
+
+// Gives back the pool blocks and slots of retired chunks no frame can still read.
+template<uint32_t N>
+void releaseRetiredBlocks(ChunkStreamer<N> *streamer, Renderer *renderer)
+{
+    while (!streamer->retiredBlocks.empty() &&
+        framesFinishedBefore(renderer, streamer->retiredBlocks.front().frame)){
+        for (uint32_t poolIndex : streamer->retiredBlocks.front().poolIndices){
+            streamer->voxBlocks->freeBlock(poolIndex);
+            releaseBlock(renderer, poolIndex);
+        }
+        streamer->usedBlocks -= streamer->retiredBlocks.front().poolIndices.size();
+        streamer->retiredBlocks.pop_front();
+    }
+}
+
+// Centres the window on the camera's chunk, retiring the chunks it leaves and
+// requesting the ones it gains, nearest first.
+template<uint32_t N>
+void moveStreamingWindow(ChunkStreamer<N> *streamer, Renderer *renderer, int32_t originX, int32_t originZ)
+{
+    streamer->originX = originX;
+    streamer->originZ = originZ;
+
+    for (auto it = streamer->residentChunks.begin(); it != streamer->residentChunks.end();){
+        int32_t x = (int32_t)(it->first >> 32);
+        int32_t z = (int32_t)(uint32_t)it->first;
+        if (chunkInWindow(streamer, x, z)){
+            it++;
+            continue;
+        }
+        retireChunk(streamer, renderer, it->first, it->second);
+        it = streamer->residentChunks.erase(it);
+    }
+
+    VoxObject *window = streamer->window;
+    memset(window->blockIndices, 0,
+        (size_t)window->blockWidth * window->blockHeight * window->blockDepth * sizeof(uint32_t));
+    for (const auto &resident : streamer->residentChunks)
+        writeChunkColumn(streamer, (int32_t)(resident.first >> 32), (int32_t)(uint32_t)resident.first, resident.second);
+
+    std::lock_guard<std::mutex> lock(streamer->mutex);
+    // Requests that left the window are dropped, their cold blocks go back.
+    std::deque<StreamedChunk> kept;
+    for (StreamedChunk &request : streamer->requests){
+        if (chunkInWindow(streamer, request.x, request.z)){
+            kept.push_back(std::move(request));
+            continue;
+        }
+        uint64_t key = chunkKey(request.x, request.z);
+        streamer->pendingChunks.erase(key);
+        if (!request.archived.empty())
+            storeColdChunk(streamer, key, std::move(request.archived));
+    }
+    streamer->requests = std::move(kept);
+
+    uint32_t side = streamingWindowSide(streamer->options);
+    for (uint32_t windowZ = 0; windowZ < side; windowZ++)
+        for (uint32_t windowX = 0; windowX < side; windowX++){
+            int32_t x = originX + (int32_t)windowX;
+            int32_t z = originZ + (int32_t)windowZ;
+            uint64_t key = chunkKey(x, z);
+            if (streamer->residentChunks.count(key) != 0 || streamer->pendingChunks.count(key) != 0)
+                continue;
+            StreamedChunk request{};
+            request.x = x;
+            request.z = z;
+            request.archived = takeColdChunk(streamer, key);
+            streamer->requests.push_back(std::move(request));
+            streamer->pendingChunks.insert(key);
+        }
+    std::stable_sort(
+        streamer->requests.begin(), streamer->requests.end(),
+        [streamer](const StreamedChunk &a, const StreamedChunk &b){
+            return chunkWindowDistance(streamer, a.x, a.z) < chunkWindowDistance(streamer, b.x, b.z);
+        });
+    streamer->requested.notify_one();
+}
+
+// Copies a finished chunk into the pool and the window, adding its blocks to the
+// upload. Chunks the window has moved away from go to the cold store instead.
+template<uint32_t N>
+void placeStreamedChunk(
+    ChunkStreamer<N> *streamer,
+    StreamedChunk *chunk,
+    std::vector<uint32_t> *uploadIndices,
+    std::vector<const unsigned char *> *uploadVoxels)
+{
+    uint64_t key = chunkKey(chunk->x, chunk->z);
+    streamer->pendingChunks.erase(key);
+    const VoxBlock<N> *blocks = (const VoxBlock<N> *)chunk->voxels.data();
+
+    if (!chunkInWindow(streamer, chunk->x, chunk->z)){
+        std::vector<ArchivedVoxBlock> archived(streamer->chunkHeight);
+        for (uint32_t y = 0; y < streamer->chunkHeight; y++)
+            if (!chunk->empty[y])
+                archived[y] = archiveVoxBlock(blocks[y].voxels, N);
+        storeColdChunk(streamer, key, std::move(archived));
+        return;
+    }
+
+    std::vector<uint32_t> blockIndices(streamer->chunkHeight, 0);
+    for (uint32_t y = 0; y < streamer->chunkHeight; y++){
+        if (chunk->empty[y])
+            continue;
+        size_t poolIndex = streamer->voxBlocks->allocateBlock();
+        streamer->usedBlocks++;
+        VoxBlock<N> *block = streamer->voxBlocks->getBlock(poolIndex);
+        memcpy(block, &blocks[y], sizeof(VoxBlock<N>));
+        blockIndices[y] = poolIndex + 1;
+        uploadIndices->push_back(poolIndex);
+        uploadVoxels->push_back(block->voxels);
+    }
+    writeChunkColumn(streamer, chunk->x, chunk->z, blockIndices);
+    streamer->residentChunks[key] = std::move(blockIndices);
+}
+
+template<uint32_t N>
+void startChunkStreaming(
+    ChunkStreamer<N> *streamer,
+    StreamingOptions options,
+    SceneGeneratorOptions sceneOptions,
+    MemPool<VoxBlock<N>> *voxBlocks,
+    MemPool<Palette> *palettes,
+    VoxObject *window)
+{
+    streamer->options = options;
+    streamer->sceneOptions = sceneOptions;
+    streamer->sceneOptions.width = UINT32_MAX;
+    streamer->sceneOptions.depth = UINT32_MAX;
+    streamer->chunkHeight = streamingChunkHeight(sceneOptions, N);
+    if (streamer->chunkHeight > VOX_BLOCK_UPLOAD_BATCH)
+        throw std::runtime_error("streamed chunks are taller than an upload batch");
+    streamer->voxBlocks = voxBlocks;
+    streamer->blockCapacity = streamingBlockCapacity(options, sceneOptions, N);
+    streamer->usedBlocks = 0;
+    streamer->uploadBlockMilliseconds = 0;
+
+    window->paletteIndex = palettes->allocateBlock();
+    fillPalette(palettes->getBlock(window->paletteIndex));
+    streamer->palette = palettes->getBlock(window->paletteIndex);
+    window->blockScale = N;
+    window->blockWidth = streamingWindowSide(options);
+    window->blockHeight = streamer->chunkHeight;
+    window->blockDepth = streamingWindowSide(options);
+    window->blockIndices = (uint32_t *)calloc(streamingWindowBlockCount(options, sceneOptions, N), sizeof(uint32_t));
+    streamer->window = window;
+
+    // No chunk is at this origin, so the first update always moves the window.
+    streamer->originX = INT32_MIN;
+    streamer->originZ = INT32_MIN;
+    streamer->paletteRow = UINT32_MAX;
+    streamer->stopping = false;
+
+    startWorkerPool(&streamer->workers, options.workerCount);
+    streamer->generator = std::thread(runChunkGenerator<N>, streamer);
+}
+
+template<uint32_t N>
+void stopChunkStreaming(ChunkStreamer<N> *streamer)
+{
+    {
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        streamer->stopping = true;
+    }
+    streamer->requested.notify_one();
+    streamer->generator.join();
+    stopWorkerPool(&streamer->workers);
+}
+
+template<uint32_t N>
+void updateChunkStreaming(ChunkStreamer<N> *streamer, Renderer *renderer, glm::vec3 cameraPosition)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (streamer->paletteRow == UINT32_MAX)
+        streamer->paletteRow = updatePalette(renderer, streamer->palette);
+
+    int32_t radius = streamer->options.radius;
+    int32_t originX = (int32_t)floorf(cameraPosition.x / N) - radius;
+    int32_t originZ = (int32_t)floorf(cameraPosition.z / N) - radius;
+    bool moving = originX != streamer->originX || originZ != streamer->originZ;
+    bool chunksFinished;
+    {
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        chunksFinished = !streamer->finished.empty();
+    }
+    releaseRetiredBlocks(streamer, renderer);
+    if (!moving && !chunksFinished)
+        return;
+
+    if (moving)
+        moveStreamingWindow(streamer, renderer, originX, originZ);
+
+    // Chunks stay finished while the pool is short of blocks, retired ones come
+    // back within a few frames.
+    std::vector<uint32_t> uploadIndices;
+    std::vector<const unsigned char *> uploadVoxels;
+    while (uploadIndices.size() + streamer->chunkHeight <= VOX_BLOCK_UPLOAD_BATCH &&
+        streamer->usedBlocks + streamer->chunkHeight <= streamer->blockCapacity){
+        StreamedChunk chunk;
+        {
+            std::lock_guard<std::mutex> lock(streamer->mutex);
+            if (streamer->finished.empty())
+                break;
+            chunk = std::move(streamer->finished.front());
+            streamer->finished.pop_front();
+        }
+        placeStreamedChunk(streamer, &chunk, &uploadIndices, &uploadVoxels);
+        // The upload encodes the placed blocks, at the cost per block the last one had.
+        double uploadMilliseconds = uploadIndices.size() * streamer->uploadBlockMilliseconds;
+        if (millisecondsSince(start) + uploadMilliseconds >= streamer->options.frameBudgetMilliseconds)
+            break;
+    }
+
+    std::chrono::steady_clock::time_point uploadStart = std::chrono::steady_clock::now();
+    streamObjectUpdate(
+        renderer, uploadIndices.size(), uploadIndices.data(), uploadVoxels.data(),
+        *streamer->window, streamer->paletteRow);
+    if (!uploadIndices.empty())
+        streamer->uploadBlockMilliseconds = millisecondsSince(uploadStart) / uploadIndices.size();
+}
+
+template<uint32_t N>
+glm::vec3 streamingWindowPosition(const ChunkStreamer<N> *streamer, glm::vec3 position)
+{
+    return position - glm::vec3((float)streamer->originX * N, 0, (float)streamer->originZ * N);
+}
+
+template void startChunkStreaming<8>(ChunkStreamer<8> *, StreamingOptions, SceneGeneratorOptions, MemPool<VoxBlock<8>> *, MemPool<Palette> *, VoxObject *);
+template void startChunkStreaming<16>(ChunkStreamer<16> *, StreamingOptions, SceneGeneratorOptions, MemPool<VoxBlock<16>> *, MemPool<Palette> *, VoxObject *);
+template void startChunkStreaming<32>(ChunkStreamer<32> *, StreamingOptions, SceneGeneratorOptions, MemPool<VoxBlock<32>> *, MemPool<Palette> *, VoxObject *);
+template void stopChunkStreaming<8>(ChunkStreamer<8> *);
+template void stopChunkStreaming<16>(ChunkStreamer<16> *);
+template void stopChunkStreaming<32>(ChunkStreamer<32> *);
+template void updateChunkStreaming<8>(ChunkStreamer<8> *, Renderer *, glm::vec3);
+template void updateChunkStreaming<16>(ChunkStreamer<16> *, Renderer *, glm::vec3);
+template void updateChunkStreaming<32>(ChunkStreamer<32> *, Renderer *, glm::vec3);
+template glm::vec3 streamingWindowPosition<8>(const ChunkStreamer<8> *, glm::vec3);
+template glm::vec3 streamingWindowPosition<16>(const ChunkStreamer<16> *, glm::vec3);
+template glm::vec3 streamingWindowPosition<32>(const ChunkStreamer<32> *, glm::vec3);
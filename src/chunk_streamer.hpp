@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vox_object.hpp"
+#include "vox_block_archive.hpp"
+#include "scene_generator.hpp"
+#include "renderer.hpp"
+#include "cpu/worker_pool.hpp"
+
+// Streams an unbounded generated world around the camera. The world is split
+// into chunks, columns of blocks the full scene height tall, and the renderer
+// draws a fixed window of them centred on the camera's chunk. When the camera
+// crosses into another chunk the window moves with it: chunks that fall out are
+// retired and the ones that come in are generated on worker threads, then
+// uploaded from the render loop a few at a time.
+struct StreamingOptions
+{
+    // Chunks up to this many away from the camera's along x and z are resident.
+    uint32_t radius;
+    // Render loop time per frame spent placing finished chunks and uploading
+    // them in one batch. At least one chunk is placed each frame.
+    double frameBudgetMilliseconds;
+    // Retired chunks kept run-length encoded, so revisited ones are decoded
+    // rather than generated again. The oldest are dropped first.
+    uint32_t coldChunkCapacity;
+    // Threads generating chunks, 0 uses every hardware thread.
+    uint32_t workerCount;
+};
+
+StreamingOptions defaultStreamingOptions();
+
+// Pool blocks and scene limits for the window of options, at scene height
+// sceneOptions.height. The pool has room for blocks retired while frames are in flight.
+size_t streamingBlockCapacity(StreamingOptions options, SceneGeneratorOptions sceneOptions, uint32_t blockScale);
+SceneLimits streamingSceneLimits(StreamingOptions options, SceneGeneratorOptions sceneOptions, uint32_t blockScale);
+
+// A chunk on its way through the generator, its blocks bottom first.
+struct StreamedChunk
+{
+    int32_t x;
+    int32_t z;
+    // Decoded instead of generating when the chunk was cold. Empty blocks are
+    // archived without bytes.
+    std::vector<ArchivedVoxBlock> archived;
+    std::vector<unsigned char> voxels;
+    std::unique_ptr<bool[]> empty;
+};
+
+// Blocks of chunks retired before renderer frame number frame was submitted.
+struct RetiredBlocks
+{
+    uint64_t frame;
+    std::vector<uint32_t> poolIndices;
+};
+
+// A retired chunk and its place in the eviction order.
+struct ColdChunk
+{
+    std::vector<ArchivedVoxBlock> blocks;
+    std::list<uint64_t>::iterator order;
+};
+
+template<uint32_t N>
+struct ChunkStreamer
+{
+    StreamingOptions options;
+    SceneGeneratorOptions sceneOptions;
+    uint32_t chunkHeight;
+    MemPool<VoxBlock<N>> *voxBlocks;
+    const Palette *palette;
+    // The window, 2 * radius + 1 chunks wide and deep, as the renderer sees it.
+    VoxObject *window;
+    // World chunk at the window's lowest corner.
+    int32_t originX;
+    int32_t originZ;
+    // Palette image row of palette, UINT32_MAX until the first update.
+    uint32_t paletteRow;
+
+    // Pool indices plus one of each resident chunk's blocks, 0 where empty.
+    std::unordered_map<uint64_t, std::vector<uint32_t>> residentChunks;
+    // Oldest first, frames in flight may still read them. Pool blocks in use
+    // count them along with the resident ones.
+    std::deque<RetiredBlocks> retiredBlocks;
+    size_t usedBlocks;
+    size_t blockCapacity;
+    // Upload time per block of the last update, counted against the frame budget.
+    double uploadBlockMilliseconds;
+    // Chunks requested and not yet placed.
+    std::unordered_set<uint64_t> pendingChunks;
+    std::unordered_map<uint64_t, ColdChunk> coldChunks;
+    // Oldest first.
+    std::list<uint64_t> coldOrder;
+
+    // Shared with the generator thread.
+    std::mutex mutex;
+    std::condition_variable requested;
+    std::deque<StreamedChunk> requests;
+    std::deque<StreamedChunk> finished;
+    bool stopping;
+
+    // The generator thread takes requests in batches and runs each batch on workers.
+    std::thread generator;
+    WorkerPool workers;
+};
+
+// Builds the empty window as window, which uses a palette from palettes and
+// blocks from voxBlocks, and starts generating.
+template<uint32_t N>
+void startChunkStreaming(
+    ChunkStreamer<N> *streamer,
+    StreamingOptions options,
+    SceneGeneratorOptions sceneOptions,
+    MemPool<VoxBlock<N>> *voxBlocks,
+    MemPool<Palette> *palettes,
+    VoxObject *window);
+template<uint32_t N>
+void stopChunkStreaming(ChunkStreamer<N> *streamer);
+
+// Called once per frame from the render loop with the camera's world position.
+// Moves the window, requests the chunks it is missing and places finished ones
+// within the frame budget.
+template<uint32_t N>
+void updateChunkStreaming(ChunkStreamer<N> *streamer, Renderer *renderer, glm::vec3 cameraPosition);
+// A world position relative to the window, where the renderer draws it.
+template<uint32_t N>
+glm::vec3 streamingWindowPosition(const ChunkStreamer<N> *streamer, glm::vec3 position);
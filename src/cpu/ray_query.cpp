@@ -0,0 +1,177 @@
+#include "ray_query.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+// Rays per worker task, enough to hide the cost of taking a task.
+const uint32_t RAY_QUERY_CHUNK = 256;
+
+// Crossings are always computed from the origin rather than accumulated, so a
+// block boundary gives the same t whether it is reached a voxel or a block at a time.
+inline float boundaryDistance(float boundary, float origin, float inverseDirection)
+{
+    return inverseDirection == INFINITY || inverseDirection == -INFINITY
+        ? INFINITY
+        : (boundary - origin) * inverseDirection;
+}
+
+// The axis whose boundary is crossed first. Written as selects rather than
+// branches, the choice is close to random and mispredicts otherwise.
+inline int nextAxis(const float tNext[3])
+{
+    int axis = tNext[1] < tNext[0] ? 1 : 0;
+    return tNext[2] < tNext[axis] ? 2 : axis;
+}
+
+// Templated on the block scale like the image raycaster.
+template<uint32_t N>
+RayHit raycastQueryScaled(const CpuScene *scene, RayQuery ray)
+{
+    const int scale = N;
+    RayHit hit{};
+    const VoxObject *object = &scene->object;
+    int objectSize[3] = {
+        (int)(scale * object->blockWidth),
+        (int)(scale * object->blockHeight),
+        (int)(scale * object->blockDepth)};
+
+    float length = glm::length(ray.direction);
+    if (length == 0)
+        return hit;
+    float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    float dir[3] = {ray.direction.x / length, ray.direction.y / length, ray.direction.z / length};
+    float inverseDir[3];
+    int step[3], boundaryOffset[3];
+    for (int i = 0; i < 3; i++){
+        inverseDir[i] = 1.0f / dir[i];
+        step[i] = dir[i] > 0 ? 1 : -1;
+        boundaryOffset[i] = dir[i] > 0 ? 1 : 0;
+    }
+
+    // ENTER VOXEL GRID
+    float tmin = 0, tmax = ray.maxDistance;
+    int normalAxis = -1;
+    for (int i = 0; i < 3; i++){
+        float t0 = boundaryDistance(0, origin[i], inverseDir[i]);
+        float t1 = boundaryDistance(objectSize[i], origin[i], inverseDir[i]);
+        if (t0 == INFINITY && (origin[i] < 0 || origin[i] >= objectSize[i]))
+            return hit;
+        if (t0 == INFINITY)
+            continue;
+        if (std::min(t0, t1) > tmin){
+            tmin = std::min(t0, t1);
+            normalAxis = i;
+        }
+        tmax = std::min(tmax, std::max(t0, t1));
+    }
+    if (!(tmin < tmax))
+        return hit;
+
+    float t = tmin;
+    int voxel[3];
+    // Positions here are inside the grid give or take rounding and are clamped to
+    // it, so truncation works in place of floorf, which is a library call without SSE4.1.
+    for (int i = 0; i < 3; i++)
+        voxel[i] = std::clamp((int)(origin[i] + dir[i] * t), 0, objectSize[i] - 1);
+    if (normalAxis != -1)
+        voxel[normalAxis] = step[normalAxis] > 0 ? 0 : objectSize[normalAxis] - 1;
+
+    // TRAVERSE GRID
+    uint32_t maxSteps = maxTraversalSteps(object);
+    for (uint32_t steps = 0; steps < maxSteps && t <= ray.maxDistance; steps++){
+        int blockPos[3] = {voxel[0] / scale, voxel[1] / scale, voxel[2] / scale};
+        uint32_t block = object->blockIndices[
+            blockPos[0] + blockPos[1] * object->blockWidth + blockPos[2] * object->blockWidth * object->blockHeight];
+
+        if (block != 0){
+            // Walk the voxels of the block until one is hit or the ray leaves it.
+            const uint8_t *voxels = (const uint8_t *)&scene->voxBlockWords[(block - 1) * (VoxBlock<N>::POINT_COUNT / 4)];
+            int blockStart[3] = {blockPos[0] * scale, blockPos[1] * scale, blockPos[2] * scale};
+            float tNext[3];
+            for (int i = 0; i < 3; i++)
+                tNext[i] = boundaryDistance(step[i] > 0 ? voxel[i] + 1 : voxel[i], origin[i], inverseDir[i]);
+
+            int axis;
+            while (true){
+                uint32_t value = voxels[VoxBlock<N>::index(
+                    voxel[0] - blockStart[0], voxel[1] - blockStart[1], voxel[2] - blockStart[2])];
+                if (value != 0){
+                    hit.hit = true;
+                    hit.voxel = value;
+                    hit.position = glm::ivec3(voxel[0], voxel[1], voxel[2]);
+                    if (normalAxis != -1)
+                        hit.normal[normalAxis] = -step[normalAxis];
+                    hit.distance = t;
+                    return hit;
+                }
+
+                axis = nextAxis(tNext);
+                t = std::max(t, tNext[axis]);
+                normalAxis = axis;
+                voxel[axis] += step[axis];
+                if ((unsigned)(voxel[axis] - blockStart[axis]) >= (unsigned)scale || t > ray.maxDistance)
+                    break;
+                // Only axes the ray moves along are ever picked, so no infinity check.
+                tNext[axis] = ((float)(voxel[axis] + boundaryOffset[axis]) - origin[axis]) * inverseDir[axis];
+            }
+            if (voxel[axis] < 0 || voxel[axis] >= objectSize[axis])
+                break;
+            continue;
+        }
+
+        // Empty blocks are crossed in one step, landing in the neighbouring
+        // block's first voxel along the ray. The other axes stay inside the
+        // block being left.
+        float tNext[3];
+        for (int i = 0; i < 3; i++){
+            int cell = blockPos[i] * scale;
+            tNext[i] = boundaryDistance(step[i] > 0 ? cell + scale : cell, origin[i], inverseDir[i]);
+        }
+        int axis = nextAxis(tNext);
+        t = std::max(t, tNext[axis]);
+        normalAxis = axis;
+
+        for (int i = 0; i < 3; i++)
+            if (i != axis)
+                voxel[i] = std::clamp(
+                    (int)(origin[i] + dir[i] * t),
+                    blockPos[i] * scale,
+                    blockPos[i] * scale + scale - 1);
+        voxel[axis] = step[axis] > 0 ? (blockPos[axis] + 1) * scale : blockPos[axis] * scale - 1;
+        if (voxel[axis] < 0 || voxel[axis] >= objectSize[axis])
+            break;
+    }
+    return hit;
+}
+
+RayHit raycastQuery(const CpuScene *scene, RayQuery ray)
+{
+    switch (scene->object.blockScale){
+    case 8:
+        return raycastQueryScaled<8>(scene, ray);
+    case 16:
+        return raycastQueryScaled<16>(scene, ray);
+    default:
+        return raycastQueryScaled<32>(scene, ray);
+    }
+}
+
+void raycastQueryRange(const CpuScene *scene, const RayQuery *rays, RayHit *hits, uint32_t start, uint32_t end)
+{
+    for (uint32_t i = start; i < end; i++)
+        hits[i] = raycastQuery(scene, rays[i]);
+}
+
+void raycastBatch(const CpuScene *scene, WorkerPool *pool, const RayQuery *rays, RayHit *hits, uint32_t count)
+{
+    uint32_t chunkCount = (count + RAY_QUERY_CHUNK - 1) / RAY_QUERY_CHUNK;
+    if (pool == nullptr || chunkCount <= 1){
+        raycastQueryRange(scene, rays, hits, 0, count);
+        return;
+    }
+
+    parallelFor(pool, chunkCount, [&](uint32_t chunk, uint32_t){
+        uint32_t start = chunk * RAY_QUERY_CHUNK;
+        raycastQueryRange(scene, rays, hits, start, std::min(count, start + RAY_QUERY_CHUNK));
+    });
+}
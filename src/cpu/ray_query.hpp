@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include "raycaster.hpp"
+#include "worker_pool.hpp"
+
+// A ray in voxel grid space, one unit per voxel.
+struct RayQuery
+{
+    glm::vec3 origin;
+    // Need not be normalized.
+    glm::vec3 direction;
+    // Hits further than this from origin are ignored.
+    float maxDistance;
+};
+
+struct RayHit
+{
+    bool hit;
+    // Palette index plus one of the hit voxel.
+    uint8_t voxel;
+    glm::ivec3 position;
+    // Outward normal of the face the ray entered through, zero if origin is inside the voxel.
+    glm::ivec3 normal;
+    // From origin to the entry point, in voxels.
+    float distance;
+};
+
+RayHit raycastQuery(const CpuScene *scene, RayQuery ray);
+
+// Traces count rays, split across pool if it is not null. Batches are meant to be
+// large, picking a single voxel is cheaper with raycastQuery.
+void raycastBatch(const CpuScene *scene, WorkerPool *pool, const RayQuery *rays, RayHit *hits, uint32_t count);
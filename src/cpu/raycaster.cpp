@@ -0,0 +1,526 @@
+#include "raycaster.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RAYCAST_X86
+#include <immintrin.h>
+#endif
+
+// Every float operation below is written out in the order shader.comp and glm
+// perform it, and both paths use the same operations, so the scalar and AVX2
+// images are identical.
+
+const float BACKGROUND_COLOR[4] = {0.1f, 0.1f, 0.2f, 1.0f};
+const float EMPTY_COLOR[4] = {0.1f, 0.1f, 0.1f, 1.0f};
+
+// Matches _mm_min_ps and _mm_max_ps, which return the second operand for NaN.
+inline float minf(float a, float b) { return a < b ? a : b; }
+inline float maxf(float a, float b) { return a > b ? a : b; }
+
+// Float to UNORM8 conversion as done by imageStore.
+inline uint8_t unorm8(float value)
+{
+    return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+void storeColor(const float color[4], uint8_t *pixel)
+{
+    for (int i = 0; i < 4; i++)
+        pixel[i] = unorm8(color[i]);
+}
+
+void storeVoxelColor(const CpuScene *scene, uint32_t voxel, uint8_t *pixel)
+{
+    if (voxel == 0){
+        storeColor(EMPTY_COLOR, pixel);
+        return;
+    }
+    Material mat = scene->palette->mats[voxel - 1];
+    pixel[0] = mat.r;
+    pixel[1] = mat.g;
+    pixel[2] = mat.b;
+    pixel[3] = mat.a;
+}
+
+CpuScene createCpuScene(VoxObject object, const unsigned char *voxBlocks, MemPool<Palette> *palettes)
+{
+    if (!isSupportedVoxBlockScale(object.blockScale))
+        throw std::runtime_error("cpu raycaster does not support a block scale of " + std::to_string(object.blockScale));
+
+    CpuScene scene{};
+    scene.object = object;
+    scene.voxBlockWords = (const uint32_t *)voxBlocks;
+    scene.palette = palettes->getBlock(object.paletteIndex);
+    return scene;
+}
+
+// Per image constants of ray generation.
+struct RayGenInfo
+{
+    float imageWidth;
+    float imageHeight;
+    float aspectRatio;
+    // camRotMat columns.
+    float rot[4][4];
+    float pos[3];
+};
+
+RayGenInfo createRayGenInfo(const CamInfoBuffer *camInfo, uint32_t imageWidth, uint32_t imageHeight)
+{
+    RayGenInfo info{};
+    info.imageWidth = (float)imageWidth;
+    info.imageHeight = (float)imageHeight;
+    info.aspectRatio = info.imageWidth / info.imageHeight;
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            info.rot[c][r] = camInfo->camRotMat[c][r];
+    info.pos[0] = camInfo->camPos.x;
+    info.pos[1] = camInfo->camPos.y;
+    info.pos[2] = camInfo->camPos.z;
+    return info;
+}
+
+uint32_t maxTraversalSteps(const VoxObject *object)
+{
+    return object->blockScale * (object->blockWidth + object->blockHeight + object->blockDepth) + 3;
+}
+
+// The traversal functions are templated on the block scale so block and voxel
+// coordinates still split with constant shifts.
+
+constexpr int log2Scale(uint32_t scale)
+{
+    return scale == 1 ? 0 : 1 + log2Scale(scale / 2);
+}
+
+// SCALAR PATH
+
+template<uint32_t N>
+uint32_t getScalarVoxel(const CpuScene *scene, const int gridPos[3])
+{
+    const VoxObject *object = &scene->object;
+    uint32_t blockLinearPos =
+        gridPos[0] / N +
+        gridPos[1] / N * object->blockWidth +
+        gridPos[2] / N * object->blockWidth * object->blockHeight;
+    uint32_t block = object->blockIndices[blockLinearPos];
+    if (block == 0)
+        return 0;
+
+    uint32_t offset = VoxBlock<N>::index(gridPos[0] % N, gridPos[1] % N, gridPos[2] % N);
+    uint32_t word = scene->voxBlockWords[(block - 1) * (VoxBlock<N>::POINT_COUNT / 4) + offset / 4];
+    return (word >> ((offset % 4) * 8)) & 0xFF;
+}
+
+// steps is set to the number of grid cells visited.
+template<uint32_t N>
+void raycastScalar(const CpuScene *scene, const RayGenInfo *info, uint32_t x, uint32_t y, uint8_t *pixel, uint32_t *steps)
+{
+    // RAY GENERATION
+    float screenX = ((float)x / info->imageWidth * 2.0f - 1.0f) * info->aspectRatio;
+    float screenY = (float)y / info->imageHeight * -2.0f + 1.0f;
+
+    float lengthSquared = (screenX * screenX + screenY * screenY) + (1.0f + 1.0f);
+    float inverseLength = 1.0f / sqrtf(lengthSquared);
+    float n[4] = {screenX * inverseLength, screenY * inverseLength, inverseLength, inverseLength};
+
+    float dir[3];
+    for (int i = 0; i < 3; i++)
+        dir[i] = (info->rot[0][i] * n[0] + info->rot[1][i] * n[1]) + (info->rot[2][i] * n[2] + info->rot[3][i] * n[3]);
+    float pos[3] = {info->pos[0], info->pos[1], info->pos[2]};
+
+    const VoxObject *object = &scene->object;
+    int objectSize[3] = {
+        (int)(N * object->blockWidth),
+        (int)(N * object->blockHeight),
+        (int)(N * object->blockDepth)};
+
+    // ENTER VOXEL GRID
+    float tmin = -INFINITY, tmax = INFINITY;
+    for (int i = 0; i < 3; i++){
+        float t0 = (-pos[i]) / dir[i];
+        float t1 = ((float)objectSize[i] - pos[i]) / dir[i];
+        tmin = i == 0 ? minf(t0, t1) : maxf(tmin, minf(t0, t1));
+        tmax = i == 0 ? maxf(t0, t1) : minf(tmax, maxf(t0, t1));
+    }
+    *steps = 0;
+    if (!(tmin < tmax && tmax > 0)){
+        storeColor(BACKGROUND_COLOR, pixel);
+        return;
+    }
+    if (tmin > 0)
+        for (int i = 0; i < 3; i++)
+            pos[i] = dir[i] * tmin + pos[i];
+
+    // TRAVERSE GRID
+    int gridPos[3], gridStep[3], exit[3];
+    float tDelta[3], tMax[3];
+    for (int i = 0; i < 3; i++){
+        gridPos[i] = (int)floorf(pos[i]);
+        gridPos[i] = gridPos[i] < 0 ? 0 : gridPos[i] > objectSize[i] - 1 ? objectSize[i] - 1 : gridPos[i];
+        gridStep[i] = dir[i] > 0 ? 1 : dir[i] < 0 ? -1 : 0;
+        tDelta[i] = fabsf(1.0f / dir[i]);
+        tMax[i] = dir[i] < 0
+            ? (pos[i] - (float)gridPos[i]) * tDelta[i]
+            : ((float)(gridPos[i] + 1) - pos[i]) * tDelta[i];
+        exit[i] = dir[i] < 0 ? -1 : objectSize[i];
+    }
+
+    uint32_t hitVoxel = 0;
+    uint32_t maxSteps = maxTraversalSteps(object);
+    for (uint32_t step = 0; hitVoxel == 0 && step < maxSteps; step++){
+        hitVoxel = getScalarVoxel<N>(scene, gridPos);
+        (*steps)++;
+
+        int axis;
+        if (tMax[0] < tMax[1])
+            axis = tMax[0] < tMax[2] ? 0 : 2;
+        else
+            axis = tMax[1] < tMax[2] ? 1 : 2;
+
+        gridPos[axis] += gridStep[axis];
+        if (gridPos[axis] == exit[axis])
+            break;
+        tMax[axis] += tDelta[axis];
+    }
+
+    storeVoxelColor(scene, hitVoxel, pixel);
+}
+
+// AVX2 PATH
+
+#ifdef CPU_RAYCAST_X86
+
+__attribute__((target("avx2")))
+inline __m256 abs256(__m256 value)
+{
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), value);
+}
+
+__attribute__((target("avx2")))
+inline __m256i clamp256(__m256i value, __m256i low, __m256i high)
+{
+    return _mm256_min_epi32(_mm256_max_epi32(value, low), high);
+}
+
+// spreadMortonBits on each lane.
+__attribute__((target("avx2")))
+inline __m256i spreadMortonBits256(__m256i v)
+{
+    v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 16)), _mm256_set1_epi32(0x030000FF));
+    v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 8)), _mm256_set1_epi32(0x0300F00F));
+    v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 4)), _mm256_set1_epi32(0x030C30C3));
+    return _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 2)), _mm256_set1_epi32(0x09249249));
+}
+
+// voxBlockOffset on each lane, coordinates are within the block.
+template<uint32_t N>
+__attribute__((target("avx2")))
+inline __m256i voxBlockOffset256(__m256i x, __m256i y, __m256i z)
+{
+    const int scaleShift = log2Scale(N);
+    if (VOX_BLOCK_MORTON)
+        return _mm256_or_si256(
+            spreadMortonBits256(x),
+            _mm256_or_si256(
+                _mm256_slli_epi32(spreadMortonBits256(y), 1),
+                _mm256_slli_epi32(spreadMortonBits256(z), 2)));
+    return _mm256_add_epi32(
+        x,
+        _mm256_add_epi32(_mm256_slli_epi32(y, scaleShift), _mm256_slli_epi32(z, 2 * scaleShift)));
+}
+
+// Traces the 8 rays of pixels x to x + 7 of row y, storing the first count.
+template<uint32_t N>
+__attribute__((target("avx2")))
+void raycastPacketAvx2(const CpuScene *scene, const RayGenInfo *info, uint32_t x, uint32_t y, uint32_t count, uint8_t *pixels)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i zeroi = _mm256_setzero_si256();
+    const __m256i onei = _mm256_set1_epi32(1);
+    const __m256i allLanes = _mm256_set1_epi32(-1);
+
+    // RAY GENERATION
+    __m256i pixelX = _mm256_add_epi32(_mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256 screenX = _mm256_mul_ps(
+        _mm256_sub_ps(
+            _mm256_mul_ps(_mm256_div_ps(_mm256_cvtepi32_ps(pixelX), _mm256_set1_ps(info->imageWidth)), _mm256_set1_ps(2.0f)),
+            one),
+        _mm256_set1_ps(info->aspectRatio));
+    __m256 screenY = _mm256_set1_ps((float)y / info->imageHeight * -2.0f + 1.0f);
+
+    __m256 lengthSquared = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(screenX, screenX), _mm256_mul_ps(screenY, screenY)),
+        _mm256_set1_ps(1.0f + 1.0f));
+    __m256 inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared));
+    __m256 n[4] = {
+        _mm256_mul_ps(screenX, inverseLength),
+        _mm256_mul_ps(screenY, inverseLength),
+        inverseLength,
+        inverseLength};
+
+    __m256 dir[3], pos[3];
+    for (int i = 0; i < 3; i++){
+        dir[i] = _mm256_add_ps(
+            _mm256_add_ps(
+                _mm256_mul_ps(_mm256_set1_ps(info->rot[0][i]), n[0]),
+                _mm256_mul_ps(_mm256_set1_ps(info->rot[1][i]), n[1])),
+            _mm256_add_ps(
+                _mm256_mul_ps(_mm256_set1_ps(info->rot[2][i]), n[2]),
+                _mm256_mul_ps(_mm256_set1_ps(info->rot[3][i]), n[3])));
+        pos[i] = _mm256_set1_ps(info->pos[i]);
+    }
+
+    const VoxObject *object = &scene->object;
+    int objectSize[3] = {
+        (int)(N * object->blockWidth),
+        (int)(N * object->blockHeight),
+        (int)(N * object->blockDepth)};
+
+    // ENTER VOXEL GRID
+    __m256 tmin, tmax;
+    for (int i = 0; i < 3; i++){
+        __m256 t0 = _mm256_div_ps(_mm256_sub_ps(zero, pos[i]), dir[i]);
+        __m256 t1 = _mm256_div_ps(_mm256_sub_ps(_mm256_set1_ps((float)objectSize[i]), pos[i]), dir[i]);
+        tmin = i == 0 ? _mm256_min_ps(t0, t1) : _mm256_max_ps(tmin, _mm256_min_ps(t0, t1));
+        tmax = i == 0 ? _mm256_max_ps(t0, t1) : _mm256_min_ps(tmax, _mm256_max_ps(t0, t1));
+    }
+    __m256 entered = _mm256_and_ps(_mm256_cmp_ps(tmin, tmax, _CMP_LT_OQ), _mm256_cmp_ps(tmax, zero, _CMP_GT_OQ));
+    __m256 moveToEntry = _mm256_and_ps(entered, _mm256_cmp_ps(tmin, zero, _CMP_GT_OQ));
+    for (int i = 0; i < 3; i++)
+        pos[i] = _mm256_blendv_ps(pos[i], _mm256_add_ps(_mm256_mul_ps(dir[i], tmin), pos[i]), moveToEntry);
+
+    // TRAVERSE GRID
+    __m256i gridPos[3], gridStep[3], exit[3];
+    __m256 tDelta[3], tMax[3];
+    for (int i = 0; i < 3; i++){
+        // Lanes that missed the grid may hold any value, they are never traversed.
+        gridPos[i] = clamp256(
+            _mm256_cvttps_epi32(_mm256_floor_ps(pos[i])),
+            zeroi,
+            _mm256_set1_epi32(objectSize[i] - 1));
+        __m256 negative = _mm256_cmp_ps(dir[i], zero, _CMP_LT_OQ);
+        __m256 positive = _mm256_cmp_ps(dir[i], zero, _CMP_GT_OQ);
+        gridStep[i] = _mm256_or_si256(
+            _mm256_and_si256(_mm256_castps_si256(positive), onei),
+            _mm256_castps_si256(negative));
+        tDelta[i] = abs256(_mm256_div_ps(one, dir[i]));
+        __m256 gridFloat = _mm256_cvtepi32_ps(gridPos[i]);
+        tMax[i] = _mm256_blendv_ps(
+            _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(gridPos[i], onei)), pos[i]), tDelta[i]),
+            _mm256_mul_ps(_mm256_sub_ps(pos[i], gridFloat), tDelta[i]),
+            negative);
+        exit[i] = _mm256_blendv_epi8(_mm256_set1_epi32(objectSize[i]), allLanes, _mm256_castps_si256(negative));
+    }
+
+    const int *blockIndices = (const int *)object->blockIndices;
+    const int *voxBlockWords = (const int *)scene->voxBlockWords;
+    __m256i blockWidth = _mm256_set1_epi32(object->blockWidth);
+    __m256i blockArea = _mm256_set1_epi32(object->blockWidth * object->blockHeight);
+    __m256i blockMask = _mm256_set1_epi32(N - 1);
+    const int scaleShift = log2Scale(N);
+
+    __m256i active = _mm256_castps_si256(entered);
+    __m256i hitVoxel = zeroi;
+    uint32_t maxSteps = maxTraversalSteps(object);
+    for (uint32_t step = 0; !_mm256_testz_si256(active, active) && step < maxSteps; step++){
+        // Block lookup, the scale is a power of two so divisions are shifts.
+        __m256i blockLinearPos = _mm256_add_epi32(
+            _mm256_srli_epi32(gridPos[0], scaleShift),
+            _mm256_add_epi32(
+                _mm256_mullo_epi32(_mm256_srli_epi32(gridPos[1], scaleShift), blockWidth),
+                _mm256_mullo_epi32(_mm256_srli_epi32(gridPos[2], scaleShift), blockArea)));
+        __m256i block = _mm256_mask_i32gather_epi32(zeroi, blockIndices, blockLinearPos, active, 4);
+        __m256i hasBlock = _mm256_andnot_si256(_mm256_cmpeq_epi32(block, zeroi), active);
+
+        // Voxel lookup, the same aligned word reads as getBlockVox.
+        __m256i offset = voxBlockOffset256<N>(
+            _mm256_and_si256(gridPos[0], blockMask),
+            _mm256_and_si256(gridPos[1], blockMask),
+            _mm256_and_si256(gridPos[2], blockMask));
+        __m256i wordIndex = _mm256_add_epi32(
+            _mm256_slli_epi32(_mm256_sub_epi32(block, onei), 3 * scaleShift - 2),
+            _mm256_srli_epi32(offset, 2));
+        __m256i word = _mm256_mask_i32gather_epi32(zeroi, voxBlockWords, wordIndex, hasBlock, 4);
+        __m256i byteShift = _mm256_slli_epi32(_mm256_and_si256(offset, _mm256_set1_epi32(3)), 3);
+        __m256i voxel = _mm256_and_si256(_mm256_srlv_epi32(word, byteShift), _mm256_set1_epi32(0xFF));
+        hitVoxel = _mm256_blendv_epi8(hitVoxel, voxel, active);
+
+        // Step along the axis with the smallest tMax.
+        __m256i xLessY = _mm256_castps_si256(_mm256_cmp_ps(tMax[0], tMax[1], _CMP_LT_OQ));
+        __m256i xLessZ = _mm256_castps_si256(_mm256_cmp_ps(tMax[0], tMax[2], _CMP_LT_OQ));
+        __m256i yLessZ = _mm256_castps_si256(_mm256_cmp_ps(tMax[1], tMax[2], _CMP_LT_OQ));
+        __m256i stepAxis[3];
+        stepAxis[0] = _mm256_and_si256(xLessY, xLessZ);
+        stepAxis[1] = _mm256_andnot_si256(xLessY, yLessZ);
+        stepAxis[2] = _mm256_andnot_si256(_mm256_or_si256(stepAxis[0], stepAxis[1]), allLanes);
+
+        __m256i exited = zeroi;
+        for (int i = 0; i < 3; i++){
+            __m256i stepping = _mm256_and_si256(stepAxis[i], active);
+            gridPos[i] = _mm256_add_epi32(gridPos[i], _mm256_and_si256(gridStep[i], stepping));
+            __m256i axisExited = _mm256_and_si256(_mm256_cmpeq_epi32(gridPos[i], exit[i]), stepping);
+            exited = _mm256_or_si256(exited, axisExited);
+            tMax[i] = _mm256_add_ps(
+                tMax[i],
+                _mm256_and_ps(tDelta[i], _mm256_castsi256_ps(_mm256_andnot_si256(axisExited, stepping))));
+        }
+
+        active = _mm256_andnot_si256(_mm256_or_si256(exited, _mm256_cmpgt_epi32(hitVoxel, zeroi)), active);
+    }
+
+    alignas(32) uint32_t hitVoxels[8];
+    alignas(32) int32_t enteredLanes[8];
+    _mm256_store_si256((__m256i *)hitVoxels, hitVoxel);
+    _mm256_store_si256((__m256i *)enteredLanes, _mm256_castps_si256(entered));
+    for (uint32_t lane = 0; lane < count; lane++){
+        if (enteredLanes[lane] == 0)
+            storeColor(BACKGROUND_COLOR, &pixels[lane * 4]);
+        else
+            storeVoxelColor(scene, hitVoxels[lane], &pixels[lane * 4]);
+    }
+}
+
+bool cpuSupportsAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+template<uint32_t N>
+void raycastPacketAvx2(const CpuScene *scene, const RayGenInfo *info, uint32_t x, uint32_t y, uint32_t count, uint8_t *pixels)
+{
+    throw std::runtime_error("AVX2 raycasting is only available on x86");
+}
+
+bool cpuSupportsAvx2()
+{
+    return false;
+}
+
+#endif
+
+CpuRaycastPath bestCpuRaycastPath()
+{
+    return cpuSupportsAvx2() ? CPU_RAYCAST_AVX2 : CPU_RAYCAST_SCALAR;
+}
+
+bool cpuRaycastPathSupported(CpuRaycastPath path)
+{
+    return path == CPU_RAYCAST_SCALAR || cpuSupportsAvx2();
+}
+
+CpuRaycastPath parseCpuRaycastPath(std::string name)
+{
+    if (name == "auto")
+        return bestCpuRaycastPath();
+    if (name == "scalar")
+        return CPU_RAYCAST_SCALAR;
+    if (name == "avx2"){
+        if (!cpuSupportsAvx2())
+            throw std::runtime_error("this cpu does not support AVX2");
+        return CPU_RAYCAST_AVX2;
+    }
+    throw std::runtime_error("unknown cpu raycast path " + name + ", expected auto, scalar or avx2");
+}
+
+const char *cpuRaycastPathName(CpuRaycastPath path)
+{
+    return path == CPU_RAYCAST_AVX2 ? "avx2" : "scalar";
+}
+
+template<uint32_t N>
+void raycastRegion(
+    const CpuScene *scene,
+    const RayGenInfo *info,
+    uint32_t imageWidth,
+    uint32_t regionX,
+    uint32_t regionY,
+    uint32_t regionWidth,
+    uint32_t regionHeight,
+    CpuRaycastPath path,
+    uint8_t *pixels)
+{
+    for (uint32_t y = regionY; y < regionY + regionHeight; y++){
+        uint8_t *row = &pixels[(size_t)y * imageWidth * 4];
+        uint32_t x = regionX;
+        if (path == CPU_RAYCAST_AVX2)
+            for (; x < regionX + regionWidth; x += 8)
+                raycastPacketAvx2<N>(scene, info, x, y, std::min<uint32_t>(8, regionX + regionWidth - x), &row[x * 4]);
+        uint32_t steps;
+        for (; x < regionX + regionWidth; x++)
+            raycastScalar<N>(scene, info, x, y, &row[x * 4], &steps);
+    }
+}
+
+void cpuRaycastRegion(
+    const CpuScene *scene,
+    const CamInfoBuffer *camInfo,
+    uint32_t imageWidth,
+    uint32_t imageHeight,
+    uint32_t regionX,
+    uint32_t regionY,
+    uint32_t regionWidth,
+    uint32_t regionHeight,
+    CpuRaycastPath path,
+    uint8_t *pixels)
+{
+    RayGenInfo info = createRayGenInfo(camInfo, imageWidth, imageHeight);
+
+    switch (scene->object.blockScale){
+    case 8:
+        raycastRegion<8>(scene, &info, imageWidth, regionX, regionY, regionWidth, regionHeight, path, pixels);
+        break;
+    case 16:
+        raycastRegion<16>(scene, &info, imageWidth, regionX, regionY, regionWidth, regionHeight, path, pixels);
+        break;
+    case 32:
+        raycastRegion<32>(scene, &info, imageWidth, regionX, regionY, regionWidth, regionHeight, path, pixels);
+        break;
+    }
+}
+
+void cpuRaycast(
+    const CpuScene *scene,
+    const CamInfoBuffer *camInfo,
+    uint32_t imageWidth,
+    uint32_t imageHeight,
+    CpuRaycastPath path,
+    uint8_t *pixels)
+{
+    cpuRaycastRegion(scene, camInfo, imageWidth, imageHeight, 0, 0, imageWidth, imageHeight, path, pixels);
+}
+
+uint64_t cpuTraversalSteps(
+    const CpuScene *scene,
+    const CamInfoBuffer *camInfo,
+    uint32_t imageWidth,
+    uint32_t imageHeight,
+    uint32_t row)
+{
+    RayGenInfo info = createRayGenInfo(camInfo, imageWidth, imageHeight);
+
+    uint64_t totalSteps = 0;
+    uint8_t pixel[4];
+    for (uint32_t x = 0; x < imageWidth; x++){
+        uint32_t steps = 0;
+        switch (scene->object.blockScale){
+        case 8:
+            raycastScalar<8>(scene, &info, x, row, pixel, &steps);
+            break;
+        case 16:
+            raycastScalar<16>(scene, &info, x, row, pixel, &steps);
+            break;
+        case 32:
+            raycastScalar<32>(scene, &info, x, row, pixel, &steps);
+            break;
+        }
+        totalSteps += steps;
+    }
+    return totalSteps;
+}
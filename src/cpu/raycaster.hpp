@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "../vox_object.hpp"
+#include "../cam_info.hpp"
+
+// The scene as shader.comp sees it, read straight from the pools the renderer
+// uploads from.
+struct CpuScene
+{
+    VoxObject object;
+    // Every block of the pool back to back, indexed like the voxBlocks buffer.
+    const uint32_t *voxBlockWords;
+    const Palette *palette;
+};
+
+enum CpuRaycastPath
+{
+    CPU_RAYCAST_SCALAR,
+    // Packets of 8 rays, only used if the cpu supports AVX2.
+    CPU_RAYCAST_AVX2
+};
+
+// Upper bound on DDA steps, a ray leaves the grid after at most this many.
+uint32_t maxTraversalSteps(const VoxObject *object);
+
+// voxBlocks holds every block of the pool back to back, see voxBlockBytes.
+CpuScene createCpuScene(VoxObject object, const unsigned char *voxBlocks, MemPool<Palette> *palettes);
+
+// The widest path this cpu supports.
+CpuRaycastPath bestCpuRaycastPath();
+bool cpuRaycastPathSupported(CpuRaycastPath path);
+CpuRaycastPath parseCpuRaycastPath(std::string name);
+const char *cpuRaycastPathName(CpuRaycastPath path);
+
+// Traces the pixels of a region of an imageWidth x imageHeight image the same way
+// shader.comp does and writes them as RGBA8 into pixels, which holds the whole
+// image. Rays are generated from the full image size so regions can be rendered
+// independently.
+void cpuRaycastRegion(
+    const CpuScene *scene,
+    const CamInfoBuffer *camInfo,
+    uint32_t imageWidth,
+    uint32_t imageHeight,
+    uint32_t regionX,
+    uint32_t regionY,
+    uint32_t regionWidth,
+    uint32_t regionHeight,
+    CpuRaycastPath path,
+    uint8_t *pixels);
+
+void cpuRaycast(
+    const CpuScene *scene,
+    const CamInfoBuffer *camInfo,
+    uint32_t imageWidth,
+    uint32_t imageHeight,
+    CpuRaycastPath path,
+    uint8_t *pixels);
+
+// Grid cells visited by the rays of one row, as a measure of traversal cost.
+uint64_t cpuTraversalSteps(
+    const CpuScene *scene,
+    const CamInfoBuffer *camInfo,
+    uint32_t imageWidth,
+    uint32_t imageHeight,
+    uint32_t row);
@@ -0,0 +1,33 @@
+#include "tile_renderer.hpp"
+
+#include <algorithm>
+
+void resizeCpuFramebuffer(CpuFramebuffer *framebuffer, uint32_t width, uint32_t height)
+{
+    framebuffer->width = width;
+    framebuffer->height = height;
+    framebuffer->pixels.resize((size_t)width * height * 4);
+}
+
+void renderCpuFrame(CpuRenderer *renderer, const CamInfoBuffer *camInfo)
+{
+    CpuFramebuffer *framebuffer = &renderer->framebuffer;
+    uint32_t tilesX = (framebuffer->width + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+    uint32_t tilesY = (framebuffer->height + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+
+    parallelFor(renderer->pool, tilesX * tilesY, [&](uint32_t tile, uint32_t){
+        uint32_t x = tile % tilesX * CPU_TILE_SIZE;
+        uint32_t y = tile / tilesX * CPU_TILE_SIZE;
+        cpuRaycastRegion(
+            &renderer->scene,
+            camInfo,
+            framebuffer->width,
+            framebuffer->height,
+            x,
+            y,
+            std::min(CPU_TILE_SIZE, framebuffer->width - x),
+            std::min(CPU_TILE_SIZE, framebuffer->height - y),
+            renderer->path,
+            framebuffer->pixels.data());
+    });
+}
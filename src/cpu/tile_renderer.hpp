@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "raycaster.hpp"
+#include "worker_pool.hpp"
+
+// Tiles are a multiple of the 8 ray AVX2 packet wide.
+const uint32_t CPU_TILE_SIZE = 32;
+
+// RGBA8 pixels, tightly packed rows.
+struct CpuFramebuffer
+{
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> pixels;
+};
+
+// Everything the cpu backend renders a frame with.
+struct CpuRenderer
+{
+    WorkerPool *pool;
+    CpuScene scene;
+    CpuRaycastPath path;
+    CpuFramebuffer framebuffer;
+};
+
+void resizeCpuFramebuffer(CpuFramebuffer *framebuffer, uint32_t width, uint32_t height);
+
+// Splits the framebuffer into CPU_TILE_SIZE tiles and traces them on the pool.
+void renderCpuFrame(CpuRenderer *renderer, const CamInfoBuffer *camInfo);
@@ -0,0 +1,120 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+bool popOwnTask(WorkerQueue *queue, uint32_t *task)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->tasks.empty())
+        return false;
+    *task = queue->tasks.back();
+    queue->tasks.pop_back();
+    return true;
+}
+
+bool stealTask(WorkerQueue *queue, uint32_t *task)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->tasks.empty())
+        return false;
+    *task = queue->tasks.front();
+    queue->tasks.pop_front();
+    return true;
+}
+
+// Every task is queued before the job starts, so once no deque has a task left
+// there is nothing more for this worker to do.
+void runTasks(WorkerPool *pool, uint32_t worker)
+{
+    const WorkerTask &job = *pool->job;
+    uint32_t task;
+    while (true){
+        if (popOwnTask(&pool->queues[worker], &task)){
+            job(task, worker);
+            continue;
+        }
+
+        bool stole = false;
+        for (uint32_t i = 1; i < pool->workerCount && !stole; i++)
+            stole = stealTask(&pool->queues[(worker + i) % pool->workerCount], &task);
+        if (!stole)
+            return;
+
+        pool->steals.fetch_add(1, std::memory_order_relaxed);
+        job(task, worker);
+    }
+}
+
+void workerThread(WorkerPool *pool, uint32_t worker)
+{
+    uint64_t seenGeneration = 0;
+    while (true){
+        {
+            std::unique_lock<std::mutex> lock(pool->jobMutex);
+            pool->jobStarted.wait(lock, [&]{ return pool->stopping || pool->jobGeneration != seenGeneration; });
+            if (pool->stopping)
+                return;
+            seenGeneration = pool->jobGeneration;
+        }
+
+        runTasks(pool, worker);
+
+        std::lock_guard<std::mutex> lock(pool->jobMutex);
+        if (--pool->busyThreads == 0)
+            pool->jobFinished.notify_one();
+    }
+}
+
+void startWorkerPool(WorkerPool *pool, uint32_t workerCount)
+{
+    if (workerCount == 0)
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+    pool->workerCount = workerCount;
+    pool->queues = std::unique_ptr<WorkerQueue[]>(new WorkerQueue[workerCount]);
+    pool->jobGeneration = 0;
+    pool->stopping = false;
+    pool->job = nullptr;
+    pool->busyThreads = 0;
+    pool->steals.store(0);
+
+    for (uint32_t i = 1; i < workerCount; i++)
+        pool->threads.push_back(std::thread(workerThread, pool, i));
+}
+
+void stopWorkerPool(WorkerPool *pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->jobMutex);
+        pool->stopping = true;
+    }
+    pool->jobStarted.notify_all();
+
+    for (std::thread &thread : pool->threads)
+        thread.join();
+    pool->threads.clear();
+}
+
+void parallelFor(WorkerPool *pool, uint32_t taskCount, WorkerTask task)
+{
+    // Contiguous runs of tasks per worker keep neighbouring tiles on one core.
+    for (uint32_t i = 0; i < taskCount; i++){
+        WorkerQueue *queue = &pool->queues[(uint64_t)i * pool->workerCount / taskCount];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->tasks.push_front(i);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->jobMutex);
+        pool->job = &task;
+        pool->busyThreads = pool->threads.size();
+        pool->jobGeneration++;
+    }
+    pool->jobStarted.notify_all();
+
+    runTasks(pool, 0);
+
+    std::unique_lock<std::mutex> lock(pool->jobMutex);
+    pool->jobFinished.wait(lock, [&]{ return pool->busyThreads == 0; });
+    pool->job = nullptr;
+}
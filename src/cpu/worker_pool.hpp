@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Called with the task index and the worker running it.
+typedef std::function<void(uint32_t task, uint32_t worker)> WorkerTask;
+
+struct WorkerQueue
+{
+    std::mutex mutex;
+    std::deque<uint32_t> tasks;
+};
+
+// Fixed set of threads running parallelFor jobs. Each worker owns a deque of
+// task indices, takes work from its back and, once empty, steals from the front
+// of the other workers' deques, so uneven tasks balance out.
+struct WorkerPool
+{
+    // Worker 0 is the thread calling parallelFor, the others are threads.
+    uint32_t workerCount;
+    std::vector<std::thread> threads;
+    std::unique_ptr<WorkerQueue[]> queues;
+
+    std::mutex jobMutex;
+    std::condition_variable jobStarted;
+    std::condition_variable jobFinished;
+    uint64_t jobGeneration;
+    bool stopping;
+    const WorkerTask *job;
+    // Threads that have not finished the current job yet.
+    uint32_t busyThreads;
+
+    // Tasks taken from another worker's deque, since the pool started.
+    std::atomic<uint64_t> steals;
+};
+
+// A workerCount of 0 uses every hardware thread.
+void startWorkerPool(WorkerPool *pool, uint32_t workerCount);
+void stopWorkerPool(WorkerPool *pool);
+
+// Runs task for every index below taskCount and returns once all have finished.
+// Neighbouring indices start on the same worker.
+void parallelFor(WorkerPool *pool, uint32_t taskCount, WorkerTask task);
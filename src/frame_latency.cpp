@@ -0,0 +1,91 @@
+#include "frame_latency.hpp"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "timing.hpp"
+
+void printFrameLatency(const char *title, std::vector<double> latencies)
+{
+    if (latencies.empty())
+        return;
+    std::sort(latencies.begin(), latencies.end());
+    printf(
+        "%s: %zu frames, input to gpu done p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n",
+        title, latencies.size(),
+        sortedPercentile(latencies, 50), sortedPercentile(latencies, 95),
+        sortedPercentile(latencies, 99), latencies.back());
+}
+
+void waitFrameLatencyFences(FrameLatencyProbe *probe)
+{
+    std::chrono::steady_clock::time_point lastSummary = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(probe->mutex);
+    while (true){
+        probe->changed.wait(lock, [probe]{ return !probe->pending.empty() || !probe->running; });
+        if (probe->pending.empty())
+            break;
+
+        // Fences signal in submission order, so waiting on the oldest first
+        // timestamps each frame as soon as it is done.
+        FrameLatencyEntry entry = probe->pending.front();
+        lock.unlock();
+        vkWaitForFences(probe->device, 1, &entry.fence, VK_TRUE, UINT64_MAX);
+        std::chrono::steady_clock::time_point done = std::chrono::steady_clock::now();
+        double milliseconds = std::chrono::duration<double, std::milli>(done - entry.inputTime).count();
+        lock.lock();
+
+        probe->pending.pop_front();
+        probe->window.push_back(milliseconds);
+        probe->all.push_back(milliseconds);
+        probe->changed.notify_all();
+
+        if (done - lastSummary >= std::chrono::seconds(1)){
+            std::vector<double> window;
+            window.swap(probe->window);
+            lock.unlock();
+            printFrameLatency("latency", window);
+            lock.lock();
+            lastSummary = done;
+        }
+    }
+}
+
+void startFrameLatencyProbe(FrameLatencyProbe *probe, VkDevice device)
+{
+    probe->device = device;
+    probe->running = true;
+    probe->pending.clear();
+    probe->window.clear();
+    probe->all.clear();
+    probe->waiter = std::thread(waitFrameLatencyFences, probe);
+}
+
+void watchFrameLatency(FrameLatencyProbe *probe, VkFence fence, std::chrono::steady_clock::time_point inputTime)
+{
+    std::lock_guard<std::mutex> lock(probe->mutex);
+    probe->pending.push_back({fence, inputTime});
+    probe->changed.notify_all();
+}
+
+void releaseFrameLatencyFence(FrameLatencyProbe *probe, VkFence fence)
+{
+    std::unique_lock<std::mutex> lock(probe->mutex);
+    probe->changed.wait(lock, [probe, fence]{
+        return std::none_of(probe->pending.begin(), probe->pending.end(), [fence](const FrameLatencyEntry &entry){
+            return entry.fence == fence;
+        });
+    });
+}
+
+void stopFrameLatencyProbe(FrameLatencyProbe *probe)
+{
+    {
+        std::lock_guard<std::mutex> lock(probe->mutex);
+        probe->running = false;
+        probe->changed.notify_all();
+    }
+    probe->waiter.join();
+    printFrameLatency("latency over the whole run", probe->all);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct FrameLatencyEntry
+{
+    VkFence fence;
+    std::chrono::steady_clock::time_point inputTime;
+};
+
+// Measures the time from sampling a frame's input to the gpu finishing it, on a
+// thread that waits on each submitted frame's fence. Without a present timing
+// extension the fence is the latest point the host can observe, only the
+// present itself comes after it.
+struct FrameLatencyProbe
+{
+    VkDevice device;
+    std::thread waiter;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool running;
+    // Submitted frames not yet finished, oldest first. The front one stays until
+    // the waiter is done with its fence.
+    std::deque<FrameLatencyEntry> pending;
+    // Latencies of the current second and of the whole run.
+    std::vector<double> window;
+    std::vector<double> all;
+};
+
+// Prints percentiles every second and for the whole run when stopped.
+void startFrameLatencyProbe(FrameLatencyProbe *probe, VkDevice device);
+// Called right after fence was submitted with the frame sampled at inputTime.
+void watchFrameLatency(FrameLatencyProbe *probe, VkFence fence, std::chrono::steady_clock::time_point inputTime);
+// Blocks until the waiter no longer uses fence, so it can be reset.
+void releaseFrameLatencyFence(FrameLatencyProbe *probe, VkFence fence);
+// Waits for every watched frame, so the device should be idle.
+void stopFrameLatencyProbe(FrameLatencyProbe *probe);
@@ -0,0 +1,183 @@
+#include "frame_telemetry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "timing.hpp"
+
+const char *FRAME_STAGE_NAMES[FRAME_STAGE_COUNT] = {
+    "input",
+    "camera",
+    "streaming",
+    "cpu render",
+    "fence wait",
+    "acquire",
+    "submit",
+    "present",
+    "total"};
+
+const double HISTOGRAM_BUCKET_MILLISECONDS = 2.0;
+const uint32_t HISTOGRAM_BUCKET_COUNT = 16;
+const uint32_t HISTOGRAM_BAR_WIDTH = 40;
+
+bool pushFrameTimings(FrameTimingRing *ring, const FrameTimings *timings)
+{
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    uint32_t next = (head + 1) % FRAME_TIMING_RING_CAPACITY;
+    if (next == ring->tail.load(std::memory_order_acquire))
+        return false;
+
+    ring->entries[head] = *timings;
+    ring->head.store(next, std::memory_order_release);
+    return true;
+}
+
+bool popFrameTimings(FrameTimingRing *ring, FrameTimings *timings)
+{
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    if (tail == ring->head.load(std::memory_order_acquire))
+        return false;
+
+    *timings = ring->entries[tail];
+    ring->tail.store((tail + 1) % FRAME_TIMING_RING_CAPACITY, std::memory_order_release);
+    return true;
+}
+
+void printFrameHistogram(const std::vector<double> &totals)
+{
+    uint32_t buckets[HISTOGRAM_BUCKET_COUNT] = {};
+    uint32_t largestBucket = 1;
+    for (double milliseconds : totals){
+        uint32_t bucket = std::min<uint32_t>(milliseconds / HISTOGRAM_BUCKET_MILLISECONDS, HISTOGRAM_BUCKET_COUNT - 1);
+        buckets[bucket]++;
+        largestBucket = std::max(largestBucket, buckets[bucket]);
+    }
+
+    // Skip the empty buckets above the slowest frame.
+    uint32_t lastBucket = HISTOGRAM_BUCKET_COUNT - 1;
+    while (lastBucket > 0 && buckets[lastBucket] == 0)
+        lastBucket--;
+
+    for (uint32_t i = 0; i <= lastBucket; i++){
+        uint32_t barLength = buckets[i] * HISTOGRAM_BAR_WIDTH / largestBucket;
+        if (i == HISTOGRAM_BUCKET_COUNT - 1)
+            printf("\t  >%4.0f ms %5u |", i * HISTOGRAM_BUCKET_MILLISECONDS, buckets[i]);
+        else
+            printf(
+                "\t%3.0f-%3.0f ms %5u |",
+                i * HISTOGRAM_BUCKET_MILLISECONDS, (i + 1) * HISTOGRAM_BUCKET_MILLISECONDS, buckets[i]);
+        for (uint32_t j = 0; j < barLength; j++)
+            putchar('#');
+        putchar('\n');
+    }
+}
+
+void summarizeFrameWindow(FrameTelemetry *telemetry)
+{
+    if (telemetry->window.empty())
+        return;
+
+    std::vector<double> stages[FRAME_STAGE_COUNT];
+    for (int stage = 0; stage < FRAME_STAGE_COUNT; stage++){
+        stages[stage].reserve(telemetry->window.size());
+        for (const FrameTimings &timings : telemetry->window)
+            stages[stage].push_back(timings.milliseconds[stage]);
+        std::sort(stages[stage].begin(), stages[stage].end());
+    }
+
+    const std::vector<double> &totals = stages[FRAME_STAGE_TOTAL];
+    telemetry->framesPerSecond.store(telemetry->window.size());
+    telemetry->p50Milliseconds.store(sortedPercentile(totals, 50));
+    telemetry->p99Milliseconds.store(sortedPercentile(totals, 99));
+
+    if (telemetry->print){
+        printf(
+            "%zu frames, %u dropped from telemetry:\n",
+            telemetry->window.size(), telemetry->droppedFrames.exchange(0));
+        for (int stage = 0; stage < FRAME_STAGE_COUNT; stage++)
+            printf(
+                "\t%-12s p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n",
+                FRAME_STAGE_NAMES[stage],
+                sortedPercentile(stages[stage], 50), sortedPercentile(stages[stage], 95),
+                sortedPercentile(stages[stage], 99), stages[stage].back());
+        printFrameHistogram(totals);
+    }
+
+    telemetry->window.clear();
+}
+
+void writeFrameCsvRow(FILE *file, const FrameTimings *timings)
+{
+    fprintf(file, "%lu", (unsigned long)timings->frame);
+    for (int stage = 0; stage < FRAME_STAGE_COUNT; stage++)
+        fprintf(file, ",%.4f", timings->milliseconds[stage]);
+    fputc('\n', file);
+}
+
+void drainFrameTimings(FrameTelemetry *telemetry)
+{
+    FrameTimings timings;
+    while (popFrameTimings(&telemetry->ring, &timings)){
+        telemetry->window.push_back(timings);
+        if (telemetry->csvFile != nullptr)
+            writeFrameCsvRow(telemetry->csvFile, &timings);
+    }
+}
+
+void consumeFrameTimings(FrameTelemetry *telemetry)
+{
+    std::chrono::steady_clock::time_point lastSummary = std::chrono::steady_clock::now();
+    while (telemetry->running.load()){
+        drainFrameTimings(telemetry);
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - lastSummary >= std::chrono::seconds(1)){
+            summarizeFrameWindow(telemetry);
+            lastSummary = now;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    drainFrameTimings(telemetry);
+}
+
+void startFrameTelemetry(FrameTelemetry *telemetry, bool print, std::string csvFilename)
+{
+    telemetry->ring.head.store(0);
+    telemetry->ring.tail.store(0);
+    telemetry->print = print;
+    telemetry->csvFile = nullptr;
+    telemetry->framesPerSecond.store(0);
+    telemetry->p50Milliseconds.store(0);
+    telemetry->p99Milliseconds.store(0);
+    telemetry->droppedFrames.store(0);
+
+    if (!csvFilename.empty()){
+        if ((telemetry->csvFile = fopen(csvFilename.c_str(), "w")) == NULL)
+            throw std::runtime_error("cant open frame timing csv file " + csvFilename);
+        fprintf(telemetry->csvFile, "frame");
+        for (int stage = 0; stage < FRAME_STAGE_COUNT; stage++)
+            fprintf(telemetry->csvFile, ",%s_ms", FRAME_STAGE_NAMES[stage]);
+        fputc('\n', telemetry->csvFile);
+    }
+
+    telemetry->running.store(true);
+    telemetry->consumer = std::thread(consumeFrameTimings, telemetry);
+}
+
+void recordFrameTimings(FrameTelemetry *telemetry, const FrameTimings *timings)
+{
+    if (!pushFrameTimings(&telemetry->ring, timings))
+        telemetry->droppedFrames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void stopFrameTelemetry(FrameTelemetry *telemetry)
+{
+    telemetry->running.store(false);
+    telemetry->consumer.join();
+
+    if (telemetry->csvFile != nullptr)
+        fclose(telemetry->csvFile);
+    telemetry->csvFile = nullptr;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum FrameStage
+{
+    FRAME_STAGE_INPUT,
+    FRAME_STAGE_CAMERA,
+    // Taking streamed chunks and uploading them, loading and evicting blocks with
+    // block residency, or uploading dug blocks. Zero without any of them.
+    FRAME_STAGE_STREAMING,
+    // Tracing on the cpu backend, zero when rendering on the gpu.
+    FRAME_STAGE_CPU_RENDER,
+    FRAME_STAGE_FENCE_WAIT,
+    FRAME_STAGE_ACQUIRE,
+    FRAME_STAGE_SUBMIT,
+    FRAME_STAGE_PRESENT,
+    // Whole frame, from the start of this frame to the start of the next.
+    FRAME_STAGE_TOTAL,
+    FRAME_STAGE_COUNT
+};
+
+// CPU time spent in each stage of one frame.
+struct FrameTimings
+{
+    uint64_t frame;
+    double milliseconds[FRAME_STAGE_COUNT];
+    // When the frame's input was sampled, for the latency probe.
+    std::chrono::steady_clock::time_point inputTime;
+};
+
+const uint32_t FRAME_TIMING_RING_CAPACITY = 1024;
+
+// Single producer single consumer queue. The render loop pushes and never blocks,
+// frames are dropped if the consumer falls a whole ring behind.
+struct FrameTimingRing
+{
+    FrameTimings entries[FRAME_TIMING_RING_CAPACITY];
+    // Next entry the producer writes, only written by the producer.
+    std::atomic<uint32_t> head;
+    // Next entry the consumer reads, only written by the consumer.
+    std::atomic<uint32_t> tail;
+};
+
+bool pushFrameTimings(FrameTimingRing *ring, const FrameTimings *timings);
+bool popFrameTimings(FrameTimingRing *ring, FrameTimings *timings);
+
+// Drains frame timings on a background thread, summarizing them once a second
+// and optionally streaming every frame to a csv file.
+struct FrameTelemetry
+{
+    FrameTimingRing ring;
+    std::thread consumer;
+    std::atomic<bool> running;
+
+    bool print;
+    FILE *csvFile;
+
+    // Consumer side state.
+    std::vector<FrameTimings> window;
+
+    // Results of the latest summary, readable from any thread.
+    std::atomic<uint32_t> framesPerSecond;
+    std::atomic<float> p50Milliseconds;
+    std::atomic<float> p99Milliseconds;
+    std::atomic<uint32_t> droppedFrames;
+};
+
+// print writes a histogram and percentiles to stdout every second. An empty
+// csvFilename disables the csv stream.
+void startFrameTelemetry(FrameTelemetry *telemetry, bool print, std::string csvFilename);
+// Called once per frame by the render loop.
+void recordFrameTimings(FrameTelemetry *telemetry, const FrameTimings *timings);
+// Flushes remaining frames and joins the consumer thread.
+void stopFrameTelemetry(FrameTelemetry *telemetry);
@@ -0,0 +1,248 @@
+#include "golden.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "renderer.hpp"
+#include "headless.hpp"
+#include "camera_controller.hpp"
+#include "image_file.hpp"
+#include "cpu/raycaster.hpp"
+#include "cpu/tile_renderer.hpp"
+
+const char GOLDEN_STEPS_FILE[] = "steps.txt";
+
+struct GoldenRender
+{
+    std::string renderer;
+    // One RGBA8 image per pose.
+    std::vector<std::vector<uint8_t>> images;
+};
+
+GoldenOptions defaultGoldenOptions()
+{
+    GoldenOptions options{};
+    options.extent = VkExtent2D{320, 240};
+    options.directory = "golden";
+    options.diffDirectory = "golden_diff";
+    options.channelTolerance = 2;
+    options.maxMismatchFraction = 0.0005;
+    options.update = false;
+    options.cpuOnly = false;
+    return options;
+}
+
+// Poses chosen for the cases traversal gets wrong: grid entry from outside at an
+// angle, rays exactly along an axis, starting inside the grid and rays grazing a face.
+std::vector<Camera> createGoldenPoses(VoxObject object)
+{
+    glm::vec3 size = glm::vec3(
+        object.blockScale * object.blockWidth,
+        object.blockScale * object.blockHeight,
+        object.blockScale * object.blockDepth);
+    glm::vec3 center = size * 0.5f;
+
+    std::vector<Camera> poses;
+    poses.push_back(createStartCamera());
+    poses.push_back(createLookAtCamera(glm::vec3(-0.5f, 1.2f, -0.5f) * size, center));
+    poses.push_back(createLookAtCamera(glm::vec3(center.x, center.y, -8.0f), glm::vec3(center.x, center.y, size.z)));
+    poses.push_back(createLookAtCamera(glm::vec3(-8.0f, center.y, center.z), glm::vec3(size.x, center.y, center.z)));
+    poses.push_back(createLookAtCamera(center, center + glm::vec3(1.0f, 0.1f, 0.3f)));
+    poses.push_back(createLookAtCamera(
+        glm::vec3(-4.0f, size.y + 0.5f, center.z), glm::vec3(size.x, size.y - 0.5f, center.z)));
+    return poses;
+}
+
+std::string goldenImageName(GoldenOptions *options, uint32_t pose)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "pose_%02u.ppm", pose);
+    return options->directory + "/" + name;
+}
+
+GoldenRender renderGoldenGpu(
+    GoldenOptions *options,
+    bool enableValidationLayers,
+    VoxObject object,
+    const unsigned char *voxBlocks,
+    MemPool<Palette> *palettes,
+    const std::vector<Camera> &poses)
+{
+    GoldenRender render{"gpu", {}};
+    render.images.resize(poses.size());
+
+    // The cpu reference has no level of detail, so the gpu traces at full resolution too.
+    SceneLimits limits = voxObjectLimits(object, voxBlocks);
+    limits.mipCount = 0;
+    Renderer renderer = createHeadlessRenderer(options->extent, limits, DEFAULT_PIXEL_ORDER, enableValidationLayers, nullptr);
+    uploadVoxObject(&renderer, object, voxBlocks, palettes);
+
+    OffscreenFrameCallback keepFrame = [&render](int64_t frameId, const uint8_t *pixels, VkExtent2D extent){
+        render.images[frameId].assign(pixels, pixels + (size_t)extent.width * extent.height * 4);
+    };
+    for (uint32_t i = 0; i < poses.size(); i++){
+        CamInfoBuffer camInfo = createCamInfo(poses[i]);
+        drawOffscreenFrame(&renderer, &camInfo, i, keepFrame);
+    }
+    finishOffscreenFrames(&renderer, keepFrame);
+
+    vkDeviceWaitIdle(renderer.device);
+    cleanupRenderer(&renderer);
+    return render;
+}
+
+GoldenRender renderGoldenCpu(GoldenOptions *options, CpuRenderer *cpuRenderer, const std::vector<Camera> &poses)
+{
+    GoldenRender render{std::string("cpu-") + cpuRaycastPathName(cpuRenderer->path), {}};
+    resizeCpuFramebuffer(&cpuRenderer->framebuffer, options->extent.width, options->extent.height);
+    for (Camera pose : poses){
+        CamInfoBuffer camInfo = createCamInfo(pose);
+        renderCpuFrame(cpuRenderer, &camInfo);
+        render.images.push_back(cpuRenderer->framebuffer.pixels);
+    }
+    return render;
+}
+
+std::vector<uint64_t> countGoldenSteps(GoldenOptions *options, const CpuScene *scene, const std::vector<Camera> &poses)
+{
+    std::vector<uint64_t> steps;
+    for (Camera pose : poses){
+        CamInfoBuffer camInfo = createCamInfo(pose);
+        uint64_t poseSteps = 0;
+        for (uint32_t row = 0; row < options->extent.height; row++)
+            poseSteps += cpuTraversalSteps(scene, &camInfo, options->extent.width, options->extent.height, row);
+        steps.push_back(poseSteps);
+    }
+    return steps;
+}
+
+void writeGoldenSteps(GoldenOptions *options, const std::vector<uint64_t> &steps)
+{
+    std::string filename = options->directory + "/" + GOLDEN_STEPS_FILE;
+    FILE *file;
+    if ((file = fopen(filename.c_str(), "w")) == NULL)
+        throw std::runtime_error("cant open golden steps file " + filename);
+    for (uint64_t poseSteps : steps)
+        fprintf(file, "%lu\n", (unsigned long)poseSteps);
+    fclose(file);
+}
+
+std::vector<uint64_t> readGoldenSteps(GoldenOptions *options)
+{
+    std::vector<uint64_t> steps;
+    FILE *file;
+    if ((file = fopen((options->directory + "/" + GOLDEN_STEPS_FILE).c_str(), "r")) == NULL)
+        return steps;
+    unsigned long poseSteps;
+    while (fscanf(file, "%lu\n", &poseSteps) == 1)
+        steps.push_back(poseSteps);
+    fclose(file);
+    return steps;
+}
+
+// Counts pixels differing by more than the tolerance and, if there are any,
+// writes an image with matching pixels as dimmed grey and the rest in red.
+uint32_t compareWithGolden(
+    GoldenOptions *options,
+    const std::vector<uint8_t> &image,
+    const std::vector<uint8_t> &golden,
+    std::string diffFilename,
+    uint32_t *maxDifference)
+{
+    std::vector<uint8_t> diff(image.size());
+    uint32_t mismatches = 0;
+    *maxDifference = 0;
+    for (size_t i = 0; i < image.size(); i += 4){
+        uint32_t difference = 0;
+        for (uint32_t channel = 0; channel < 3; channel++)
+            difference = std::max(difference, (uint32_t)abs(image[i + channel] - golden[i + channel]));
+        *maxDifference = std::max(*maxDifference, difference);
+
+        if (difference > options->channelTolerance){
+            mismatches++;
+            diff[i + 0] = std::min(255u, 128 + difference);
+            diff[i + 1] = 0;
+            diff[i + 2] = 0;
+        }else{
+            uint8_t grey = (golden[i + 0] + golden[i + 1] + golden[i + 2]) / 9;
+            diff[i + 0] = diff[i + 1] = diff[i + 2] = grey;
+        }
+        diff[i + 3] = 255;
+    }
+
+    if (mismatches > 0)
+        writePpm(diffFilename, diff.data(), options->extent.width, options->extent.height);
+    return mismatches;
+}
+
+bool runGolden(
+    GoldenOptions options,
+    bool enableValidationLayers,
+    VoxObject object,
+    const unsigned char *voxBlocks,
+    MemPool<Palette> *palettes,
+    WorkerPool *pool)
+{
+    std::vector<Camera> poses = createGoldenPoses(object);
+
+    CpuRenderer cpuRenderer{};
+    cpuRenderer.pool = pool;
+    cpuRenderer.scene = createCpuScene(object, voxBlocks, palettes);
+    std::vector<uint64_t> steps = countGoldenSteps(&options, &cpuRenderer.scene, poses);
+
+    if (options.update){
+        cpuRenderer.path = CPU_RAYCAST_SCALAR;
+        GoldenRender reference = renderGoldenCpu(&options, &cpuRenderer, poses);
+        for (uint32_t i = 0; i < poses.size(); i++)
+            writePpm(goldenImageName(&options, i), reference.images[i].data(), options.extent.width, options.extent.height);
+        writeGoldenSteps(&options, steps);
+        printf("wrote %lu golden images to %s\n", (unsigned long)poses.size(), options.directory.c_str());
+        return true;
+    }
+
+    std::vector<GoldenRender> renders;
+    if (!options.cpuOnly)
+        renders.push_back(renderGoldenGpu(&options, enableValidationLayers, object, voxBlocks, palettes, poses));
+    for (CpuRaycastPath path : {CPU_RAYCAST_SCALAR, CPU_RAYCAST_AVX2}){
+        if (!cpuRaycastPathSupported(path))
+            continue;
+        cpuRenderer.path = path;
+        renders.push_back(renderGoldenCpu(&options, &cpuRenderer, poses));
+    }
+
+    std::vector<uint64_t> goldenSteps = readGoldenSteps(&options);
+    uint32_t allowedMismatches = options.maxMismatchFraction * options.extent.width * options.extent.height;
+    bool passed = true;
+    for (uint32_t i = 0; i < poses.size(); i++){
+        std::vector<uint8_t> golden;
+        uint32_t width, height;
+        if (!readPpm(goldenImageName(&options, i), &golden, &width, &height))
+            throw std::runtime_error("missing golden image " + goldenImageName(&options, i) + ", run with --golden-update");
+        if (width != options.extent.width || height != options.extent.height)
+            throw std::runtime_error("golden image " + goldenImageName(&options, i) + " has a different size");
+
+        for (const GoldenRender &render : renders){
+            char diffName[64];
+            snprintf(diffName, sizeof(diffName), "pose_%02u_%s.ppm", i, render.renderer.c_str());
+            uint32_t maxDifference;
+            uint32_t mismatches = compareWithGolden(
+                &options, render.images[i], golden, options.diffDirectory + "/" + diffName, &maxDifference);
+
+            bool matched = mismatches <= allowedMismatches;
+            passed = passed && matched;
+            printf(
+                "pose %2u %-10s %s  %6u pixels differ, max difference %3u\n",
+                i, render.renderer.c_str(), matched ? "ok  " : "FAIL", mismatches, maxDifference);
+        }
+
+        // Step counts only change when traversal does, which is worth knowing but not an error.
+        if (i < goldenSteps.size() && goldenSteps[i] != steps[i])
+            printf(
+                "pose %2u traversal steps changed from %lu to %lu\n",
+                i, (unsigned long)goldenSteps[i], (unsigned long)steps[i]);
+    }
+    return passed;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "vox_object.hpp"
+#include "cpu/worker_pool.hpp"
+
+struct GoldenOptions
+{
+    VkExtent2D extent;
+    // Golden images and step counts are read from here, one ppm per pose.
+    std::string directory;
+    // Diff images of renders that did not match are written here.
+    std::string diffDirectory;
+    // Largest difference of a colour channel that still counts as a match.
+    uint32_t channelTolerance;
+    // Fraction of pixels allowed to differ by more than channelTolerance.
+    double maxMismatchFraction;
+    // Write the cpu reference renders as the new goldens instead of comparing.
+    bool update;
+    // Skip the Vulkan renderer, for machines without a Vulkan driver.
+    bool cpuOnly;
+};
+
+GoldenOptions defaultGoldenOptions();
+
+// Renders a fixed set of poses with the compute shader and every supported cpu
+// path and compares each with the golden images. Goldens are rendered by the
+// scalar cpu path, the reference the others are checked against. Returns false
+// if any render did not match.
+bool runGolden(
+    GoldenOptions options,
+    bool enableValidationLayers,
+    VoxObject object,
+    const unsigned char *voxBlocks,
+    MemPool<Palette> *palettes,
+    WorkerPool *pool);
@@ -0,0 +1,174 @@
+#include "headless.hpp"
+
+#include <stdio.h>
+#include <stdexcept>
+#include <chrono>
+#include <vector>
+
+#include "renderer.hpp"
+#include "camera_controller.hpp"
+#include "image_file.hpp"
+#include "timing.hpp"
+#include "input_log.hpp"
+
+HeadlessOptions defaultHeadlessOptions()
+{
+    HeadlessOptions options{};
+    options.extent = VkExtent2D{800, 600};
+    options.frameCount = 0;
+    options.outputDirectory = ".";
+    options.format = IMAGE_FILE_PNG;
+    options.lod = true;
+    options.pixelOrder = DEFAULT_PIXEL_ORDER;
+    options.blockRaster = false;
+    return options;
+}
+
+ImageFileFormat parseImageFileFormat(std::string name)
+{
+    if (name == "none")
+        return IMAGE_FILE_NONE;
+    if (name == "ppm")
+        return IMAGE_FILE_PPM;
+    if (name == "png")
+        return IMAGE_FILE_PNG;
+    throw std::runtime_error("unknown image format " + name + ", expected none, ppm or png");
+}
+
+std::vector<Camera> loadCameraPoses(std::string posesFile)
+{
+    std::vector<Camera> poses;
+    if (posesFile.empty()){
+        poses.push_back(createStartCamera());
+        return poses;
+    }
+
+    FILE *file;
+    if ((file = fopen(posesFile.c_str(), "r")) == NULL)
+        throw std::runtime_error("cant open camera poses file " + posesFile);
+
+    Camera pose = createStartCamera();
+    while (fscanf(file, "%f %f %f %f %f %f\n",
+                  &pose.position.x, &pose.position.y, &pose.position.z,
+                  &pose.degreesRotation.x, &pose.degreesRotation.y, &pose.degreesRotation.z) == 6)
+        poses.push_back(pose);
+    fclose(file);
+
+    if (poses.empty())
+        throw std::runtime_error("camera poses file " + posesFile + " has no poses");
+    return poses;
+}
+
+std::vector<Camera> loadHeadlessPoses(HeadlessOptions *options)
+{
+    if (!options->inputLogFile.empty())
+        return replayInputLog(loadInputLog(options->inputLogFile));
+    return loadCameraPoses(options->posesFile);
+}
+
+void writeFrame(HeadlessOptions *options, int64_t frameId, const uint8_t *pixels, VkExtent2D extent)
+{
+    if (options->format == IMAGE_FILE_NONE)
+        return;
+
+    char name[32];
+    snprintf(name, sizeof(name), "frame_%05ld.%s", (long)frameId, options->format == IMAGE_FILE_PNG ? "png" : "ppm");
+    std::string filename = options->outputDirectory + "/" + name;
+
+    if (options->format == IMAGE_FILE_PNG)
+        writePng(filename, pixels, extent.width, extent.height);
+    else
+        writePpm(filename, pixels, extent.width, extent.height);
+}
+
+CamInfoBuffer createCamInfo(Camera camera)
+{
+    CamInfoBuffer camInfo;
+    camInfo.camPos = glm::vec4(camera.position, 0);
+    camInfo.camRotMat = camera.camToWorldRotMat();
+    return camInfo;
+}
+
+void printHeadlessTimes(HeadlessOptions *options, uint32_t frameCount, double seconds)
+{
+    printf(
+        "rendered %u frames at %ux%u in %.3f s (%.2f ms/frame, %.1f fps)\n",
+        frameCount, options->extent.width, options->extent.height,
+        seconds, seconds * 1000.0 / frameCount, frameCount / seconds);
+}
+
+void runCpuHeadless(HeadlessOptions options, CpuRenderer *cpuRenderer)
+{
+    std::vector<Camera> poses = loadHeadlessPoses(&options);
+    uint32_t frameCount = options.frameCount == 0 ? poses.size() : options.frameCount;
+    resizeCpuFramebuffer(&cpuRenderer->framebuffer, options.extent.width, options.extent.height);
+
+    printf(
+        "Rendering headless on the cpu, %s path on %u threads\n",
+        cpuRaycastPathName(cpuRenderer->path), cpuRenderer->pool->workerCount);
+
+    // Only tracing is timed, not writing the images.
+    double seconds = 0;
+    for (uint32_t i = 0; i < frameCount; i++){
+        CamInfoBuffer camInfo = createCamInfo(poses[i % poses.size()]);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        renderCpuFrame(cpuRenderer, &camInfo);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        writeFrame(&options, i, cpuRenderer->framebuffer.pixels.data(), options.extent);
+    }
+
+    printHeadlessTimes(&options, frameCount, seconds);
+    double rays = (double)frameCount * options.extent.width * options.extent.height;
+    printf(
+        "%.2f million rays per second, %lu tiles stolen\n",
+        rays / seconds / 1e6, (unsigned long)cpuRenderer->pool->steals.load());
+}
+
+void runHeadless(
+    HeadlessOptions options,
+    bool enableValidationLayers,
+    VoxObject object,
+    const unsigned char *voxBlocks,
+    MemPool<Palette> *palettes,
+    GpuProfilerOutput *profilerOutput,
+    CpuRenderer *cpuRenderer)
+{
+    if (cpuRenderer != nullptr){
+        runCpuHeadless(options, cpuRenderer);
+        return;
+    }
+
+    PhaseTimer startupTimer = startPhaseTimer();
+    SceneLimits limits = voxObjectLimits(object, voxBlocks);
+    if (!options.lod)
+        limits.mipCount = 0;
+    limits.blockRaster = options.blockRaster;
+    Renderer renderer = createHeadlessRenderer(
+        options.extent, limits, options.pixelOrder, enableValidationLayers, &startupTimer);
+    uploadVoxObject(&renderer, object, voxBlocks, palettes);
+    markPhase(&startupTimer, "scene upload");
+    printPhaseTimes(&startupTimer, "headless startup");
+
+    std::vector<Camera> poses = loadHeadlessPoses(&options);
+    uint32_t frameCount = options.frameCount == 0 ? poses.size() : options.frameCount;
+
+    OffscreenFrameCallback onFrame = [&options](int64_t frameId, const uint8_t *pixels, VkExtent2D extent){
+        writeFrame(&options, frameId, pixels, extent);
+    };
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frameCount; i++){
+        CamInfoBuffer camInfo = createCamInfo(poses[i % poses.size()]);
+        drawOffscreenFrame(&renderer, &camInfo, i, onFrame);
+    }
+    finishOffscreenFrames(&renderer, onFrame);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printHeadlessTimes(&options, frameCount, seconds);
+    reportGpuProfiler(&renderer.profiler, profilerOutput, seconds);
+
+    vkDeviceWaitIdle(renderer.device);
+    cleanupRenderer(&renderer);
+}
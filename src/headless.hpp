@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "vox_object.hpp"
+#include "camera_controller.hpp"
+#include "vk/profiler.hpp"
+#include "cpu/tile_renderer.hpp"
+#include "renderer.hpp"
+
+enum ImageFileFormat
+{
+    IMAGE_FILE_NONE,
+    IMAGE_FILE_PPM,
+    IMAGE_FILE_PNG
+};
+
+struct HeadlessOptions
+{
+    VkExtent2D extent;
+    // One camera pose per line: "x y z yaw pitch roll", rotations in degrees as
+    // printed by the viewer's p key. Empty renders the start pose.
+    std::string posesFile;
+    // An input log recorded by the viewer, replayed instead of posesFile if set.
+    std::string inputLogFile;
+    // Frames to render, cycling through the poses. 0 renders each pose once.
+    uint32_t frameCount;
+    std::string outputDirectory;
+    // IMAGE_FILE_NONE still reads frames back but only times them.
+    ImageFileFormat format;
+    // Trace distant rays through the block mips, see SceneLimits::mipCount.
+    bool lod;
+    PixelOrder pixelOrder;
+    // Start rays at the rasterized block bounding boxes, see SceneLimits::blockRaster.
+    bool blockRaster;
+};
+
+HeadlessOptions defaultHeadlessOptions();
+CamInfoBuffer createCamInfo(Camera camera);
+ImageFileFormat parseImageFileFormat(std::string name);
+
+// A cpuRenderer traces the frames on the cpu instead of creating a Vulkan device.
+void runHeadless(
+    HeadlessOptions options,
+    bool enableValidationLayers,
+    VoxObject object,
+    const unsigned char *voxBlocks,
+    MemPool<Palette> *palettes,
+    GpuProfilerOutput *profilerOutput,
+    CpuRenderer *cpuRenderer);
@@ -0,0 +1,152 @@
+#include "image_file.hpp"
+
+#include <stdio.h>
+#include <stdexcept>
+#include <vector>
+
+FILE *openImageFile(std::string filename)
+{
+    FILE *file;
+    if ((file = fopen(filename.c_str(), "wb")) == NULL)
+        throw std::runtime_error("cant open image file " + filename);
+    return file;
+}
+
+void writePpm(std::string filename, const uint8_t *pixels, uint32_t width, uint32_t height)
+{
+    FILE *file = openImageFile(filename);
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+    std::vector<uint8_t> row(width * 3);
+    for (uint32_t y = 0; y < height; y++){
+        for (uint32_t x = 0; x < width; x++){
+            const uint8_t *pixel = &pixels[(y * width + x) * 4];
+            row[x * 3 + 0] = pixel[0];
+            row[x * 3 + 1] = pixel[1];
+            row[x * 3 + 2] = pixel[2];
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    fclose(file);
+}
+
+bool readPpm(std::string filename, std::vector<uint8_t> *pixels, uint32_t *width, uint32_t *height)
+{
+    FILE *file;
+    if ((file = fopen(filename.c_str(), "rb")) == NULL)
+        return false;
+
+    uint32_t maxValue;
+    // The single whitespace after the max value ends the header.
+    if (fscanf(file, "P6 %u %u %u", width, height, &maxValue) != 3 || maxValue != 255 || fgetc(file) == EOF){
+        fclose(file);
+        throw std::runtime_error(filename + " is not an 8 bit binary ppm");
+    }
+
+    std::vector<uint8_t> row(*width * 3);
+    pixels->resize((size_t)*width * *height * 4);
+    for (uint32_t y = 0; y < *height; y++){
+        if (fread(row.data(), 1, row.size(), file) != row.size()){
+            fclose(file);
+            throw std::runtime_error("ppm file " + filename + " is truncated");
+        }
+        for (uint32_t x = 0; x < *width; x++){
+            uint8_t *pixel = &(*pixels)[((size_t)y * *width + x) * 4];
+            pixel[0] = row[x * 3 + 0];
+            pixel[1] = row[x * 3 + 1];
+            pixel[2] = row[x * 3 + 2];
+            pixel[3] = 255;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc)
+{
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady){
+        for (uint32_t i = 0; i < 256; i++){
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void pushBigEndian(std::vector<uint8_t> *bytes, uint32_t value)
+{
+    bytes->push_back(value >> 24);
+    bytes->push_back(value >> 16);
+    bytes->push_back(value >> 8);
+    bytes->push_back(value);
+}
+
+void writePngChunk(FILE *file, const char type[4], const std::vector<uint8_t> &data)
+{
+    std::vector<uint8_t> chunk;
+    pushBigEndian(&chunk, data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    // The crc covers the type and data but not the length.
+    pushBigEndian(&chunk, crc32(&chunk[4], chunk.size() - 4, 0));
+    fwrite(chunk.data(), 1, chunk.size(), file);
+}
+
+void writePng(std::string filename, const uint8_t *pixels, uint32_t width, uint32_t height)
+{
+    // Each scanline is prefixed with filter type 0 (none).
+    std::vector<uint8_t> raw;
+    raw.reserve((width * 4 + 1) * height);
+    for (uint32_t y = 0; y < height; y++){
+        raw.push_back(0);
+        raw.insert(raw.end(), &pixels[y * width * 4], &pixels[(y + 1) * width * 4]);
+    }
+
+    // zlib stream made of stored deflate blocks of at most 65535 bytes.
+    std::vector<uint8_t> zlib{0x78, 0x01};
+    uint32_t adlerA = 1, adlerB = 0;
+    for (size_t offset = 0; offset < raw.size() || offset == 0; ){
+        uint16_t blockSize = raw.size() - offset > 65535 ? 65535 : raw.size() - offset;
+        bool finalBlock = offset + blockSize == raw.size();
+        zlib.push_back(finalBlock ? 1 : 0);
+        zlib.push_back(blockSize & 0xFF);
+        zlib.push_back(blockSize >> 8);
+        zlib.push_back(~blockSize & 0xFF);
+        zlib.push_back((~blockSize >> 8) & 0xFF);
+        for (size_t i = offset; i < offset + blockSize; i++){
+            zlib.push_back(raw[i]);
+            adlerA = (adlerA + raw[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        offset += blockSize;
+        if (finalBlock)
+            break;
+    }
+    pushBigEndian(&zlib, (adlerB << 16) | adlerA);
+
+    std::vector<uint8_t> header;
+    pushBigEndian(&header, width);
+    pushBigEndian(&header, height);
+    header.push_back(8); // bit depth
+    header.push_back(6); // colour type RGBA
+    header.push_back(0); // compression
+    header.push_back(0); // filter
+    header.push_back(0); // interlace
+
+    FILE *file = openImageFile(filename);
+    const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(signature, 1, sizeof(signature), file);
+    writePngChunk(file, "IHDR", header);
+    writePngChunk(file, "IDAT", zlib);
+    writePngChunk(file, "IEND", std::vector<uint8_t>());
+    fclose(file);
+}
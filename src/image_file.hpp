@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// pixels are tightly packed RGBA8 rows, top row first. Alpha is dropped.
+void writePpm(std::string filename, const uint8_t *pixels, uint32_t width, uint32_t height);
+// Reads a binary PPM written by writePpm into RGBA8 rows with alpha 255. Returns
+// false if the file does not exist.
+bool readPpm(std::string filename, std::vector<uint8_t> *pixels, uint32_t *width, uint32_t *height);
+// Writes an uncompressed (stored deflate) RGBA PNG, so no zlib is needed.
+void writePng(std::string filename, const uint8_t *pixels, uint32_t width, uint32_t height);
@@ -24,6 +24,7 @@ InputState pollInput(GLFWwindow *window)
     state.space = isKeyDown(window, GLFW_KEY_SPACE);
 
     state.p = isKeyDown(window, GLFW_KEY_P);
+    state.e = isKeyDown(window, GLFW_KEY_E);
 
     return state;
 }
@@ -15,6 +15,8 @@ struct InputState
     bool leftShift = false;
     bool space = false;
     bool p = false;
+    // Digs a hole where the camera looks, see digVoxHole.
+    bool e = false;
 };
 
 InputState pollInput(GLFWwindow *window);
@@ -0,0 +1,128 @@
+#include "input_log.hpp"
+
+#include <string.h>
+#include <stdexcept>
+
+const char INPUT_LOG_MAGIC[4] = {'V', 'X', 'I', 'N'};
+const uint32_t INPUT_LOG_VERSION = 1;
+
+enum InputLogKey
+{
+    INPUT_LOG_RIGHT_ARROW = 1 << 0,
+    INPUT_LOG_LEFT_ARROW = 1 << 1,
+    INPUT_LOG_UP_ARROW = 1 << 2,
+    INPUT_LOG_DOWN_ARROW = 1 << 3,
+    INPUT_LOG_D = 1 << 4,
+    INPUT_LOG_A = 1 << 5,
+    INPUT_LOG_W = 1 << 6,
+    INPUT_LOG_S = 1 << 7,
+    INPUT_LOG_LEFT_SHIFT = 1 << 8,
+    INPUT_LOG_SPACE = 1 << 9,
+    INPUT_LOG_P = 1 << 10,
+    INPUT_LOG_E = 1 << 11
+};
+
+uint16_t packInputState(InputState state)
+{
+    uint16_t keys = 0;
+    keys |= state.rightArrow ? INPUT_LOG_RIGHT_ARROW : 0;
+    keys |= state.leftArrow ? INPUT_LOG_LEFT_ARROW : 0;
+    keys |= state.upArrow ? INPUT_LOG_UP_ARROW : 0;
+    keys |= state.downArrow ? INPUT_LOG_DOWN_ARROW : 0;
+    keys |= state.d ? INPUT_LOG_D : 0;
+    keys |= state.a ? INPUT_LOG_A : 0;
+    keys |= state.w ? INPUT_LOG_W : 0;
+    keys |= state.s ? INPUT_LOG_S : 0;
+    keys |= state.leftShift ? INPUT_LOG_LEFT_SHIFT : 0;
+    keys |= state.space ? INPUT_LOG_SPACE : 0;
+    keys |= state.p ? INPUT_LOG_P : 0;
+    keys |= state.e ? INPUT_LOG_E : 0;
+    return keys;
+}
+
+InputState unpackInputState(uint16_t keys)
+{
+    InputState state;
+    state.rightArrow = keys & INPUT_LOG_RIGHT_ARROW;
+    state.leftArrow = keys & INPUT_LOG_LEFT_ARROW;
+    state.upArrow = keys & INPUT_LOG_UP_ARROW;
+    state.downArrow = keys & INPUT_LOG_DOWN_ARROW;
+    state.d = keys & INPUT_LOG_D;
+    state.a = keys & INPUT_LOG_A;
+    state.w = keys & INPUT_LOG_W;
+    state.s = keys & INPUT_LOG_S;
+    state.leftShift = keys & INPUT_LOG_LEFT_SHIFT;
+    state.space = keys & INPUT_LOG_SPACE;
+    state.p = keys & INPUT_LOG_P;
+    state.e = keys & INPUT_LOG_E;
+    return state;
+}
+
+void startInputRecording(InputRecorder *recorder, std::string filename)
+{
+    recorder->frameCount = 0;
+    if ((recorder->file = fopen(filename.c_str(), "wb")) == NULL)
+        throw std::runtime_error("cant open input log " + filename);
+
+    fwrite(INPUT_LOG_MAGIC, sizeof(INPUT_LOG_MAGIC), 1, recorder->file);
+    fwrite(&INPUT_LOG_VERSION, sizeof(INPUT_LOG_VERSION), 1, recorder->file);
+}
+
+void recordInputFrame(InputRecorder *recorder, InputState state, float deltaTime)
+{
+    // Fields are written one by one so the struct's padding never reaches the file.
+    uint16_t keys = packInputState(state);
+    fwrite(&keys, sizeof(keys), 1, recorder->file);
+    fwrite(&deltaTime, sizeof(deltaTime), 1, recorder->file);
+    recorder->frameCount++;
+}
+
+void stopInputRecording(InputRecorder *recorder)
+{
+    fclose(recorder->file);
+    recorder->file = NULL;
+    printf("recorded %lu input frames\n", (unsigned long)recorder->frameCount);
+}
+
+std::vector<InputLogFrame> loadInputLog(std::string filename)
+{
+    FILE *file;
+    if ((file = fopen(filename.c_str(), "rb")) == NULL)
+        throw std::runtime_error("cant open input log " + filename);
+
+    char magic[4];
+    uint32_t version;
+    if (fread(magic, sizeof(magic), 1, file) != 1 ||
+        fread(&version, sizeof(version), 1, file) != 1 ||
+        memcmp(magic, INPUT_LOG_MAGIC, sizeof(magic)) != 0){
+        fclose(file);
+        throw std::runtime_error(filename + " is not an input log");
+    }
+    if (version != INPUT_LOG_VERSION){
+        fclose(file);
+        throw std::runtime_error("input log " + filename + " has unsupported version " + std::to_string(version));
+    }
+
+    std::vector<InputLogFrame> frames;
+    uint16_t keys;
+    float deltaTime;
+    while (fread(&keys, sizeof(keys), 1, file) == 1 &&
+           fread(&deltaTime, sizeof(deltaTime), 1, file) == 1)
+        frames.push_back(InputLogFrame{unpackInputState(keys), deltaTime});
+    fclose(file);
+
+    if (frames.empty())
+        throw std::runtime_error("input log " + filename + " has no frames");
+    return frames;
+}
+
+std::vector<Camera> replayInputLog(const std::vector<InputLogFrame> &frames)
+{
+    std::vector<Camera> cameras;
+    Camera camera = createStartCamera();
+    for (const InputLogFrame &frame : frames){
+        updateCamera(&camera, frame.state, frame.deltaTime);
+        cameras.push_back(camera);
+    }
+    return cameras;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "input.hpp"
+#include "camera_controller.hpp"
+
+// One frame of a recorded session: the keys held and the time step the camera
+// was advanced by.
+struct InputLogFrame
+{
+    InputState state;
+    float deltaTime;
+};
+
+struct InputRecorder
+{
+    FILE *file;
+    uint64_t frameCount;
+};
+
+// The log is a small header followed by 6 bytes per frame, written in the
+// machine's byte order.
+void startInputRecording(InputRecorder *recorder, std::string filename);
+void recordInputFrame(InputRecorder *recorder, InputState state, float deltaTime);
+void stopInputRecording(InputRecorder *recorder);
+
+std::vector<InputLogFrame> loadInputLog(std::string filename);
+// The camera after each frame of the log, starting from the start camera. Only
+// the recorded time steps are used so the path is the same on every machine.
+std::vector<Camera> replayInputLog(const std::vector<InputLogFrame> &frames);
@@ -12,6 +12,19 @@
 #include "input.hpp"
 #include "camera_controller.hpp"
 #include "vox_object.hpp"
+#include "timing.hpp"
+#include "headless.hpp"
+#include "frame_telemetry.hpp"
+#include "frame_latency.hpp"
+#include "bench.hpp"
+#include "input_log.hpp"
+#include "scene_generator.hpp"
+#include "golden.hpp"
+#include "vox_file.hpp"
+#include "chunk_streamer.hpp"
+#include "block_residency.hpp"
+#include "vox_light.hpp"
+#include "vox_edit.hpp"
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -22,34 +35,112 @@ const bool enableValidationLayers = true;
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
-void mainLoop(GLFWwindow *window, Renderer *renderer)
+struct LaunchOptions
 {
-    Camera camera;
-    camera.position = glm::vec3(107.9, 52.4, 89.7);
-    camera.degreesRotation = glm::vec3(-125, -22, 0);
-    camera.speed = 30;
-    camera.rotateSpeed = 70;
+    bool headless;
+    HeadlessOptions headlessOptions;
+    bool bench;
+    BenchOptions benchOptions;
+    bool golden;
+    GoldenOptions goldenOptions;
+    bool printGpuProfile;
+    std::string gpuProfileCsvFile;
+    bool printFrameStats;
+    std::string frameCsvFile;
+    // Sample input and write the camera right before submit, see drawLatchedFrame.
+    bool lowLatency;
+    // Print the time from input to the gpu finishing each frame.
+    bool printLatencyStats;
+    // Render on the cpu backend instead of the compute shader.
+    bool cpu;
+    CpuRaycastPath cpuPath;
+    // 0 uses every hardware thread.
+    uint32_t cpuThreads;
+    std::string recordInputFile;
+    std::string replayInputFile;
+    // Generate the scene instead of loading scene.ply.
+    bool generateScene;
+    SceneGeneratorOptions sceneOptions;
+    // Load a native scene file instead of scene.ply, its block scale wins over blockScale.
+    std::string sceneFile;
+    // Write the scene out as a native scene file once it is loaded or generated.
+    std::string saveSceneFile;
+    // Stream an endless generated scene around the camera, sceneOptions.height tall.
+    bool stream;
+    StreamingOptions streamingOptions;
+    // Keep only the blocks the shader reports needing in gpu memory.
+    bool residency;
+    ResidencyOptions residencyOptions;
+    // Bake ambient light into the scene and shade hits with it.
+    bool bakeLight;
+    // Rasterize the grid's block bounding boxes and start rays at them.
+    bool blockRaster;
+    // Edge length of a vox block in voxels, see isSupportedVoxBlockScale.
+    uint32_t blockScale;
+    // Trace distant rays through the block mips.
+    bool lod;
+    PixelOrder pixelOrder;
+};
 
-    double thisSecondStartTime = glfwGetTime();
-    double previousFrameTime = 0;
-    uint framesThisSecond = 0;
+// If startupTimer is not null the first frame is waited on and the startup breakdown printed.
+// If replay is not null its frames drive the camera instead of the keyboard and
+// the window closes when they run out. If streamer is not null the camera moves
+// through its world and the window follows. If residency is not null blocks are
+// loaded and evicted from the shader's feedback. If editor is not null E digs a
+// hole where the camera looks. With lowLatency input is sampled once the frame
+// is ready to submit, after streaming, residency and edits.
+template<uint32_t N>
+void mainLoop(
+    GLFWwindow *window,
+    Renderer *renderer,
+    PhaseTimer *startupTimer,
+    GpuProfilerOutput *profilerOutput,
+    FrameTelemetry *telemetry,
+    CpuRenderer *cpuRenderer,
+    InputRecorder *recorder,
+    const std::vector<InputLogFrame> *replay,
+    ChunkStreamer<N> *streamer,
+    BlockResidency *residency,
+    VoxEditor<N> *editor,
+    bool lowLatency)
+{
+    Camera camera = createStartCamera();
 
-    while (!glfwWindowShouldClose(window))
-    {
-        double currentTime = glfwGetTime();
-        framesThisSecond++;
-        float deltaTime = currentTime - previousFrameTime;
-        if(currentTime - thisSecondStartTime >= 1.0){
-            std::string fps = std::to_string(framesThisSecond);
-            std::string title = "Ray Caster fps: " + fps;
-            glfwSetWindowTitle(window, title.c_str());
+    double thisSecondStartTime = glfwGetTime();
+    double previousInputTime = 0;
+    // Frames whose input was sampled, a latched frame skipped on a swapchain
+    // recreation samples none.
+    uint64_t inputFrame = 0;
+    uint64_t frame = 0;
+    // A dig happens once per press of E, in the next updateScene.
+    bool digHeld = false;
+    bool digRequested = false;
 
-            framesThisSecond = 0;
-            thisSecondStartTime = currentTime;
-        }
+    // Polls input and moves the camera, filling the input and camera stages of timings.
+    auto sampleInput = [&](FrameTimings *timings){
+        std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
+        timings->inputTime = stageStart;
+        double inputTime = glfwGetTime();
+        float deltaTime = inputTime - previousInputTime;
+        previousInputTime = inputTime;
 
         glfwPollEvents();
         InputState inputState = pollInput(window);
+        if (replay != nullptr){
+            // Recorded time steps rather than the wall clock so the path matches the recording.
+            inputState = (*replay)[inputFrame].state;
+            deltaTime = (*replay)[inputFrame].deltaTime;
+            if (inputFrame + 1 == replay->size())
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
+        inputFrame++;
+        if (recorder != nullptr)
+            recordInputFrame(recorder, inputState, deltaTime);
+        digRequested = digRequested || (inputState.e && !digHeld);
+        digHeld = inputState.e;
+        timings->milliseconds[FRAME_STAGE_INPUT] = millisecondsSince(stageStart);
+
+        stageStart = std::chrono::steady_clock::now();
         updateCamera(&camera, inputState, deltaTime);
         if (inputState.p){
             printf(
@@ -57,56 +148,484 @@ void mainLoop(GLFWwindow *window, Renderer *renderer)
                 camera.position.x, camera.position.y, camera.position.z,
                 camera.degreesRotation.x, camera.degreesRotation.y, camera.degreesRotation.z);
         }
+        timings->milliseconds[FRAME_STAGE_CAMERA] = millisecondsSince(stageStart);
+    };
 
+    // Streams, loads and edits blocks around the camera where it was last sampled.
+    auto updateScene = [&](FrameTimings *timings){
+        std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
+        if (streamer != nullptr)
+            updateChunkStreaming(streamer, renderer, camera.position);
+        if (residency != nullptr)
+            updateBlockResidency(residency, renderer);
+        bool dig = editor != nullptr && digRequested;
+        if (dig)
+            digVoxHole(editor, renderer, camera.position, camera.forwardDirection());
+        digRequested = false;
+        if (streamer != nullptr || residency != nullptr || dig)
+            timings->milliseconds[FRAME_STAGE_STREAMING] = millisecondsSince(stageStart);
+    };
+
+    auto cameraInfo = [&](){
         CamInfoBuffer camInfo;
         camInfo.camPos = glm::vec4(camera.position, 0);
+        if (streamer != nullptr)
+            camInfo.camPos = glm::vec4(streamingWindowPosition(streamer, camera.position), 0);
         camInfo.camRotMat = camera.camToWorldRotMat();
+        return camInfo;
+    };
+
+    while (!glfwWindowShouldClose(window))
+    {
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        FrameTimings timings{};
+        timings.frame = frame++;
+
+        double currentTime = glfwGetTime();
+        if(currentTime - thisSecondStartTime >= 1.0){
+            // Percentiles rather than an average so stutter shows up.
+            char title[128];
+            snprintf(
+                title, sizeof(title), "Ray Caster fps: %u  p50: %.1f ms  p99: %.1f ms",
+                telemetry->framesPerSecond.load(),
+                telemetry->p50Milliseconds.load(),
+                telemetry->p99Milliseconds.load());
+            glfwSetWindowTitle(window, title);
+
+            reportGpuProfiler(&renderer->profiler, profilerOutput, currentTime);
+
+            thisSecondStartTime = currentTime;
+        }
+
+        if (lowLatency){
+            updateScene(&timings);
+            drawLatchedFrame(renderer, [&](CamInfoBuffer *camInfo){
+                sampleInput(&timings);
+                *camInfo = cameraInfo();
+            }, &timings);
+        }else{
+            sampleInput(&timings);
+            updateScene(&timings);
+            CamInfoBuffer camInfo = cameraInfo();
+
+            if (cpuRenderer != nullptr){
+                std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
+                resizeCpuFramebuffer(
+                    &cpuRenderer->framebuffer,
+                    renderer->swapchain.extent.width,
+                    renderer->swapchain.extent.height);
+                renderCpuFrame(cpuRenderer, &camInfo);
+                timings.milliseconds[FRAME_STAGE_CPU_RENDER] = millisecondsSince(stageStart);
+
+                drawCpuFrame(renderer, &cpuRenderer->framebuffer, &timings);
+            }else{
+                drawFrame(renderer, &camInfo, &timings);
+            }
+        }
+
+        if (startupTimer != nullptr){
+            vkQueueWaitIdle(renderer->computeAndPresentQueue);
+            markPhase(startupTimer, "first frame");
+            printPhaseTimes(startupTimer, "time to first frame");
+            startupTimer = nullptr;
+        }
+
+        timings.milliseconds[FRAME_STAGE_TOTAL] = millisecondsSince(frameStart);
+        recordFrameTimings(telemetry, &timings);
+    }
+}
+
+void printUsage(const char *program)
+{
+    printf(
+        "usage: %s [--headless] [--size WxH] [--frames N] [--poses file] [--out dir] [--format png|ppm|none]\n"
+        "          [--cpu auto|scalar|avx2] [--threads N] [--record file] [--replay file]\n"
+        "          [--scene terrain|menger|sparse|solid] [--scene-size WxHxD] [--density f] [--seed N] [--block-scale 8|16|32]\n"
+        "          [--no-lod] [--pixel-order row|morton] [--load-scene file] [--save-scene file]\n"
+        "          [--stream] [--stream-radius N] [--stream-budget ms] [--residency] [--resident-mb N]\n"
+        "          [--bake-light] [--block-raster] [--low-latency] [--latency-stats]\n"
+        "          [--bench] [--bench-frames N] [--bench-out file] [--bench-baseline file]\n"
+        "          [--golden dir] [--golden-diff dir] [--golden-update] [--golden-tolerance N] [--golden-cpu-only]\n"
+        "          [--gpu-profile] [--gpu-profile-csv file] [--frame-stats] [--frame-csv file]\n",
+        program);
+}
 
-        drawFrame(renderer, &camInfo);
-        previousFrameTime = currentTime;
+// Returns false if the arguments could not be parsed.
+bool parseArguments(int argc, char **argv, LaunchOptions *options)
+{
+    options->headless = false;
+    options->headlessOptions = defaultHeadlessOptions();
+    options->bench = false;
+    options->benchOptions = defaultBenchOptions();
+    options->golden = false;
+    options->goldenOptions = defaultGoldenOptions();
+    options->printGpuProfile = false;
+    options->printFrameStats = false;
+    options->cpu = false;
+    options->cpuThreads = 0;
+    options->generateScene = false;
+    options->sceneOptions = defaultSceneGeneratorOptions();
+    options->blockScale = DEFAULT_VOX_BLOCK_SCALE;
+    options->lod = true;
+    options->pixelOrder = DEFAULT_PIXEL_ORDER;
+    options->stream = false;
+    options->streamingOptions = defaultStreamingOptions();
+    options->residency = false;
+    options->residencyOptions = defaultResidencyOptions();
+    options->bakeLight = false;
+    options->blockRaster = false;
+    options->lowLatency = false;
+    options->printLatencyStats = false;
+
+    HeadlessOptions *headlessOptions = &options->headlessOptions;
+    for (int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless"){
+            options->headless = true;
+        }else if (arg == "--size" && hasValue){
+            if (sscanf(argv[++i], "%ux%u", &headlessOptions->extent.width, &headlessOptions->extent.height) != 2)
+                return false;
+        }else if (arg == "--frames" && hasValue){
+            headlessOptions->frameCount = std::stoul(argv[++i]);
+        }else if (arg == "--poses" && hasValue){
+            headlessOptions->posesFile = argv[++i];
+        }else if (arg == "--out" && hasValue){
+            headlessOptions->outputDirectory = argv[++i];
+        }else if (arg == "--format" && hasValue){
+            headlessOptions->format = parseImageFileFormat(argv[++i]);
+        }else if (arg == "--bench"){
+            options->bench = true;
+        }else if (arg == "--bench-frames" && hasValue){
+            options->benchOptions.framesPerPath = std::stoul(argv[++i]);
+        }else if (arg == "--bench-out" && hasValue){
+            options->benchOptions.outputFile = argv[++i];
+        }else if (arg == "--bench-baseline" && hasValue){
+            options->benchOptions.baselineFile = argv[++i];
+        }else if (arg == "--golden" && hasValue){
+            options->golden = true;
+            options->goldenOptions.directory = argv[++i];
+        }else if (arg == "--golden-diff" && hasValue){
+            options->goldenOptions.diffDirectory = argv[++i];
+        }else if (arg == "--golden-update"){
+            options->goldenOptions.update = true;
+        }else if (arg == "--golden-tolerance" && hasValue){
+            options->goldenOptions.channelTolerance = std::stoul(argv[++i]);
+        }else if (arg == "--golden-cpu-only"){
+            options->goldenOptions.cpuOnly = true;
+        }else if (arg == "--cpu" && hasValue){
+            options->cpu = true;
+            options->cpuPath = parseCpuRaycastPath(argv[++i]);
+        }else if (arg == "--threads" && hasValue){
+            options->cpuThreads = std::stoul(argv[++i]);
+        }else if (arg == "--scene" && hasValue){
+            options->generateScene = true;
+            options->sceneOptions.kind = parseSceneKind(argv[++i]);
+        }else if (arg == "--scene-size" && hasValue){
+            SceneGeneratorOptions *scene = &options->sceneOptions;
+            if (sscanf(argv[++i], "%ux%ux%u", &scene->width, &scene->height, &scene->depth) != 3)
+                return false;
+        }else if (arg == "--block-scale" && hasValue){
+            options->blockScale = std::stoul(argv[++i]);
+            if (!isSupportedVoxBlockScale(options->blockScale))
+                return false;
+        }else if (arg == "--load-scene" && hasValue){
+            options->sceneFile = argv[++i];
+        }else if (arg == "--save-scene" && hasValue){
+            options->saveSceneFile = argv[++i];
+        }else if (arg == "--stream"){
+            options->stream = true;
+        }else if (arg == "--stream-radius" && hasValue){
+            options->streamingOptions.radius = std::stoul(argv[++i]);
+        }else if (arg == "--stream-budget" && hasValue){
+            options->streamingOptions.frameBudgetMilliseconds = std::stod(argv[++i]);
+        }else if (arg == "--residency"){
+            options->residency = true;
+        }else if (arg == "--resident-mb" && hasValue){
+            options->residency = true;
+            options->residencyOptions.budgetMegabytes = std::stoul(argv[++i]);
+        }else if (arg == "--bake-light"){
+            options->bakeLight = true;
+        }else if (arg == "--block-raster"){
+            options->blockRaster = true;
+        }else if (arg == "--no-lod"){
+            options->lod = false;
+        }else if (arg == "--pixel-order" && hasValue){
+            options->pixelOrder = parsePixelOrder(argv[++i]);
+        }else if (arg == "--density" && hasValue){
+            options->sceneOptions.density = std::stof(argv[++i]);
+        }else if (arg == "--seed" && hasValue){
+            options->sceneOptions.seed = std::stoul(argv[++i]);
+        }else if (arg == "--record" && hasValue){
+            options->recordInputFile = argv[++i];
+        }else if (arg == "--replay" && hasValue){
+            options->replayInputFile = argv[++i];
+        }else if (arg == "--gpu-profile"){
+            options->printGpuProfile = true;
+        }else if (arg == "--gpu-profile-csv" && hasValue){
+            options->gpuProfileCsvFile = argv[++i];
+        }else if (arg == "--frame-stats"){
+            options->printFrameStats = true;
+        }else if (arg == "--frame-csv" && hasValue){
+            options->frameCsvFile = argv[++i];
+        }else if (arg == "--low-latency"){
+            options->lowLatency = true;
+        }else if (arg == "--latency-stats"){
+            options->printLatencyStats = true;
+        }else{
+            return false;
+        }
     }
+    // Streaming needs the window's render loop and a scene it can generate.
+    if (options->stream && (options->headless || options->bench || options->golden || options->cpu ||
+        !options->sceneFile.empty() || !options->saveSceneFile.empty()))
+        return false;
+    // Feedback comes from the window's compute shader, and streaming uploads whole chunks.
+    if (options->residency && (options->headless || options->bench || options->golden || options->cpu || options->stream))
+        return false;
+    // The light is shaded by the window's compute shader, streamed chunks are not baked.
+    if (options->bakeLight && (options->headless || options->bench || options->golden || options->cpu || options->stream))
+        return false;
+    // The boxes are drawn by the gpu renderer, the golden harness compares its defaults.
+    if (options->blockRaster && (options->golden || options->cpu))
+        return false;
+    // Input is only sampled by the window's render loop, and latched by the gpu renderer.
+    if (options->lowLatency && (options->headless || options->bench || options->golden || options->cpu))
+        return false;
+    if (options->printLatencyStats && (options->headless || options->bench || options->golden))
+        return false;
+    options->streamingOptions.workerCount = options->cpuThreads;
+    headlessOptions->inputLogFile = options->replayInputFile;
+    headlessOptions->lod = options->lod;
+    options->benchOptions.lod = options->lod;
+    headlessOptions->pixelOrder = options->pixelOrder;
+    options->benchOptions.pixelOrder = options->pixelOrder;
+    headlessOptions->blockRaster = options->blockRaster;
+    options->benchOptions.blockRaster = options->blockRaster;
+    // The bench renders at the same size as headless mode.
+    options->benchOptions.extent = headlessOptions->extent;
+    return true;
 }
 
-int main()
+// Everything after argument parsing, instantiated once per block scale so the
+// cpu traversal works on VoxBlock<N> directly.
+template<uint32_t N>
+int runRayCaster(LaunchOptions options)
 {
+    GpuProfilerOutput profilerOutput = openGpuProfilerOutput(options.printGpuProfile, options.gpuProfileCsvFile);
+
+    PhaseTimer startupTimer = startPhaseTimer();
+
+    // The generator and golden harness use the worker pool too.
+    bool useWorkerPool = options.cpu || options.generateScene || options.golden || options.bakeLight;
+    WorkerPool workerPool;
+    if (useWorkerPool)
+        startWorkerPool(&workerPool, options.cpuThreads);
+
     char voxModelFileName[] = "scene.ply";
     MemPool<Palette> palettes(1);
-    MemPool<VoxBlock> voxBlocks(144);
+    // scene.ply fills at most 144 blocks of scale 16, each halving of the scale can need 8 times as many.
+    size_t plyBlockCapacity = N >= 16 ? 144 : 144 * (16 / N) * (16 / N) * (16 / N);
+    size_t blockCapacity = plyBlockCapacity;
+    if (options.generateScene)
+        blockCapacity = sceneBlockCapacity(options.sceneOptions, N);
+    else if (!options.sceneFile.empty())
+        blockCapacity = readVoxFileInfo(options.sceneFile).blockCount;
+    if (options.stream)
+        blockCapacity = streamingBlockCapacity(options.streamingOptions, options.sceneOptions, N);
+    MemPool<VoxBlock<N>> voxBlocks(blockCapacity);
     VoxObject object{};
-    loadPlyVoxObject(
-        voxModelFileName,
-        voxBlocks,
-        palettes,
-        &object
-    );
+    ChunkStreamer<N> streamer;
+    if (options.stream){
+        // The window starts empty and fills in from the first frame on.
+        startChunkStreaming(&streamer, options.streamingOptions, options.sceneOptions, &voxBlocks, &palettes, &object);
+        markPhase(&startupTimer, "streaming start");
+    }else if (options.generateScene){
+        generateVoxObject(options.sceneOptions, &workerPool, &voxBlocks, &palettes, &object);
+        markPhase(&startupTimer, "scene generation");
+    }else if (!options.sceneFile.empty()){
+        loadVoxFile(options.sceneFile, &voxBlocks, &palettes, &object);
+        markPhase(&startupTimer, "scene load");
+    }else{
+        loadPlyVoxObject(
+            voxModelFileName,
+            &voxBlocks,
+            &palettes,
+            &object
+        );
+        markPhase(&startupTimer, "scene load");
+    }
+    if (!options.saveSceneFile.empty()){
+        saveVoxFile(options.saveSceneFile, object, &voxBlocks, &palettes);
+        markPhase(&startupTimer, "scene save");
+    }
+    std::vector<unsigned char> voxLight;
+    if (options.bakeLight){
+        voxLight.resize(blockCapacity * voxBlockLightSize(N));
+        bakeVoxLight(&object, &voxBlocks, &workerPool, voxLight.data());
+        markPhase(&startupTimer, "light bake");
+    }
+
+    CpuRenderer cpuRenderer{};
+    if (options.cpu){
+        cpuRenderer.pool = &workerPool;
+        cpuRenderer.scene = createCpuScene(object, voxBlockBytes(&voxBlocks), &palettes);
+        cpuRenderer.path = options.cpuPath;
+    }
+
+    if (options.golden){
+        bool passed = runGolden(
+            options.goldenOptions,
+            enableValidationLayers,
+            object,
+            voxBlockBytes(&voxBlocks),
+            &palettes,
+            &workerPool);
+
+        stopWorkerPool(&workerPool);
+        closeGpuProfilerOutput(&profilerOutput);
+        palettes.cleanup();
+        voxBlocks.cleanup();
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (options.bench){
+        bool passed = runBench(
+            options.benchOptions,
+            enableValidationLayers,
+            object,
+            voxBlockBytes(&voxBlocks),
+            &palettes,
+            options.cpu ? &cpuRenderer : nullptr);
+
+        if (useWorkerPool)
+            stopWorkerPool(&workerPool);
+        closeGpuProfilerOutput(&profilerOutput);
+        palettes.cleanup();
+        voxBlocks.cleanup();
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (options.headless){
+        runHeadless(
+            options.headlessOptions,
+            enableValidationLayers,
+            object,
+            voxBlockBytes(&voxBlocks),
+            &palettes,
+            &profilerOutput,
+            options.cpu ? &cpuRenderer : nullptr);
+
+        if (useWorkerPool)
+            stopWorkerPool(&workerPool);
+        closeGpuProfilerOutput(&profilerOutput);
+        palettes.cleanup();
+        voxBlocks.cleanup();
+        return EXIT_SUCCESS;
+    }
 
     glfwInit();
     GLFWwindow *window = createWindow("Ray Caster", WIDTH, HEIGHT);
+    markPhase(&startupTimer, "window");
 
-    Renderer renderer = createRenderer(window, enableValidationLayers);
+    SceneLimits limits = options.stream ?
+        streamingSceneLimits(options.streamingOptions, options.sceneOptions, N) :
+        voxObjectLimits(object, voxBlockBytes(&voxBlocks));
+    if (!options.lod)
+        limits.mipCount = 0;
+    if (options.residency)
+        limits = blockResidencyLimits(limits, options.residencyOptions);
+    limits.bakedLight = options.bakeLight;
+    limits.blockRaster = options.blockRaster;
+    Renderer renderer = createRenderer(window, limits, options.pixelOrder, enableValidationLayers, &startupTimer);
+    trackFramebufferResize(window, &renderer.framebufferResized);
+    if (options.cpu)
+        enableCpuPresent(&renderer);
 
-    for(int i = 0; i < object.blockWidth * object.blockHeight * object.blockDepth; i++){
-        int32_t blockIndex = object.blockIndices[i];
-        if(blockIndex != 0){
-            printf("%d\n", blockIndex - 1);
-            updateBlock(&renderer, blockIndex - 1, voxBlocks.getBlock(blockIndex - 1));
-        }
+    if (!options.stream){
+        uploadVoxObject(&renderer, object, voxBlockBytes(&voxBlocks), &palettes);
+        if (options.bakeLight)
+            uploadVoxObjectLight(&renderer, object, voxLight.data());
+        markPhase(&startupTimer, "scene upload");
     }
+    BlockResidency residency;
+    if (options.residency)
+        startBlockResidency(&residency, options.residencyOptions, &renderer, voxBlockBytes(&voxBlocks));
 
-    updateObject(&renderer, object);
-    updatePalette(&renderer, palettes.getBlock(object.paletteIndex));
+    FrameTelemetry telemetry;
+    startFrameTelemetry(&telemetry, options.printFrameStats, options.frameCsvFile);
+    FrameLatencyProbe latencyProbe;
+    if (options.printLatencyStats){
+        startFrameLatencyProbe(&latencyProbe, renderer.device);
+        renderer.latencyProbe = &latencyProbe;
+    }
+
+    InputRecorder recorder{};
+    if (!options.recordInputFile.empty())
+        startInputRecording(&recorder, options.recordInputFile);
+    std::vector<InputLogFrame> replay;
+    if (!options.replayInputFile.empty())
+        replay = loadInputLog(options.replayInputFile);
+
+    // Streamed chunks and resident blocks are owned by the streamer and residency.
+    bool editable = !options.stream && !options.residency;
+    VoxEditor<N> editor{&object, &voxBlocks, &palettes, &workerPool, options.bakeLight ? voxLight.data() : nullptr};
 
     enableStickyKeys(window);
-    mainLoop(window, &renderer);
+    mainLoop(
+        window, &renderer, &startupTimer, &profilerOutput, &telemetry,
+        options.cpu ? &cpuRenderer : nullptr,
+        options.recordInputFile.empty() ? nullptr : &recorder,
+        options.replayInputFile.empty() ? nullptr : &replay,
+        options.stream ? &streamer : nullptr,
+        options.residency ? &residency : nullptr,
+        editable ? &editor : nullptr,
+        options.lowLatency);
 
+    if (!options.recordInputFile.empty())
+        stopInputRecording(&recorder);
+
+    stopFrameTelemetry(&telemetry);
     vkDeviceWaitIdle(renderer.device);
+    if (options.printLatencyStats){
+        stopFrameLatencyProbe(&latencyProbe);
+        renderer.latencyProbe = nullptr;
+    }
+    if (options.stream)
+        stopChunkStreaming(&streamer);
+    if (options.residency)
+        printBlockResidencyStats(&residency, &renderer);
 
     cleanupRenderer(&renderer);
     glfwDestroyWindow(window);
     glfwTerminate();
 
+    if (useWorkerPool)
+        stopWorkerPool(&workerPool);
+    closeGpuProfilerOutput(&profilerOutput);
     palettes.cleanup();
     voxBlocks.cleanup();
     
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+
+int main(int argc, char **argv)
+{
+    LaunchOptions options{};
+    if (!parseArguments(argc, argv, &options)){
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!options.sceneFile.empty() && !options.generateScene)
+        options.blockScale = readVoxFileInfo(options.sceneFile).blockScale;
+
+    switch (options.blockScale){
+    case 8:
+        return runRayCaster<8>(options);
+    case 32:
+        return runRayCaster<32>(options);
+    default:
+        return runRayCaster<16>(options);
+    }
+}
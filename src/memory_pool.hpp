@@ -3,12 +3,15 @@
 #include <stddef.h>
 #include <iostream>
 #include <stdlib.h>
+#include <vector>
 
 template<typename T>
 class MemPool{
 private:
     size_t max;
     size_t allocated;
+    // Freed indices below allocated, handed out again before new ones.
+    std::vector<size_t> freeIndices;
     T *data;
 public:
     MemPool(size_t max);
@@ -32,6 +35,11 @@ void MemPool<T>::cleanup(){
 
 template<typename T>
 size_t MemPool<T>::allocateBlock(){
+    if(!this->freeIndices.empty()){
+        size_t index = this->freeIndices.back();
+        this->freeIndices.pop_back();
+        return index;
+    }
     if(this->allocated >= this->max)
         throw std::runtime_error("cant allocate more in full pool");
     return this->allocated++;
@@ -39,7 +47,9 @@ size_t MemPool<T>::allocateBlock(){
 
 template<typename T>
 void MemPool<T>::freeBlock(size_t index){
-    throw std:: runtime_error("pool freeing not yet implimented");   
+    if(index >= this->allocated)
+        throw std::runtime_error("cant free a block that was never allocated");
+    this->freeIndices.push_back(index);
 }
 
 template<typename T>
@@ -0,0 +1,57 @@
+#include "palette_cache.hpp"
+
+#include <string.h>
+#include <stdexcept>
+
+// FNV-1a over the material bytes.
+uint64_t hashPalette(const Palette *palette)
+{
+    const unsigned char *bytes = (const unsigned char *)palette;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(Palette); i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+PaletteCache createPaletteCache(uint32_t capacity)
+{
+    PaletteCache cache{};
+    cache.capacity = capacity;
+    cache.rows.reserve(capacity);
+    return cache;
+}
+
+uint32_t findPaletteRow(const PaletteCache *cache, const Palette *palette)
+{
+    auto range = cache->rowsByHash.equal_range(hashPalette(palette));
+    for (auto it = range.first; it != range.second; it++)
+        if (memcmp(&cache->rows[it->second], palette, sizeof(Palette)) == 0)
+            return it->second;
+    return UINT32_MAX;
+}
+
+uint32_t countMissingPaletteRows(const PaletteCache *cache, uint32_t count, const Palette *const *palettes)
+{
+    std::vector<const Palette *> missing;
+    for (uint32_t i = 0; i < count; i++){
+        if (findPaletteRow(cache, palettes[i]) != UINT32_MAX)
+            continue;
+        bool repeated = false;
+        for (const Palette *palette : missing)
+            repeated = repeated || memcmp(palette, palettes[i], sizeof(Palette)) == 0;
+        if (!repeated)
+            missing.push_back(palettes[i]);
+    }
+    return missing.size();
+}
+
+uint32_t addPaletteRow(PaletteCache *cache, const Palette *palette)
+{
+    if (cache->rows.size() >= cache->capacity)
+        throw std::runtime_error("palette cache is full");
+
+    uint32_t row = cache->rows.size();
+    cache->rows.push_back(*palette);
+    cache->rowsByHash.emplace(hashPalette(palette), row);
+    return row;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include "vox_object.hpp"
+
+// Host copy of the palettes resident in the renderer's palette image, one per
+// row. Identical palettes share a row, so objects loaded from different pools
+// or scenes reuse what is already on the gpu.
+struct PaletteCache
+{
+    uint32_t capacity;
+    std::vector<Palette> rows;
+    // Rows by content hash, a hash can map to several rows if palettes collide.
+    std::unordered_multimap<uint64_t, uint32_t> rowsByHash;
+};
+
+PaletteCache createPaletteCache(uint32_t capacity);
+// Returns the row holding a palette equal to palette, or UINT32_MAX if there is none.
+uint32_t findPaletteRow(const PaletteCache *cache, const Palette *palette);
+// Rows addPaletteRow would add for palettes, a palette repeated in the batch counts once.
+uint32_t countMissingPaletteRows(const PaletteCache *cache, uint32_t count, const Palette *const *palettes);
+// Appends palette as a new row, throws if the cache is full.
+uint32_t addPaletteRow(PaletteCache *cache, const Palette *palette);
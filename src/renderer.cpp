@@ -5,9 +5,156 @@
 #include "vk/shader_module.hpp"
 #include "vk/command_buffers.hpp"
 #include "vk/exceptions.hpp"
+#include "vk/pipeline_cache.hpp"
+#include "vk/profiler.hpp"
+#include "vox_light.hpp"
+
+#include <iostream>
+#include <algorithm>
+
+// paletteIndex, blockWidth, blockHeight and blockDepth come before the block indices.
+const uint32_t OBJECT_INFO_HEADER_SIZE = 4 * sizeof(uint32_t);
+const char PIPELINE_CACHE_FILE[] = "pipeline_cache.bin";
+// local_size_x of shader.comp, an 8x8 tile in Morton order.
+const uint32_t RAYCAST_GROUP_SIZE = 64;
+// The draw command comes before the grid indices of the blocks to draw.
+const uint32_t BLOCK_BOUNDS_HEADER_SIZE = sizeof(VkDrawIndirectCommand);
+// A box is 12 triangles, see CUBE_CORNERS in block_bounds.vert.
+const uint32_t BLOCK_BOUNDS_VERTEX_COUNT = 36;
+// 32 bits so the shader can turn the depth back into a distance along the ray.
+const VkFormat BLOCK_DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+// constant_id of SHADER_PASS in shader.comp.
+const uint32_t SHADER_PASS_CONSTANT = 7;
+
+// Passes timed by the gpu profiler.
+enum ProfiledPass
+{
+    PASS_BLOCK_RASTER,
+    PASS_TARGET_BARRIER,
+    PASS_RAYCAST,
+    PASS_SHADING,
+    PASS_PRESENT_BARRIER,
+    PASS_READBACK,
+    PASS_BLOCK_UPLOAD,
+    PROFILED_PASS_COUNT
+};
+
+const std::vector<std::string> PROFILED_PASS_NAMES = {
+    "block raster",
+    "target barrier",
+    "raycast",
+    "shading",
+    "present barrier",
+    "readback",
+    "block upload"};
+
+void recordPresentBarrier(
+    VkCommandBuffer commandBuffer,
+    VkImage image,
+    VkImageSubresourceRange imageRange,
+    uint32_t computeFamilyIndex,
+    uint32_t presentFamilyIndex)
+{
+    VkImageMemoryBarrier postImageBarrier{};
+    postImageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    postImageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    postImageBarrier.dstAccessMask = 0;
+    postImageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    postImageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    postImageBarrier.srcQueueFamilyIndex = computeFamilyIndex;
+    postImageBarrier.dstQueueFamilyIndex = presentFamilyIndex;
+    postImageBarrier.image = image;
+    postImageBarrier.subresourceRange = imageRange;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &postImageBarrier);
+}
+
+// Copies a finished offscreen image into a host visible buffer.
+void recordReadback(
+    VkCommandBuffer commandBuffer,
+    VkImage image,
+    VkImageSubresourceRange imageRange,
+    VkExtent2D extent,
+    VkBuffer readbackBuffer)
+{
+    VkImageMemoryBarrier copyImageBarrier{};
+    copyImageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    copyImageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    copyImageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    copyImageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    copyImageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    copyImageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    copyImageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    copyImageBarrier.image = image;
+    copyImageBarrier.subresourceRange = imageRange;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &copyImageBarrier);
+
+    VkBufferImageCopy copyRegion{};
+    copyRegion.bufferOffset = 0;
+    copyRegion.bufferRowLength = 0;
+    copyRegion.bufferImageHeight = 0;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageOffset = VkOffset3D{0, 0, 0};
+    copyRegion.imageExtent = VkExtent3D{extent.width, extent.height, 1};
+
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &copyRegion);
+
+    VkBufferMemoryBarrier hostReadBarrier{};
+    hostReadBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostReadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostReadBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostReadBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostReadBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostReadBarrier.buffer = readbackBuffer;
+    hostReadBarrier.offset = 0;
+    hostReadBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        0, nullptr,
+        1, &hostReadBarrier,
+        0, nullptr);
+}
+
+PixelOrder parsePixelOrder(std::string name)
+{
+    if (name == "row")
+        return PIXEL_ORDER_ROW_MAJOR;
+    if (name == "morton")
+        return PIXEL_ORDER_MORTON;
+    throw std::runtime_error("unknown pixel order " + name);
+}
 
-const uint32_t MAX_VOX_BLOCK_COUNT = 200;
-const uint32_t OBJECT_INFO_MEM_SIZE = 1600;
+const char *pixelOrderName(PixelOrder order)
+{
+    return order == PIXEL_ORDER_MORTON ? "morton" : "row";
+}
+
+// Workgroups covering the target, in the shape shader.comp expects for order.
+VkExtent2D raycastGroupCount(PixelOrder order, VkExtent2D targetExtent)
+{
+    if (order == PIXEL_ORDER_MORTON)
+        return VkExtent2D{(targetExtent.width + 7) / 8, (targetExtent.height + 7) / 8};
+    return VkExtent2D{(targetExtent.width + RAYCAST_GROUP_SIZE - 1) / RAYCAST_GROUP_SIZE, targetExtent.height};
+}
 
 void createRenderCommandBuffers(
     VkDevice device,
@@ -15,11 +162,21 @@ void createRenderCommandBuffers(
     uint32_t count,
     VkPipelineLayout pipelineLayout,
     VkPipeline pipeline,
+    VkPipeline shadingPipeline,
+    const Pipeline *blockBoundsPipeline,
+    VkRenderPass blockBoundsRenderPass,
+    VkFramebuffer *blockBoundsFramebuffers,
+    VkBuffer blockBoundsBuffer,
     VkDescriptorSet *descriptorSets,
-    VkExtent2D swapchainImageExtent,
-    VkImage *swapchainImages,
+    VkExtent2D targetExtent,
+    PixelOrder pixelOrder,
+    VkImage *targetImages,
+    VkBuffer *readbackBuffers,
+    VkBuffer *feedbackBuffers,
+    VkBuffer *visibilityBuffers,
     uint32_t computeFamilyIndex,
     uint32_t presentFamilyIndex,
+    GpuProfiler *profiler,
     VkCommandBuffer *commandBuffers)
 {
     allocateCommandBuffers(device, commandPool, count, commandBuffers);
@@ -27,6 +184,58 @@ void createRenderCommandBuffers(
     for(int i = 0; i < count; i++){
         beginRecordingCommandBuffer(commandBuffers[i], VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
 
+        // Command buffer i writes the queries of profiler slot i.
+        recordProfilerReset(profiler, commandBuffers[i], i);
+
+        if (blockBoundsPipeline != nullptr){
+            // Reversed depth, cleared to 0 where no box is drawn.
+            VkClearValue clearDepth{};
+            clearDepth.depthStencil.depth = 0.0f;
+            clearDepth.depthStencil.stencil = 0;
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = blockBoundsRenderPass;
+            renderPassInfo.framebuffer = blockBoundsFramebuffers[i];
+            renderPassInfo.renderArea.offset = VkOffset2D{0, 0};
+            renderPassInfo.renderArea.extent = targetExtent;
+            renderPassInfo.clearValueCount = 1;
+            renderPassInfo.pClearValues = &clearDepth;
+
+            VkViewport viewport{};
+            viewport.x = 0;
+            viewport.y = 0;
+            viewport.width = targetExtent.width;
+            viewport.height = targetExtent.height;
+            viewport.minDepth = 0;
+            viewport.maxDepth = 1;
+            VkRect2D scissor{};
+            scissor.offset = VkOffset2D{0, 0};
+            scissor.extent = targetExtent;
+            float extent[2] = {(float)targetExtent.width, (float)targetExtent.height};
+
+            recordPassBegin(profiler, commandBuffers[i], i, PASS_BLOCK_RASTER);
+            vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, blockBoundsPipeline->pipeline);
+            vkCmdBindDescriptorSets(
+                commandBuffers[i],
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                blockBoundsPipeline->layout,
+                0,
+                1,
+                &descriptorSets[i],
+                0,
+                nullptr);
+            vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
+            vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
+            vkCmdPushConstants(
+                commandBuffers[i], blockBoundsPipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(extent), extent);
+            // The box count is written by updateObject, so the recording outlives grid changes.
+            vkCmdDrawIndirect(commandBuffers[i], blockBoundsBuffer, 0, 1, sizeof(VkDrawIndirectCommand));
+            vkCmdEndRenderPass(commandBuffers[i]);
+            recordPassEnd(profiler, commandBuffers[i], i, PASS_BLOCK_RASTER);
+        }
+
         vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
 
         vkCmdBindDescriptorSets(
@@ -54,9 +263,10 @@ void createRenderCommandBuffers(
         preImageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
         preImageBarrier.srcQueueFamilyIndex = presentFamilyIndex;
         preImageBarrier.dstQueueFamilyIndex = computeFamilyIndex;
-        preImageBarrier.image = swapchainImages[i];
+        preImageBarrier.image = targetImages[i];
         preImageBarrier.subresourceRange = imageRange;
 
+        recordPassBegin(profiler, commandBuffers[i], i, PASS_TARGET_BARRIER);
         vkCmdPipelineBarrier(
             commandBuffers[i],
             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
@@ -64,27 +274,65 @@ void createRenderCommandBuffers(
             0, nullptr,
             0, nullptr,
             1, &preImageBarrier);
+        recordPassEnd(profiler, commandBuffers[i], i, PASS_TARGET_BARRIER);
         
-        vkCmdDispatch(commandBuffers[i], swapchainImageExtent.width, swapchainImageExtent.width, 1);
-
-        VkImageMemoryBarrier postImageBarrier{};
-        postImageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        postImageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-        postImageBarrier.dstAccessMask = 0;
-        postImageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-        postImageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-        postImageBarrier.srcQueueFamilyIndex = computeFamilyIndex;
-        postImageBarrier.dstQueueFamilyIndex = presentFamilyIndex;
-        postImageBarrier.image = swapchainImages[i];
-        postImageBarrier.subresourceRange = imageRange;
-
+        recordPassBegin(profiler, commandBuffers[i], i, PASS_RAYCAST);
+        VkExtent2D groupCount = raycastGroupCount(pixelOrder, targetExtent);
+        vkCmdDispatch(commandBuffers[i], groupCount.width, groupCount.height, 1);
+        recordPassEnd(profiler, commandBuffers[i], i, PASS_RAYCAST);
+
+        // Both pipelines share the descriptor set layout, so the bound sets stay valid.
+        VkBufferMemoryBarrier visibilityBarrier{};
+        visibilityBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        visibilityBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        visibilityBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        visibilityBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        visibilityBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        visibilityBarrier.buffer = visibilityBuffers[i];
+        visibilityBarrier.offset = 0;
+        visibilityBarrier.size = VK_WHOLE_SIZE;
+
+        recordPassBegin(profiler, commandBuffers[i], i, PASS_SHADING);
         vkCmdPipelineBarrier(
             commandBuffers[i],
-            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
             0,
             0, nullptr,
-            0, nullptr,
-            1, &postImageBarrier);
+            1, &visibilityBarrier,
+            0, nullptr);
+        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, shadingPipeline);
+        vkCmdDispatch(commandBuffers[i], groupCount.width, groupCount.height, 1);
+        recordPassEnd(profiler, commandBuffers[i], i, PASS_SHADING);
+
+        if (feedbackBuffers != nullptr){
+            VkBufferMemoryBarrier feedbackBarrier{};
+            feedbackBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            feedbackBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            feedbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            feedbackBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            feedbackBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            feedbackBarrier.buffer = feedbackBuffers[i];
+            feedbackBarrier.offset = 0;
+            feedbackBarrier.size = VK_WHOLE_SIZE;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                0,
+                0, nullptr,
+                1, &feedbackBarrier,
+                0, nullptr);
+        }
+
+        if (readbackBuffers == nullptr){
+            recordPassBegin(profiler, commandBuffers[i], i, PASS_PRESENT_BARRIER);
+            recordPresentBarrier(commandBuffers[i], targetImages[i], imageRange, computeFamilyIndex, presentFamilyIndex);
+            recordPassEnd(profiler, commandBuffers[i], i, PASS_PRESENT_BARRIER);
+        }else{
+            recordPassBegin(profiler, commandBuffers[i], i, PASS_READBACK);
+            recordReadback(commandBuffers[i], targetImages[i], imageRange, targetExtent, readbackBuffers[i]);
+            recordPassEnd(profiler, commandBuffers[i], i, PASS_READBACK);
+        }
 
         handleVkResult(
             vkEndCommandBuffer(commandBuffers[i]),
@@ -92,10 +340,30 @@ void createRenderCommandBuffers(
     }
 }
 
-void updatePalette(Renderer *renderer, Palette *palette){
+// Uploads use the slot after the per target image slots.
+uint32_t uploadProfilerSlot(Renderer *renderer)
+{
+    return renderer->profiler.slotCount - 1;
+}
+
+void updatePalettes(Renderer *renderer, uint32_t count, const Palette *const *palettes, uint32_t *rows){
+    PaletteCache *cache = &renderer->paletteCache;
+    // Checked up front, rows added before a failure would never be uploaded.
+    if (cache->rows.size() + countMissingPaletteRows(cache, count, palettes) > cache->capacity)
+        throw std::runtime_error("palette cache is full");
+    uint32_t firstNewRow = cache->rows.size();
+    for (uint32_t i = 0; i < count; i++){
+        rows[i] = findPaletteRow(cache, palettes[i]);
+        if (rows[i] == UINT32_MAX)
+            rows[i] = addPaletteRow(cache, palettes[i]);
+    }
+    uint32_t newRowCount = cache->rows.size() - firstNewRow;
+    if (newRowCount == 0)
+        return;
+
     void *data;
-    vkMapMemory(renderer->device, renderer->paletteStagingBufferMemory, 0, 256 * 4, 0, &data);
-    memcpy(data, palette, 256 * 4);
+    vkMapMemory(renderer->device, renderer->paletteStagingBufferMemory, 0, newRowCount * sizeof(Palette), 0, &data);
+    memcpy(data, &cache->rows[firstNewRow], newRowCount * sizeof(Palette));
     vkUnmapMemory(renderer->device, renderer->paletteStagingBufferMemory);
 
     VkImageSubresourceRange paletteSubresourceRange = createImageSubresourceRange(
@@ -104,16 +372,17 @@ void updatePalette(Renderer *renderer, Palette *palette){
         0, 1
     );
 
+    // Rows uploaded earlier have to survive the transition, only the first upload may discard.
     transitionImageLayout(
         renderer->device,
         renderer->computeAndPresentQueue,
         renderer->transientComputeCommandPool,
         renderer->paletteImage,
         paletteSubresourceRange,
-        VK_IMAGE_LAYOUT_UNDEFINED,
+        firstNewRow == 0 ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_GENERAL,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        0,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        firstNewRow == 0 ? 0 : VK_ACCESS_SHADER_READ_BIT,
+        firstNewRow == 0 ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
         VK_ACCESS_TRANSFER_WRITE_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT
     );
@@ -122,8 +391,8 @@ void updatePalette(Renderer *renderer, Palette *palette){
         renderer->device,
         renderer->computeAndPresentQueue,
         renderer->transientComputeCommandPool,
-        VkOffset3D{0, 0, 0},
-        VkExtent3D{256, 1, 1},
+        VkOffset3D{0, (int32_t)firstNewRow, 0},
+        VkExtent3D{256, newRowCount, 1},
         VK_IMAGE_ASPECT_COLOR_BIT,
         0,
         0, 1,
@@ -146,154 +415,1074 @@ void updatePalette(Renderer *renderer, Palette *palette){
     );
 }
 
-void updateBlock(Renderer *renderer, int32_t blockIndex, VoxBlock *block){
-    void *data;
-    vkMapMemory(renderer->device, renderer->voxBlockStagingBufferMemory, 0, sizeof(VoxBlock), 0, &data);
-    memcpy(data, block->voxels, sizeof(VoxBlock));
-    vkUnmapMemory(renderer->device, renderer->voxBlockStagingBufferMemory);
+uint32_t updatePalette(Renderer *renderer, const Palette *palette){
+    uint32_t row;
+    updatePalettes(renderer, 1, &palette, &row);
+    return row;
+}
 
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = blockIndex * sizeof(VoxBlock);
-    copyRegion.size = sizeof(VoxBlock);
+// Bytes of one block at the renderer's block scale.
+VkDeviceSize voxBlockSize(Renderer *renderer)
+{
+    VkDeviceSize scale = renderer->sceneLimits.blockScale;
+    return scale * scale * scale;
+}
 
+// Bytes of the mip levels kept for each block, 0 without LOD.
+VkDeviceSize voxBlockMipBytes(Renderer *renderer)
+{
+    return voxBlockMipSize(renderer->sceneLimits.blockScale, renderer->sceneLimits.mipCount);
+}
+
+// Staging bytes of one batch of blocks, see stageVoxBlockBatch.
+VkDeviceSize voxBlockBatchStagingSize(Renderer *renderer)
+{
+    return VOX_BLOCK_UPLOAD_BATCH * (voxBlockSize(renderer) + voxBlockMipBytes(renderer) + sizeof(VoxBlockSlot));
+}
+
+// Copies out of staging of a batch staged by stageVoxBlockBatch.
+struct VoxBlockBatchRegions
+{
+    uint32_t blockCount;
+    VkBufferCopy blocks[VOX_BLOCK_UPLOAD_BATCH];
+    VkBufferCopy mips[VOX_BLOCK_UPLOAD_BATCH];
+    VkBufferCopy slots[VOX_BLOCK_UPLOAD_BATCH];
+};
+
+// Encodes up to VOX_BLOCK_UPLOAD_BATCH blocks and their mips into the staging
+// memory. Each block is encoded into a fresh slot and its old slot is freed,
+// blocks that are not resident only get their mips. Throws without changing any
+// slot if the heap has no room for the batch. The staging holds the batch's
+// encoded blocks, then their mips, then their slots.
+void stageVoxBlockBatch(
+    Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *voxels, bool resident,
+    VkDeviceMemory stagingMemory, VoxBlockBatchRegions *regions)
+{
+    uint32_t blockScale = renderer->sceneLimits.blockScale;
+    VkDeviceSize blockSize = voxBlockSize(renderer);
+    VkDeviceSize mipSize = voxBlockMipBytes(renderer);
+    VkDeviceSize mipsOffset = VOX_BLOCK_UPLOAD_BATCH * blockSize;
+    VkDeviceSize slotsOffset = mipsOffset + VOX_BLOCK_UPLOAD_BATCH * mipSize;
+
+    for (uint32_t i = 0; i < count; i++)
+        if (blockIndices[i] >= renderer->sceneLimits.voxBlockCount)
+            throw std::runtime_error("vox block index is beyond the renderer's scene limits");
+
+    // Slots are picked in a copy of the heap before mapping. Allocation throws
+    // once the heap is full, which then leaves the heap and the slots as they were.
+    VoxBlockHeap heap = renderer->voxBlockHeap;
+    VoxBlockSlot slots[VOX_BLOCK_UPLOAD_BATCH];
+    for (uint32_t i = 0; i < count; i++){
+        VoxBlockSlot slot = renderer->voxBlockSlots[blockIndices[i]];
+        // A block staged twice gives up the slot of its earlier entry.
+        for (uint32_t j = 0; j < i; j++)
+            if (blockIndices[j] == blockIndices[i])
+                slot = slots[j];
+        if (slot != VOX_BLOCK_SLOT_NONE)
+            freeVoxBlockSlot(&heap, slot);
+        slots[i] = resident ?
+            allocateVoxBlockSlot(&heap, chooseVoxBlockEncoding(voxels[i], blockScale)) :
+            VOX_BLOCK_SLOT_NONE;
+    }
+    renderer->voxBlockHeap = std::move(heap);
+    for (uint32_t i = 0; i < count; i++)
+        renderer->voxBlockSlots[blockIndices[i]] = slots[i];
+
+    regions->blockCount = 0;
+    VkDeviceSize encodedOffset = 0;
+    uint8_t *data;
+    vkMapMemory(renderer->device, stagingMemory, 0, VK_WHOLE_SIZE, 0, (void **)&data);
+    for (uint32_t i = 0; i < count; i++){
+        if (resident){
+            uint32_t encoding = voxBlockSlotEncoding(slots[i]);
+            VkDeviceSize encodedSize = encodedVoxBlockWords(blockScale, encoding) * sizeof(uint32_t);
+            encodeVoxBlock(voxels[i], blockScale, encoding, (uint32_t *)(data + encodedOffset));
+            VkBufferCopy *blockRegion = &regions->blocks[regions->blockCount++];
+            blockRegion->srcOffset = encodedOffset;
+            blockRegion->dstOffset = (VkDeviceSize)voxBlockSlotOffset(slots[i]) * sizeof(uint32_t);
+            blockRegion->size = encodedSize;
+            encodedOffset += encodedSize;
+        }
+
+        buildVoxBlockMips(
+            voxels[i], blockScale, renderer->sceneLimits.mipCount,
+            data + mipsOffset + i * mipSize);
+        regions->mips[i].srcOffset = mipsOffset + i * mipSize;
+        regions->mips[i].dstOffset = blockIndices[i] * mipSize;
+        regions->mips[i].size = mipSize;
+
+        memcpy(data + slotsOffset + i * sizeof(VoxBlockSlot), &slots[i], sizeof(VoxBlockSlot));
+        regions->slots[i].srcOffset = slotsOffset + i * sizeof(VoxBlockSlot);
+        regions->slots[i].dstOffset = blockIndices[i] * sizeof(VoxBlockSlot);
+        regions->slots[i].size = sizeof(VoxBlockSlot);
+    }
+    vkUnmapMemory(renderer->device, stagingMemory);
+}
+
+// Uploads up to VOX_BLOCK_UPLOAD_BATCH blocks and their mips in one transfer per buffer.
+void uploadVoxBlockBatch(
+    Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *voxels, bool resident)
+{
+    VoxBlockBatchRegions regions;
+    stageVoxBlockBatch(
+        renderer, count, blockIndices, voxels, resident, renderer->voxBlockStagingBufferMemory, &regions);
+
+    if (regions.blockCount != 0)
+        bufferTransfer(
+            renderer->device,
+            renderer->computeAndPresentQueue,
+            renderer->transientComputeCommandPool,
+            regions.blockCount,
+            regions.blocks,
+            renderer->voxBlockStagingBuffer,
+            renderer->voxBlocksBuffer,
+            &renderer->profiler,
+            uploadProfilerSlot(renderer),
+            PASS_BLOCK_UPLOAD
+        );
+    if (voxBlockMipBytes(renderer) != 0)
+        bufferTransfer(
+            renderer->device,
+            renderer->computeAndPresentQueue,
+            renderer->transientComputeCommandPool,
+            count,
+            regions.mips,
+            renderer->voxBlockStagingBuffer,
+            renderer->voxBlockMipsBuffer,
+            &renderer->profiler,
+            uploadProfilerSlot(renderer),
+            PASS_BLOCK_UPLOAD
+        );
+    // Slots go last so the shader never follows one to a block not yet written.
     bufferTransfer(
         renderer->device,
         renderer->computeAndPresentQueue,
         renderer->transientComputeCommandPool,
-        1,
-        &copyRegion,
+        count,
+        regions.slots,
         renderer->voxBlockStagingBuffer,
-        renderer->voxBlocksBuffer
+        renderer->voxBlockSlotsBuffer,
+        &renderer->profiler,
+        uploadProfilerSlot(renderer),
+        PASS_BLOCK_UPLOAD
     );
 }
 
-void updateObject(Renderer *renderer, VoxObject object){
-    uint32_t *data;
-    vkMapMemory(renderer->device, renderer->objectInfoBufferMemory, 0, OBJECT_INFO_MEM_SIZE, 0, (void**)&data);
-    memcpy(&data[0], (void*)&object.paletteIndex, sizeof(uint32_t));
+void updateBlock(Renderer *renderer, int32_t blockIndex, const unsigned char *voxels){
+    uint32_t index = blockIndex;
+    uploadVoxBlockBatch(renderer, 1, &index, &voxels, true);
+}
+
+void updateBlocks(Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *voxels){
+    for (uint32_t batchStart = 0; batchStart < count; batchStart += VOX_BLOCK_UPLOAD_BATCH)
+        uploadVoxBlockBatch(
+            renderer, std::min(VOX_BLOCK_UPLOAD_BATCH, count - batchStart),
+            blockIndices + batchStart, voxels + batchStart, true);
+}
+
+void updateBlockLight(Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *light){
+    if (!renderer->sceneLimits.bakedLight)
+        throw std::runtime_error("light can only be uploaded to a renderer with baked light");
+    VkDeviceSize lightSize = voxBlockLightSize(renderer->sceneLimits.blockScale);
+    for (uint32_t batchStart = 0; batchStart < count; batchStart += VOX_BLOCK_UPLOAD_BATCH){
+        uint32_t batchCount = std::min(VOX_BLOCK_UPLOAD_BATCH, count - batchStart);
+        VkBufferCopy lightRegions[VOX_BLOCK_UPLOAD_BATCH];
+        uint8_t *data;
+        vkMapMemory(renderer->device, renderer->voxBlockStagingBufferMemory, 0, VK_WHOLE_SIZE, 0, (void **)&data);
+        for (uint32_t i = 0; i < batchCount; i++){
+            uint32_t blockIndex = blockIndices[batchStart + i];
+            if (blockIndex >= renderer->sceneLimits.voxBlockCount)
+                throw std::runtime_error("vox block index is beyond the renderer's scene limits");
+            memcpy(data + i * lightSize, light[batchStart + i], lightSize);
+            lightRegions[i].srcOffset = i * lightSize;
+            lightRegions[i].dstOffset = blockIndex * lightSize;
+            lightRegions[i].size = lightSize;
+        }
+        vkUnmapMemory(renderer->device, renderer->voxBlockStagingBufferMemory);
+
+        bufferTransfer(
+            renderer->device,
+            renderer->computeAndPresentQueue,
+            renderer->transientComputeCommandPool,
+            batchCount,
+            lightRegions,
+            renderer->voxBlockStagingBuffer,
+            renderer->voxBlockLightBuffer,
+            &renderer->profiler,
+            uploadProfilerSlot(renderer),
+            PASS_BLOCK_UPLOAD
+        );
+    }
+}
+
+void updateBlockMips(Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *voxels){
+    if (!renderer->sceneLimits.blockFeedback)
+        throw std::runtime_error("blocks can only be left without a slot with block feedback");
+    for (uint32_t batchStart = 0; batchStart < count; batchStart += VOX_BLOCK_UPLOAD_BATCH)
+        uploadVoxBlockBatch(
+            renderer, std::min(VOX_BLOCK_UPLOAD_BATCH, count - batchStart),
+            blockIndices + batchStart, voxels + batchStart, false);
+}
+
+void evictBlocks(Renderer *renderer, uint32_t count, const uint32_t *blockIndices){
+    if (!renderer->sceneLimits.blockFeedback)
+        throw std::runtime_error("blocks can only be evicted with block feedback");
+    if (count == 0)
+        return;
+
+    // A frame in flight may still read the slots, and they are handed out again.
+    vkQueueWaitIdle(renderer->computeAndPresentQueue);
+    for (uint32_t batchStart = 0; batchStart < count; batchStart += VOX_BLOCK_UPLOAD_BATCH){
+        uint32_t batchCount = std::min(VOX_BLOCK_UPLOAD_BATCH, count - batchStart);
+        VkBufferCopy slotRegions[VOX_BLOCK_UPLOAD_BATCH];
+        VoxBlockSlot *data;
+        vkMapMemory(renderer->device, renderer->voxBlockStagingBufferMemory, 0, VK_WHOLE_SIZE, 0, (void **)&data);
+        for (uint32_t i = 0; i < batchCount; i++){
+            uint32_t blockIndex = blockIndices[batchStart + i];
+            releaseBlock(renderer, blockIndex);
+            data[i] = VOX_BLOCK_SLOT_NONE;
+            slotRegions[i].srcOffset = i * sizeof(VoxBlockSlot);
+            slotRegions[i].dstOffset = blockIndex * sizeof(VoxBlockSlot);
+            slotRegions[i].size = sizeof(VoxBlockSlot);
+        }
+        vkUnmapMemory(renderer->device, renderer->voxBlockStagingBufferMemory);
+
+        bufferTransfer(
+            renderer->device,
+            renderer->computeAndPresentQueue,
+            renderer->transientComputeCommandPool,
+            batchCount,
+            slotRegions,
+            renderer->voxBlockStagingBuffer,
+            renderer->voxBlockSlotsBuffer,
+            &renderer->profiler,
+            uploadProfilerSlot(renderer),
+            PASS_BLOCK_UPLOAD
+        );
+    }
+}
+
+void releaseBlock(Renderer *renderer, uint32_t blockIndex){
+    if (blockIndex >= renderer->sceneLimits.voxBlockCount)
+        throw std::runtime_error("vox block index is beyond the renderer's scene limits");
+    VoxBlockSlot *slot = &renderer->voxBlockSlots[blockIndex];
+    if (*slot != VOX_BLOCK_SLOT_NONE)
+        freeVoxBlockSlot(&renderer->voxBlockHeap, *slot);
+    *slot = VOX_BLOCK_SLOT_NONE;
+}
+
+// Bytes of objectInfoBuffer, the header and the grid's block indices.
+VkDeviceSize objectInfoBufferSize(Renderer *renderer)
+{
+    return OBJECT_INFO_HEADER_SIZE + (VkDeviceSize)renderer->sceneLimits.objectBlockCount * sizeof(uint32_t);
+}
+
+// Bytes of blockBoundsBuffer, the draw and the grid index of each block drawn.
+VkDeviceSize blockBoundsBufferSize(Renderer *renderer)
+{
+    return BLOCK_BOUNDS_HEADER_SIZE +
+        (renderer->sceneLimits.blockRaster ? (VkDeviceSize)renderer->sceneLimits.objectBlockCount * sizeof(uint32_t) : 0);
+}
+
+// Writes object as objectInfoBuffer holds it, returns the bytes written.
+VkDeviceSize writeObjectInfo(VoxObject object, uint32_t paletteRow, uint32_t *data)
+{
+    uint32_t blockCount = object.blockWidth * object.blockHeight * object.blockDepth;
+    memcpy(&data[0], (void*)&paletteRow, sizeof(uint32_t));
     memcpy(&data[1], (void*)&object.blockWidth, sizeof(uint32_t));
     memcpy(&data[2], (void*)&object.blockHeight, sizeof(uint32_t));
     memcpy(&data[3], (void*)&object.blockDepth, sizeof(uint32_t));
-    memcpy(&data[4], (void*)object.blockIndices, OBJECT_INFO_MEM_SIZE - sizeof(uint32_t) * 4);
+    memcpy(&data[4], (void*)object.blockIndices, blockCount * sizeof(uint32_t));
+    return OBJECT_INFO_HEADER_SIZE + blockCount * sizeof(uint32_t);
+}
+
+// Writes the draw of object's block bounds as blockBoundsBuffer holds it, returns
+// the bytes written.
+VkDeviceSize writeBlockBounds(VoxObject object, uint32_t *data)
+{
+    uint32_t blockCount = object.blockWidth * object.blockHeight * object.blockDepth;
+    VkDrawIndirectCommand draw{};
+    draw.vertexCount = BLOCK_BOUNDS_VERTEX_COUNT;
+    draw.instanceCount = 0;
+    draw.firstVertex = 0;
+    draw.firstInstance = 0;
+    uint32_t *gridBlocks = data + BLOCK_BOUNDS_HEADER_SIZE / sizeof(uint32_t);
+    for (uint32_t i = 0; i < blockCount; i++)
+        if (object.blockIndices[i] != 0)
+            gridBlocks[draw.instanceCount++] = i;
+    memcpy(data, &draw, sizeof(draw));
+    return BLOCK_BOUNDS_HEADER_SIZE + draw.instanceCount * sizeof(uint32_t);
+}
+
+void updateObject(Renderer *renderer, VoxObject object, uint32_t paletteRow){
+    uint32_t blockCount = object.blockWidth * object.blockHeight * object.blockDepth;
+    if (blockCount > renderer->sceneLimits.objectBlockCount)
+        throw std::runtime_error("vox object is larger than the renderer's scene limits");
+
+    vkQueueWaitIdle(renderer->computeAndPresentQueue);
+    uint32_t *data;
+    vkMapMemory(renderer->device, renderer->objectInfoBufferMemory, 0, VK_WHOLE_SIZE, 0, (void**)&data);
+    writeObjectInfo(object, paletteRow, data);
     vkUnmapMemory(renderer->device, renderer->objectInfoBufferMemory);
+
+    if (!renderer->sceneLimits.blockRaster)
+        return;
+    vkMapMemory(renderer->device, renderer->blockBoundsBufferMemory, 0, VK_WHOLE_SIZE, 0, (void**)&data);
+    writeBlockBounds(object, data);
+    vkUnmapMemory(renderer->device, renderer->blockBoundsBufferMemory);
 }
 
-Renderer createRenderer(GLFWwindow *window, bool enableValidationLayers)
+void streamObjectUpdate(
+    Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *voxels,
+    VoxObject object, uint32_t paletteRow)
 {
-    Renderer renderer{};
-    renderer.currentFrame = 0;
+    if (!renderer->sceneLimits.streamed)
+        throw std::runtime_error("objects can only be streamed to a renderer with streamed scene limits");
+    if (count > VOX_BLOCK_UPLOAD_BATCH)
+        throw std::runtime_error("a streamed update holds at most VOX_BLOCK_UPLOAD_BATCH blocks");
+    uint32_t blockCount = object.blockWidth * object.blockHeight * object.blockDepth;
+    if (blockCount > renderer->sceneLimits.objectBlockCount)
+        throw std::runtime_error("vox object is larger than the renderer's scene limits");
+
+    // This staging was last copied from MAX_FRAMES_IN_FLIGHT updates ago, that
+    // copy is normally long done.
+    uint32_t slot = renderer->streamedUpdates % MAX_FRAMES_IN_FLIGHT;
+    vkWaitForFences(renderer->device, 1, &renderer->streamFences[slot], VK_TRUE, UINT64_MAX);
+
+    VkBuffer stagingBuffer = renderer->streamStagingBuffers[slot];
+    VkDeviceMemory stagingMemory = renderer->streamStagingBuffersMemory[slot];
+    VoxBlockBatchRegions blockRegions;
+    stageVoxBlockBatch(renderer, count, blockIndices, voxels, true, stagingMemory, &blockRegions);
+
+    VkBufferCopy objectInfoRegion{};
+    objectInfoRegion.srcOffset = voxBlockBatchStagingSize(renderer);
+    objectInfoRegion.dstOffset = 0;
+    VkBufferCopy blockBoundsRegion{};
+    blockBoundsRegion.srcOffset = objectInfoRegion.srcOffset + objectInfoBufferSize(renderer);
+    blockBoundsRegion.dstOffset = 0;
+    uint8_t *data;
+    vkMapMemory(renderer->device, stagingMemory, 0, VK_WHOLE_SIZE, 0, (void **)&data);
+    objectInfoRegion.size = writeObjectInfo(object, paletteRow, (uint32_t *)(data + objectInfoRegion.srcOffset));
+    if (renderer->sceneLimits.blockRaster)
+        blockBoundsRegion.size = writeBlockBounds(object, (uint32_t *)(data + blockBoundsRegion.srcOffset));
+    vkUnmapMemory(renderer->device, stagingMemory);
+
+    VkCommandBuffer *commandBuffer = &renderer->streamCommandBuffers[slot];
+    if (*commandBuffer != VK_NULL_HANDLE)
+        vkFreeCommandBuffers(renderer->device, renderer->transientComputeCommandPool, 1, commandBuffer);
+    allocateCommandBuffers(renderer->device, renderer->transientComputeCommandPool, 1, commandBuffer);
+    beginRecordingCommandBuffer(*commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    if (blockRegions.blockCount != 0)
+        vkCmdCopyBuffer(
+            *commandBuffer, stagingBuffer, renderer->voxBlocksBuffer, blockRegions.blockCount, blockRegions.blocks);
+    if (count != 0 && voxBlockMipBytes(renderer) != 0)
+        vkCmdCopyBuffer(*commandBuffer, stagingBuffer, renderer->voxBlockMipsBuffer, count, blockRegions.mips);
+    if (count != 0)
+        vkCmdCopyBuffer(*commandBuffer, stagingBuffer, renderer->voxBlockSlotsBuffer, count, blockRegions.slots);
+
+    // Frames in flight still read the grid being replaced. The blocks need no
+    // wait, no frame in flight uses their pool indices or slots.
+    vkCmdPipelineBarrier(
+        *commandBuffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        0, nullptr);
+    vkCmdCopyBuffer(*commandBuffer, stagingBuffer, renderer->objectInfoBuffer, 1, &objectInfoRegion);
+    if (renderer->sceneLimits.blockRaster)
+        vkCmdCopyBuffer(*commandBuffer, stagingBuffer, renderer->blockBoundsBuffer, 1, &blockBoundsRegion);
+
+    // Frames submitted after the update see all of it.
+    VkMemoryBarrier updateBarrier{};
+    updateBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    updateBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    updateBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(
+        *commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        1, &updateBarrier,
+        0, nullptr,
+        0, nullptr);
 
-    // DEVICE
+    handleVkResult(
+        vkEndCommandBuffer(*commandBuffer),
+        "recording streamed update");
 
-    renderer.instance = createInstance(enableValidationLayers);
-    renderer.surface = createSurface(renderer.instance, window);
-    renderer.physicalDevice = pickPhysicalDevice(renderer.instance, renderer.surface);
-    renderer.computeAndPresentQueueFamily = 
-        pickComputeAndPresentFamily(renderer.physicalDevice, renderer.surface).index;
-    renderer.device = createLogicalDevice(
-        renderer.physicalDevice,
-        enableValidationLayers,
-        1,
-        &renderer.computeAndPresentQueueFamily
+    // Reset only now, a throw above would leave the fence to never signal.
+    vkResetFences(renderer->device, 1, &renderer->streamFences[slot]);
+    submitCommandBuffers(
+        renderer->computeAndPresentQueue,
+        1, commandBuffer,
+        0, nullptr, nullptr,
+        0, nullptr,
+        renderer->streamFences[slot]);
+    renderer->streamedUpdates++;
+}
+
+bool framesFinishedBefore(Renderer *renderer, uint64_t frame)
+{
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        if (renderer->slotFrames[i] < frame &&
+            vkGetFenceStatus(renderer->device, renderer->inFlightFences[i]) != VK_SUCCESS)
+            return false;
+    return true;
+}
+
+uint32_t targetImageCount(Renderer *renderer)
+{
+    return renderer->headless ? renderer->offscreen.imageCount() : renderer->swapchain.imageCount();
+}
+
+VkExtent2D targetImageExtent(Renderer *renderer)
+{
+    return renderer->headless ? renderer->offscreen.extent : renderer->swapchain.extent;
+}
+
+// Words of a block feedback buffer, at least one so the buffer can be created.
+uint32_t blockFeedbackWords(Renderer *renderer)
+{
+    return std::max<uint32_t>(1, (renderer->sceneLimits.voxBlockCount + 31) / 32);
+}
+
+// Signaled once the last frame rendered into target image i has finished.
+VkFence targetImageFence(Renderer *renderer, uint32_t i)
+{
+    return renderer->headless ? renderer->inFlightFences[i] : renderer->imagesInFlight[i];
+}
+
+bool readBlockFeedback(Renderer *renderer, std::vector<uint32_t> *bits)
+{
+    uint32_t words = blockFeedbackWords(renderer);
+    bits->assign(words, 0);
+    bool read = false;
+    for (uint32_t i = 0; i < renderer->blockFeedbackBuffers.size(); i++){
+        VkFence fence = targetImageFence(renderer, i);
+        if (fence != VK_NULL_HANDLE && vkGetFenceStatus(renderer->device, fence) != VK_SUCCESS)
+            continue;
+        uint32_t *data;
+        vkMapMemory(renderer->device, renderer->blockFeedbackBuffersMemory[i], 0, VK_WHOLE_SIZE, 0, (void **)&data);
+        for (uint32_t word = 0; word < words; word++)
+            (*bits)[word] |= data[word];
+        memset(data, 0, words * sizeof(uint32_t));
+        vkUnmapMemory(renderer->device, renderer->blockFeedbackBuffersMemory[i]);
+        read = true;
+    }
+    return read;
+}
+
+SceneLimits voxObjectLimits(VoxObject object, const unsigned char *voxBlocks)
+{
+    SceneLimits limits{};
+    limits.blockScale = object.blockScale;
+    limits.paletteCount = DEFAULT_PALETTE_ROWS;
+    limits.mipCount = voxBlockMipCount(object.blockScale);
+    limits.objectBlockCount = object.blockWidth * object.blockHeight * object.blockDepth;
+    for (uint32_t i = 0; i < limits.objectBlockCount; i++)
+        limits.voxBlockCount = std::max(limits.voxBlockCount, object.blockIndices[i]);
+
+    // Every block as it is encoded now, plus a quarter again and one raw block so
+    // edits that need more bits still find slots.
+    size_t blockSize = (size_t)object.blockScale * object.blockScale * object.blockScale;
+    uint64_t words = 0;
+    for (uint32_t i = 0; i < limits.voxBlockCount; i++)
+        words += encodedVoxBlockWords(
+            object.blockScale, chooseVoxBlockEncoding(voxBlocks + i * blockSize, object.blockScale));
+    words += words / 4 + encodedVoxBlockWords(object.blockScale, VOX_BLOCK_ENCODING_RAW);
+    limits.voxBlockWords = std::min<uint64_t>(words, UINT32_MAX / 4);
+    return limits;
+}
+
+void uploadVoxObject(Renderer *renderer, VoxObject object, const unsigned char *voxBlocks, MemPool<Palette> *palettes)
+{
+    if (object.blockScale != renderer->sceneLimits.blockScale)
+        throw std::runtime_error("vox object block scale does not match the renderer's");
+
+    std::vector<uint32_t> poolIndices;
+    for(int i = 0; i < object.blockWidth * object.blockHeight * object.blockDepth; i++){
+        int32_t blockIndex = object.blockIndices[i];
+        if(blockIndex != 0)
+            poolIndices.push_back(blockIndex - 1);
+    }
+    for (uint32_t poolIndex : poolIndices)
+        if (poolIndex >= renderer->sceneLimits.voxBlockCount)
+            throw std::runtime_error("vox object uses more blocks than the renderer's scene limits");
+
+    // Large scenes have hundreds of thousands of blocks, a transfer per block
+    // would spend most of the upload waiting on fences.
+    std::vector<const unsigned char *> blockVoxels(poolIndices.size());
+    for (size_t i = 0; i < poolIndices.size(); i++)
+        blockVoxels[i] = voxBlocks + poolIndices[i] * voxBlockSize(renderer);
+    if (renderer->sceneLimits.blockFeedback)
+        updateBlockMips(renderer, poolIndices.size(), poolIndices.data(), blockVoxels.data());
+    else
+        updateBlocks(renderer, poolIndices.size(), poolIndices.data(), blockVoxels.data());
+
+    // The palette goes first so the object never points at a row that is not resident.
+    uint32_t paletteRow = updatePalette(renderer, palettes->getBlock(object.paletteIndex));
+    updateObject(renderer, object, paletteRow);
+}
+
+void uploadVoxObjectLight(Renderer *renderer, VoxObject object, const unsigned char *light)
+{
+    std::vector<uint32_t> poolIndices;
+    std::vector<const unsigned char *> blockLight;
+    for (uint32_t i = 0; i < object.blockWidth * object.blockHeight * object.blockDepth; i++){
+        if (object.blockIndices[i] == 0)
+            continue;
+        poolIndices.push_back(object.blockIndices[i] - 1);
+        blockLight.push_back(light + poolIndices.back() * voxBlockLightSize(object.blockScale));
+    }
+    updateBlockLight(renderer, poolIndices.size(), poolIndices.data(), blockLight.data());
+}
+
+void createCamInfoBuffers(Renderer *renderer)
+{
+    renderer->camInfoBuffers.resize(targetImageCount(renderer));
+    renderer->camInfoBuffersMemory.resize(targetImageCount(renderer));
+    for (int i = 0 ; i < targetImageCount(renderer); i++)
+        createBuffer(
+            renderer->device,
+            renderer->physicalDevice,
+            sizeof(CamInfoBuffer),
+            0,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &renderer->camInfoBuffers[i],
+            &renderer->camInfoBuffersMemory[i]
+        );
+}
+
+void createBlockFeedbackBuffers(Renderer *renderer)
+{
+    renderer->blockFeedbackBuffers.resize(targetImageCount(renderer));
+    renderer->blockFeedbackBuffersMemory.resize(targetImageCount(renderer));
+    for (uint32_t i = 0; i < targetImageCount(renderer); i++){
+        createBuffer(
+            renderer->device,
+            renderer->physicalDevice,
+            blockFeedbackWords(renderer) * sizeof(uint32_t),
+            0,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &renderer->blockFeedbackBuffers[i],
+            &renderer->blockFeedbackBuffersMemory[i]
+        );
+        void *data;
+        vkMapMemory(renderer->device, renderer->blockFeedbackBuffersMemory[i], 0, VK_WHOLE_SIZE, 0, &data);
+        memset(data, 0, blockFeedbackWords(renderer) * sizeof(uint32_t));
+        vkUnmapMemory(renderer->device, renderer->blockFeedbackBuffersMemory[i]);
+    }
+}
+
+void cleanupBlockFeedbackBuffers(Renderer *renderer)
+{
+    for (uint32_t i = 0; i < renderer->blockFeedbackBuffers.size(); i++){
+        vkDestroyBuffer(renderer->device, renderer->blockFeedbackBuffers[i], nullptr);
+        vkFreeMemory(renderer->device, renderer->blockFeedbackBuffersMemory[i], nullptr);
+    }
+    renderer->blockFeedbackBuffers.clear();
+    renderer->blockFeedbackBuffersMemory.clear();
+}
+
+void createVisibilityBuffers(Renderer *renderer)
+{
+    // Two words per pixel, see Visibility in shader.comp.
+    VkExtent2D extent = targetImageExtent(renderer);
+    VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 2 * sizeof(uint32_t);
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(renderer->physicalDevice, &deviceProperties);
+    if (size > deviceProperties.limits.maxStorageBufferRange)
+        throw std::runtime_error(
+            "a " + std::to_string(extent.width) + "x" + std::to_string(extent.height) +
+            " target needs a " + std::to_string(size) + " byte visibility buffer but storage buffers are limited to " +
+            std::to_string(deviceProperties.limits.maxStorageBufferRange) + " bytes on this device");
+
+    renderer->visibilityBuffers.resize(targetImageCount(renderer));
+    renderer->visibilityBuffersMemory.resize(targetImageCount(renderer));
+    for (uint32_t i = 0; i < targetImageCount(renderer); i++)
+        createBuffer(
+            renderer->device,
+            renderer->physicalDevice,
+            size,
+            0,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &renderer->visibilityBuffers[i],
+            &renderer->visibilityBuffersMemory[i]
+        );
+}
+
+void createBlockDepth(Renderer *renderer)
+{
+    renderer->blockDepth = createDepthTarget(
+        renderer->device,
+        renderer->physicalDevice,
+        renderer->computeAndPresentQueue,
+        renderer->transientComputeCommandPool,
+        renderer->blockBoundsRenderPass,
+        BLOCK_DEPTH_FORMAT,
+        renderer->sceneLimits.blockRaster ? targetImageExtent(renderer) : VkExtent2D{1, 1},
+        targetImageCount(renderer));
+}
+
+void cleanupVisibilityBuffers(Renderer *renderer)
+{
+    for (uint32_t i = 0; i < renderer->visibilityBuffers.size(); i++){
+        vkDestroyBuffer(renderer->device, renderer->visibilityBuffers[i], nullptr);
+        vkFreeMemory(renderer->device, renderer->visibilityBuffersMemory[i], nullptr);
+    }
+    renderer->visibilityBuffers.clear();
+    renderer->visibilityBuffersMemory.clear();
+}
+
+void cleanupCamInfoBuffers(Renderer *renderer)
+{
+    for (int i = 0; i < renderer->camInfoBuffers.size(); i++)
+    {
+        vkDestroyBuffer(renderer->device, renderer->camInfoBuffers[i], nullptr);
+        vkFreeMemory(renderer->device, renderer->camInfoBuffersMemory[i], nullptr);
+    }
+    renderer->camInfoBuffers.clear();
+    renderer->camInfoBuffersMemory.clear();
+}
+
+void createTargetCommandBuffers(Renderer *renderer)
+{
+    renderer->renderCommandBuffers.resize(targetImageCount(renderer));
+    createRenderCommandBuffers(
+        renderer->device,
+        renderer->computeCommandPool,
+        targetImageCount(renderer),
+        renderer->pipeline.layout,
+        renderer->pipeline.pipeline,
+        renderer->shadingPipeline.pipeline,
+        renderer->sceneLimits.blockRaster ? &renderer->blockBoundsPipeline : nullptr,
+        renderer->blockBoundsRenderPass,
+        renderer->blockDepth.framebuffers.data(),
+        renderer->blockBoundsBuffer,
+        renderer->descriptorSets.sets.data(),
+        targetImageExtent(renderer),
+        renderer->pixelOrder,
+        renderer->headless ? renderer->offscreen.images.data() : renderer->swapchain.images.data(),
+        renderer->headless ? renderer->offscreen.readbackBuffers.data() : nullptr,
+        renderer->sceneLimits.blockFeedback ? renderer->blockFeedbackBuffers.data() : nullptr,
+        renderer->visibilityBuffers.data(),
+        renderer->computeAndPresentQueueFamily,
+        renderer->computeAndPresentQueueFamily,
+        &renderer->profiler,
+        renderer->renderCommandBuffers.data()
     );
+}
 
-    vkGetDeviceQueue(renderer.device, renderer.computeAndPresentQueueFamily, 0, &renderer.computeAndPresentQueue);
+void recordCpuFrameCopy(
+    VkCommandBuffer commandBuffer,
+    VkBuffer frameBuffer,
+    VkImage image,
+    VkExtent2D extent)
+{
+    VkImageSubresourceRange imageRange = createImageSubresourceRange(
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        0, 1,
+        0, 1
+    );
 
-    // SWAPCHAIN
+    VkImageMemoryBarrier preCopyBarrier{};
+    preCopyBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    preCopyBarrier.srcAccessMask = 0;
+    preCopyBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    preCopyBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    preCopyBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    preCopyBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    preCopyBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    preCopyBarrier.image = image;
+    preCopyBarrier.subresourceRange = imageRange;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &preCopyBarrier);
+
+    VkBufferImageCopy copyRegion{};
+    copyRegion.bufferOffset = 0;
+    copyRegion.bufferRowLength = 0;
+    copyRegion.bufferImageHeight = 0;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageOffset = VkOffset3D{0, 0, 0};
+    copyRegion.imageExtent = VkExtent3D{extent.width, extent.height, 1};
+
+    vkCmdCopyBufferToImage(commandBuffer, frameBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    VkImageMemoryBarrier presentBarrier{};
+    presentBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    presentBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    presentBarrier.dstAccessMask = 0;
+    presentBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    presentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    presentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    presentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    presentBarrier.image = image;
+    presentBarrier.subresourceRange = imageRange;
+
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &presentBarrier);
+}
 
-    renderer.swapchain = createSwapchain(
-        renderer.device,
-        renderer.physicalDevice,
-        window,
-        renderer.surface);
+void createCpuPresentResources(Renderer *renderer)
+{
+    uint32_t imageCount = renderer->swapchain.imageCount();
+    VkExtent2D extent = renderer->swapchain.extent;
+
+    renderer->cpuFrameBuffers.resize(imageCount);
+    renderer->cpuFrameBuffersMemory.resize(imageCount);
+    renderer->cpuPresentCommandBuffers.resize(imageCount);
+    allocateCommandBuffers(
+        renderer->device,
+        renderer->computeCommandPool,
+        imageCount,
+        renderer->cpuPresentCommandBuffers.data());
+
+    for (uint32_t i = 0; i < imageCount; i++){
+        createBuffer(
+            renderer->device,
+            renderer->physicalDevice,
+            (VkDeviceSize)extent.width * extent.height * 4,
+            0,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &renderer->cpuFrameBuffers[i],
+            &renderer->cpuFrameBuffersMemory[i]
+        );
 
+        beginRecordingCommandBuffer(renderer->cpuPresentCommandBuffers[i], VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+        recordCpuFrameCopy(
+            renderer->cpuPresentCommandBuffers[i],
+            renderer->cpuFrameBuffers[i],
+            renderer->swapchain.images[i],
+            extent);
+        handleVkResult(
+            vkEndCommandBuffer(renderer->cpuPresentCommandBuffers[i]),
+            "recording cpu frame copy");
+    }
+}
+
+void cleanupCpuPresentResources(Renderer *renderer)
+{
+    if (renderer->cpuFrameBuffers.empty())
+        return;
+
+    vkFreeCommandBuffers(
+        renderer->device,
+        renderer->computeCommandPool,
+        renderer->cpuPresentCommandBuffers.size(),
+        renderer->cpuPresentCommandBuffers.data());
+    for (int i = 0; i < renderer->cpuFrameBuffers.size(); i++){
+        vkDestroyBuffer(renderer->device, renderer->cpuFrameBuffers[i], nullptr);
+        vkFreeMemory(renderer->device, renderer->cpuFrameBuffersMemory[i], nullptr);
+    }
+    renderer->cpuFrameBuffers.clear();
+    renderer->cpuFrameBuffersMemory.clear();
+    renderer->cpuPresentCommandBuffers.clear();
+}
+
+DescriptorCreateInfo targetImageDescriptorInfo(Renderer *renderer)
+{
+    DescriptorCreateInfo targetImageDescriptor{};
+    targetImageDescriptor.binding = 0;
+    targetImageDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    targetImageDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    targetImageDescriptor.imageViews =
+        renderer->headless ? renderer->offscreen.imageViews : renderer->swapchain.imageViews;
+    targetImageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    return targetImageDescriptor;
+}
+
+DescriptorCreateInfo visibilityDescriptorInfo(Renderer *renderer)
+{
+    DescriptorCreateInfo visibilityDescriptor{};
+    visibilityDescriptor.binding = 9;
+    visibilityDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    visibilityDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    visibilityDescriptor.buffers = renderer->visibilityBuffers;
+    return visibilityDescriptor;
+}
+
+DescriptorCreateInfo blockDepthDescriptorInfo(Renderer *renderer)
+{
+    DescriptorCreateInfo blockDepthDescriptor{};
+    blockDepthDescriptor.binding = 10;
+    blockDepthDescriptor.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    blockDepthDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    blockDepthDescriptor.imageViews = renderer->blockDepth.imageViews;
+    blockDepthDescriptor.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    return blockDepthDescriptor;
+}
+
+std::vector<DescriptorCreateInfo> renderDescriptorInfos(Renderer *renderer)
+{
+    DescriptorCreateInfo camInfoDescroptor{};
+    camInfoDescroptor.binding = 1;
+    camInfoDescroptor.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    camInfoDescroptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    camInfoDescroptor.buffers = renderer->camInfoBuffers;
+
+    DescriptorCreateInfo voxBlocksDescriptor{};
+    voxBlocksDescriptor.binding = 2;
+    voxBlocksDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    voxBlocksDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    voxBlocksDescriptor.buffers = std::vector<VkBuffer>(targetImageCount(renderer), renderer->voxBlocksBuffer);
+
+    DescriptorCreateInfo voxBlockMipsDescriptor{};
+    voxBlockMipsDescriptor.binding = 5;
+    voxBlockMipsDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    voxBlockMipsDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    voxBlockMipsDescriptor.buffers = std::vector<VkBuffer>(targetImageCount(renderer), renderer->voxBlockMipsBuffer);
+
+    DescriptorCreateInfo voxBlockSlotsDescriptor{};
+    voxBlockSlotsDescriptor.binding = 6;
+    voxBlockSlotsDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    voxBlockSlotsDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    voxBlockSlotsDescriptor.buffers = std::vector<VkBuffer>(targetImageCount(renderer), renderer->voxBlockSlotsBuffer);
+
+    DescriptorCreateInfo voxBlockLightDescriptor{};
+    voxBlockLightDescriptor.binding = 8;
+    voxBlockLightDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    voxBlockLightDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    voxBlockLightDescriptor.buffers = std::vector<VkBuffer>(targetImageCount(renderer), renderer->voxBlockLightBuffer);
+
+    DescriptorCreateInfo blockFeedbackDescriptor{};
+    blockFeedbackDescriptor.binding = 7;
+    blockFeedbackDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    blockFeedbackDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    blockFeedbackDescriptor.buffers = renderer->blockFeedbackBuffers;
+
+    DescriptorCreateInfo paletteDescriptor{};
+    paletteDescriptor.binding = 3;
+    paletteDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    paletteDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    paletteDescriptor.imageViews = std::vector<VkImageView>(targetImageCount(renderer), renderer->paletteImageView);
+    paletteDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    DescriptorCreateInfo objectInfoDescriptor{};
+    objectInfoDescriptor.binding = 4;
+    objectInfoDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    objectInfoDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    objectInfoDescriptor.buffers = std::vector<VkBuffer>(targetImageCount(renderer), renderer->objectInfoBuffer);
+
+    DescriptorCreateInfo blockBoundsDescriptor{};
+    blockBoundsDescriptor.binding = 11;
+    blockBoundsDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    blockBoundsDescriptor.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    blockBoundsDescriptor.buffers = std::vector<VkBuffer>(targetImageCount(renderer), renderer->blockBoundsBuffer);
+
+    return std::vector<DescriptorCreateInfo>{
+        targetImageDescriptorInfo(renderer),
+        camInfoDescroptor,
+        voxBlocksDescriptor,
+        paletteDescriptor,
+        objectInfoDescriptor,
+        voxBlockMipsDescriptor,
+        voxBlockSlotsDescriptor,
+        blockFeedbackDescriptor,
+        voxBlockLightDescriptor,
+        visibilityDescriptorInfo(renderer),
+        blockDepthDescriptorInfo(renderer),
+        blockBoundsDescriptor};
+}
+
+void markStartupPhase(PhaseTimer *startupTimer, std::string name)
+{
+    if (startupTimer != nullptr)
+        markPhase(startupTimer, name);
+}
+
+void createRendererResources(Renderer *renderer, PhaseTimer *startupTimer)
+{
     // COMMAND POOLS
 
-    renderer.computeCommandPool = createCommandPool(
-        renderer.device,
+    renderer->computeCommandPool = createCommandPool(
+        renderer->device,
         0,
-        renderer.computeAndPresentQueueFamily);
+        renderer->computeAndPresentQueueFamily);
 
-    renderer.transientComputeCommandPool = createCommandPool(
-        renderer.device,
+    renderer->transientComputeCommandPool = createCommandPool(
+        renderer->device,
         VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-        renderer.computeAndPresentQueueFamily);
+        renderer->computeAndPresentQueueFamily);
+
+    // SCENE LIMITS
+
+    VkDeviceSize voxBlocksSize = std::max<VkDeviceSize>(
+        1, (VkDeviceSize)renderer->sceneLimits.voxBlockWords * sizeof(uint32_t));
+    VkDeviceSize voxBlockSlotsSize = std::max<VkDeviceSize>(
+        1, renderer->sceneLimits.voxBlockCount * sizeof(VoxBlockSlot));
+    VkDeviceSize voxBlockMipsSize = std::max<VkDeviceSize>(
+        1, renderer->sceneLimits.voxBlockCount * voxBlockMipBytes(renderer));
+    VkDeviceSize voxBlockLightBytes = std::max<VkDeviceSize>(
+        4, renderer->sceneLimits.bakedLight ?
+            renderer->sceneLimits.voxBlockCount * voxBlockLightSize(renderer->sceneLimits.blockScale) : 0);
+    VkDeviceSize objectInfoSize = objectInfoBufferSize(renderer);
+    VkDeviceSize blockBoundsSize = blockBoundsBufferSize(renderer);
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(renderer->physicalDevice, &deviceProperties);
+    if (renderer->sceneLimits.paletteCount > deviceProperties.limits.maxImageDimension2D)
+        throw std::runtime_error(
+            "scene needs " + std::to_string(renderer->sceneLimits.paletteCount) +
+            " palettes but images are limited to " +
+            std::to_string(deviceProperties.limits.maxImageDimension2D) + " rows on this device");
+    if (voxBlocksSize > deviceProperties.limits.maxStorageBufferRange ||
+        objectInfoSize > deviceProperties.limits.maxStorageBufferRange)
+        throw std::runtime_error(
+            "scene needs a " + std::to_string(std::max(voxBlocksSize, objectInfoSize)) +
+            " byte storage buffer but they are limited to " +
+            std::to_string(deviceProperties.limits.maxStorageBufferRange) + " bytes on this device");
 
     // STAGING BUFFERS
 
     createBuffer(
-        renderer.device,
-        renderer.physicalDevice,
-        sizeof(VoxBlock),
+        renderer->device,
+        renderer->physicalDevice,
+        voxBlockBatchStagingSize(renderer),
         0,
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &renderer.voxBlockStagingBuffer,
-        &renderer.voxBlockStagingBufferMemory
+        &renderer->voxBlockStagingBuffer,
+        &renderer->voxBlockStagingBufferMemory
     );
 
     createBuffer(
-        renderer.device,
-        renderer.physicalDevice,
-        sizeof(Palette),
+        renderer->device,
+        renderer->physicalDevice,
+        (VkDeviceSize)renderer->sceneLimits.paletteCount * sizeof(Palette),
         0,
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &renderer.paletteStagingBuffer,
-        &renderer.paletteStagingBufferMemory
+        &renderer->paletteStagingBuffer,
+        &renderer->paletteStagingBufferMemory
     );
 
-    // CAM INFO BUFFERS
+    // A batch of blocks followed by the grid, see streamObjectUpdate.
+    if (renderer->sceneLimits.streamed)
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+            createBuffer(
+                renderer->device,
+                renderer->physicalDevice,
+                voxBlockBatchStagingSize(renderer) + objectInfoSize + blockBoundsSize,
+                0,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &renderer->streamStagingBuffers[i],
+                &renderer->streamStagingBuffersMemory[i]
+            );
 
-    renderer.camInfoBuffers.resize(renderer.swapchain.imageCount());
-    renderer.camInfoBuffersMemory.resize(renderer.swapchain.imageCount());
-    for (int i = 0 ; i < renderer.swapchain.imageCount(); i++)
-        createBuffer(
-            renderer.device,
-            renderer.physicalDevice,
-            sizeof(CamInfoBuffer),
-            0,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            &renderer.camInfoBuffers[i],
-            &renderer.camInfoBuffersMemory[i]
-        );
+    // CAM INFO, FEEDBACK AND VISIBILITY BUFFERS
+
+    createCamInfoBuffers(renderer);
+    createBlockFeedbackBuffers(renderer);
+    createVisibilityBuffers(renderer);
+
+    // BLOCK BOUNDS
+
+    createBuffer(
+        renderer->device,
+        renderer->physicalDevice,
+        blockBoundsSize,
+        0,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &renderer->blockBoundsBuffer,
+        &renderer->blockBoundsBufferMemory
+    );
+    if (renderer->sceneLimits.blockRaster)
+        checkDepthTargetFormat(renderer->physicalDevice, BLOCK_DEPTH_FORMAT);
+    renderer->blockBoundsRenderPass = createDepthRenderPass(renderer->device, BLOCK_DEPTH_FORMAT);
+    createBlockDepth(renderer);
 
     // OBJECT BUFFER
 
     createBuffer(
-        renderer.device,
-        renderer.physicalDevice,
-        OBJECT_INFO_MEM_SIZE,
+        renderer->device,
+        renderer->physicalDevice,
+        objectInfoSize,
         0,
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &renderer.objectInfoBuffer,
-        &renderer.objectInfoBufferMemory
+        &renderer->objectInfoBuffer,
+        &renderer->objectInfoBufferMemory
     );
     
     // VOX BLOCKS BUFFER
 
     createBuffer(
-        renderer.device,
-        renderer.physicalDevice,
-        MAX_VOX_BLOCK_COUNT * sizeof(VoxBlock),
+        renderer->device,
+        renderer->physicalDevice,
+        voxBlocksSize,
         0,
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        &renderer.voxBlocksBuffer,
-        &renderer.voxBlocksBufferMemory
+        &renderer->voxBlocksBuffer,
+        &renderer->voxBlocksBufferMemory
+    );
+    renderer->voxBlockHeap = createVoxBlockHeap(renderer->sceneLimits.blockScale, renderer->sceneLimits.voxBlockWords);
+
+    createBuffer(
+        renderer->device,
+        renderer->physicalDevice,
+        voxBlockSlotsSize,
+        0,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &renderer->voxBlockSlotsBuffer,
+        &renderer->voxBlockSlotsBufferMemory
+    );
+    renderer->voxBlockSlots = std::vector<VoxBlockSlot>(renderer->sceneLimits.voxBlockCount, VOX_BLOCK_SLOT_NONE);
+
+    createBuffer(
+        renderer->device,
+        renderer->physicalDevice,
+        voxBlockMipsSize,
+        0,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &renderer->voxBlockMipsBuffer,
+        &renderer->voxBlockMipsBufferMemory
+    );
+
+    createBuffer(
+        renderer->device,
+        renderer->physicalDevice,
+        voxBlockLightBytes,
+        0,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &renderer->voxBlockLightBuffer,
+        &renderer->voxBlockLightBufferMemory
     );
 
     // PALETTE IMAGE
 
+    renderer->paletteCache = createPaletteCache(renderer->sceneLimits.paletteCount);
+
     createImage(
-        renderer.device,
-        renderer.physicalDevice,
-        VK_IMAGE_TYPE_1D,
+        renderer->device,
+        renderer->physicalDevice,
+        VK_IMAGE_TYPE_2D,
         VK_FORMAT_R8G8B8A8_UNORM,
-        VkExtent3D{256, 1, 1},
+        VkExtent3D{256, renderer->sceneLimits.paletteCount, 1},
         0,
         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
         1,
@@ -302,15 +1491,15 @@ Renderer createRenderer(GLFWwindow *window, bool enableValidationLayers)
         VK_IMAGE_TILING_OPTIMAL,
         false,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        &renderer.paletteImage,
-        &renderer.paletteImageMemory
+        &renderer->paletteImage,
+        &renderer->paletteImageMemory
     );
 
-    renderer.paletteImageView = createImageView(
-        renderer.device,
-        renderer.paletteImage,
+    renderer->paletteImageView = createImageView(
+        renderer->device,
+        renderer->paletteImage,
         VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_VIEW_TYPE_1D,
+        VK_IMAGE_VIEW_TYPE_2D,
         createImageSubresourceRange(
             VK_IMAGE_ASPECT_COLOR_BIT,
             0, 1,
@@ -318,123 +1507,359 @@ Renderer createRenderer(GLFWwindow *window, bool enableValidationLayers)
         )
     );
 
-    // DESCRIPTOR SETS
-
-    DescriptorCreateInfo swapchainImageDescriptor{};
-    swapchainImageDescriptor.binding = 0;
-    swapchainImageDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    swapchainImageDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    swapchainImageDescriptor.imageViews = renderer.swapchain.imageViews;
-    swapchainImageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-    DescriptorCreateInfo camInfoDescroptor{};
-    camInfoDescroptor.binding = 1;
-    camInfoDescroptor.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    camInfoDescroptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    camInfoDescroptor.buffers = renderer.camInfoBuffers;
-
-    DescriptorCreateInfo voxBlocksDescriptor{};
-    voxBlocksDescriptor.binding = 2;
-    voxBlocksDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    voxBlocksDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    voxBlocksDescriptor.buffers = std::vector<VkBuffer>(renderer.swapchain.imageCount(), renderer.voxBlocksBuffer);
-
-    DescriptorCreateInfo paletteDescriptor{};
-    paletteDescriptor.binding = 3;
-    paletteDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    paletteDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    paletteDescriptor.imageViews = std::vector<VkImageView>(renderer.swapchain.imageCount(), renderer.paletteImageView);
-    paletteDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    markStartupPhase(startupTimer, "buffers and images");
 
-    DescriptorCreateInfo objectInfoDescriptor{};
-    objectInfoDescriptor.binding = 4;
-    objectInfoDescriptor.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    objectInfoDescriptor.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    objectInfoDescriptor.buffers = std::vector<VkBuffer>(renderer.swapchain.imageCount(), renderer.objectInfoBuffer);
+    // DESCRIPTOR SETS
 
-    std::vector<DescriptorCreateInfo>
-        descriptorInfos{swapchainImageDescriptor, camInfoDescroptor, voxBlocksDescriptor, paletteDescriptor, objectInfoDescriptor};
+    renderer->descriptorSets = createDescriptorSets(
+        renderer->device,
+        renderDescriptorInfos(renderer),
+        targetImageCount(renderer));
 
-    renderer.descriptorSets = createDescriptorSets(renderer.device, descriptorInfos, renderer.swapchain.imageCount());
+    markStartupPhase(startupTimer, "descriptor sets");
 
     // PIPELINE
 
-    VkShaderModule renderShader = createShaderModule(renderer.device, "shader.spv");
+    renderer->pipelineCache = loadPipelineCache(renderer->device, renderer->physicalDevice, PIPELINE_CACHE_FILE);
+    markStartupPhase(startupTimer, "pipeline cache load");
+
+    VkShaderModule renderShader = createShaderModule(renderer->device, "shader.spv");
+
+    // shader.comp's constants in constant_id order: block scale, mip count, mip
+    // words per block, pixel order, block layout, block feedback, baked light, the
+    // pass, which is set for each pipeline below, and block raster.
+    uint32_t specializationData[] = {
+        renderer->sceneLimits.blockScale,
+        renderer->sceneLimits.mipCount,
+        (uint32_t)voxBlockMipBytes(renderer) / 4,
+        (uint32_t)renderer->pixelOrder,
+        VOX_BLOCK_MORTON ? 1u : 0u,
+        renderer->sceneLimits.blockFeedback ? 1u : 0u,
+        renderer->sceneLimits.bakedLight ? 1u : 0u,
+        0,
+        renderer->sceneLimits.blockRaster ? 1u : 0u};
+    const uint32_t specializationCount = sizeof(specializationData) / sizeof(uint32_t);
+    VkSpecializationMapEntry specializationEntries[specializationCount];
+    for (uint32_t i = 0; i < specializationCount; i++){
+        specializationEntries[i].constantID = i;
+        specializationEntries[i].offset = i * sizeof(uint32_t);
+        specializationEntries[i].size = sizeof(uint32_t);
+    }
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = specializationCount;
+    specializationInfo.pMapEntries = specializationEntries;
+    specializationInfo.dataSize = sizeof(specializationData);
+    specializationInfo.pData = specializationData;
 
     PipelineCreateInfo pipelineCreateInfo{};
     pipelineCreateInfo.computeShader = renderShader;
     pipelineCreateInfo.descriptorSetLayouts =
-        std::vector<VkDescriptorSetLayout>{renderer.descriptorSets.layout};
+        std::vector<VkDescriptorSetLayout>{renderer->descriptorSets.layout};
     pipelineCreateInfo.computeShaderStageCreateFlags = 0;
     pipelineCreateInfo.pipelineCreateFlags = 0;
+    pipelineCreateInfo.pipelineCache = renderer->pipelineCache;
+    pipelineCreateInfo.specializationInfo = &specializationInfo;
+
+    renderer->pipeline = createPipeline(renderer->device, pipelineCreateInfo);
+    specializationData[SHADER_PASS_CONSTANT] = 1;
+    renderer->shadingPipeline = createPipeline(renderer->device, pipelineCreateInfo);
+
+    vkDestroyShaderModule(renderer->device, renderShader, nullptr);
+
+    if (renderer->sceneLimits.blockRaster){
+        VkShaderModule blockBoundsShader = createShaderModule(renderer->device, "block_bounds.spv");
+
+        // block_bounds.vert only needs the block scale, constant_id 0 as in shader.comp.
+        VkSpecializationInfo blockBoundsSpecializationInfo{};
+        blockBoundsSpecializationInfo.mapEntryCount = 1;
+        blockBoundsSpecializationInfo.pMapEntries = specializationEntries;
+        blockBoundsSpecializationInfo.dataSize = sizeof(uint32_t);
+        blockBoundsSpecializationInfo.pData = specializationData;
+
+        VkPushConstantRange extentRange{};
+        extentRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        extentRange.offset = 0;
+        extentRange.size = 2 * sizeof(float);
+
+        DepthPipelineCreateInfo blockBoundsPipelineInfo{};
+        blockBoundsPipelineInfo.vertexShader = blockBoundsShader;
+        blockBoundsPipelineInfo.descriptorSetLayouts =
+            std::vector<VkDescriptorSetLayout>{renderer->descriptorSets.layout};
+        blockBoundsPipelineInfo.pushConstantRanges = std::vector<VkPushConstantRange>{extentRange};
+        blockBoundsPipelineInfo.renderPass = renderer->blockBoundsRenderPass;
+        // Rays only start at the nearest box, so back faces may as well be drawn.
+        blockBoundsPipelineInfo.cullMode = VK_CULL_MODE_NONE;
+        blockBoundsPipelineInfo.depthCompareOp = VK_COMPARE_OP_GREATER;
+        blockBoundsPipelineInfo.pipelineCache = renderer->pipelineCache;
+        blockBoundsPipelineInfo.specializationInfo = &blockBoundsSpecializationInfo;
+
+        renderer->blockBoundsPipeline = createDepthPipeline(renderer->device, blockBoundsPipelineInfo);
+
+        vkDestroyShaderModule(renderer->device, blockBoundsShader, nullptr);
+    }
 
-    renderer.pipeline = createPipeline(renderer.device, pipelineCreateInfo);
-
-    vkDestroyShaderModule(renderer.device, renderShader, nullptr);
+    markStartupPhase(startupTimer, "compute pipeline");
 
     // COMMAND BUFFERS
 
-    renderer.renderCommandBuffers.resize(renderer.swapchain.imageCount());
-    createRenderCommandBuffers(
-        renderer.device,
-        renderer.computeCommandPool,
-        renderer.swapchain.imageCount(),
-        renderer.pipeline.layout,
-        renderer.pipeline.pipeline,
-        renderer.descriptorSets.sets.data(),
-        renderer.swapchain.extent,
-        renderer.swapchain.images.data(),
-        renderer.computeAndPresentQueueFamily,
-        renderer.computeAndPresentQueueFamily,
-        renderer.renderCommandBuffers.data()
-    );
+    renderer->profiler = createGpuProfiler(
+        renderer->device,
+        renderer->physicalDevice,
+        renderer->computeAndPresentQueueFamily,
+        PROFILED_PASS_NAMES,
+        targetImageCount(renderer) + 1);
+
+    createTargetCommandBuffers(renderer);
 
     // SYNCHRONIZATION OBJECTS
 
     for(int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++){
-        renderer.imageAvailableSemaphores[i] = createSemaphore(renderer.device);
-        renderer.renderFinishSemaphores[i] = createSemaphore(renderer.device);
-        renderer.inFlightFences[i] = createFence(renderer.device, VK_FENCE_CREATE_SIGNALED_BIT);
+        renderer->imageAvailableSemaphores[i] = createSemaphore(renderer->device);
+        renderer->renderFinishSemaphores[i] = createSemaphore(renderer->device);
+        renderer->inFlightFences[i] = createFence(renderer->device, VK_FENCE_CREATE_SIGNALED_BIT);
+        if (renderer->sceneLimits.streamed)
+            renderer->streamFences[i] = createFence(renderer->device, VK_FENCE_CREATE_SIGNALED_BIT);
     }
-    renderer.imagesInFlight = std::vector<VkFence>(renderer.swapchain.imageCount(), VK_NULL_HANDLE);
+    renderer->imagesInFlight = std::vector<VkFence>(targetImageCount(renderer), VK_NULL_HANDLE);
+
+    markStartupPhase(startupTimer, "command buffers and sync");
+}
+
+Renderer createRenderer(
+    GLFWwindow *window, SceneLimits sceneLimits, PixelOrder pixelOrder, bool enableValidationLayers, PhaseTimer *startupTimer)
+{
+    Renderer renderer{};
+    renderer.window = window;
+    renderer.sceneLimits = sceneLimits;
+    renderer.pixelOrder = pixelOrder;
+    renderer.framebufferResized = false;
+    renderer.currentFrame = 0;
+
+    // DEVICE
+
+    renderer.headless = false;
+    renderer.instance = createInstance(enableValidationLayers, false);
+    renderer.surface = createSurface(renderer.instance, window);
+    renderer.physicalDevice = pickPhysicalDevice(renderer.instance, renderer.surface);
+    renderer.computeAndPresentQueueFamily = 
+        pickComputeAndPresentFamily(renderer.physicalDevice, renderer.surface).index;
+    renderer.device = createLogicalDevice(
+        renderer.physicalDevice,
+        enableValidationLayers,
+        true,
+        1,
+        &renderer.computeAndPresentQueueFamily
+    );
+
+    vkGetDeviceQueue(renderer.device, renderer.computeAndPresentQueueFamily, 0, &renderer.computeAndPresentQueue);
+
+    markStartupPhase(startupTimer, "instance and device");
+
+    // SWAPCHAIN
+
+    renderer.swapchain = createSwapchain(
+        renderer.device,
+        renderer.physicalDevice,
+        window,
+        renderer.surface,
+        VK_NULL_HANDLE);
+
+    markStartupPhase(startupTimer, "swapchain");
+
+    createRendererResources(&renderer, startupTimer);
 
     return renderer;
 }
 
-void drawFrame(Renderer *renderer, CamInfoBuffer *camInfo)
+Renderer createHeadlessRenderer(
+    VkExtent2D extent, SceneLimits sceneLimits, PixelOrder pixelOrder, bool enableValidationLayers, PhaseTimer *startupTimer)
 {
+    Renderer renderer{};
+    renderer.window = nullptr;
+    renderer.sceneLimits = sceneLimits;
+    renderer.pixelOrder = pixelOrder;
+    renderer.framebufferResized = false;
+    renderer.currentFrame = 0;
+
+    // DEVICE
+
+    renderer.headless = true;
+    renderer.instance = createInstance(enableValidationLayers, true);
+    renderer.surface = VK_NULL_HANDLE;
+    renderer.physicalDevice = pickPhysicalDevice(renderer.instance, VK_NULL_HANDLE);
+    renderer.computeAndPresentQueueFamily =
+        pickComputeAndPresentFamily(renderer.physicalDevice, VK_NULL_HANDLE).index;
+    renderer.device = createLogicalDevice(
+        renderer.physicalDevice,
+        enableValidationLayers,
+        false,
+        1,
+        &renderer.computeAndPresentQueueFamily
+    );
+
+    vkGetDeviceQueue(renderer.device, renderer.computeAndPresentQueueFamily, 0, &renderer.computeAndPresentQueue);
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(renderer.physicalDevice, &deviceProperties);
+    std::cout << "Rendering headless on " << deviceProperties.deviceName << std::endl;
+
+    markStartupPhase(startupTimer, "instance and device");
+
+    // OFFSCREEN TARGET
+
+    // One image per frame in flight, so a frame slot always renders to the same image.
+    renderer.offscreen = createOffscreenTarget(
+        renderer.device,
+        renderer.physicalDevice,
+        extent,
+        MAX_FRAMES_IN_FLIGHT);
+    renderer.offscreenFrameIds = std::vector<int64_t>(MAX_FRAMES_IN_FLIGHT, -1);
+
+    markStartupPhase(startupTimer, "offscreen target");
+
+    createRendererResources(&renderer, startupTimer);
+
+    return renderer;
+}
+
+void recreateSwapchain(Renderer *renderer)
+{
+    // A minimized window has a zero sized framebuffer, wait until it is visible again.
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(renderer->window, &width, &height);
+    while (width == 0 || height == 0){
+        glfwWaitEvents();
+        glfwGetFramebufferSize(renderer->window, &width, &height);
+    }
+
+    vkDeviceWaitIdle(renderer->device);
+
+    for (uint32_t i = 0; i < renderer->swapchain.imageCount(); i++)
+        collectProfilerSlot(renderer->device, &renderer->profiler, i);
+
+    uint32_t oldImageCount = renderer->swapchain.imageCount();
+    Swapchain oldSwapchain = renderer->swapchain;
+    renderer->swapchain = createSwapchain(
+        renderer->device,
+        renderer->physicalDevice,
+        renderer->window,
+        renderer->surface,
+        oldSwapchain.swapchain);
+    cleanupSwapchain(renderer->device, oldSwapchain);
+
+    // Pipelines, block buffers and palette are independent of the swapchain and survive.
+    // The visibility buffers and block depth follow the extent, so only they and the
+    // storage image descriptors need rewriting unless the image count changed.
+    cleanupVisibilityBuffers(renderer);
+    createVisibilityBuffers(renderer);
+    cleanupDepthTarget(renderer->device, renderer->blockDepth);
+    createBlockDepth(renderer);
+    if (renderer->swapchain.imageCount() == oldImageCount){
+        writeDescriptorSets(
+            renderer->device,
+            renderer->descriptorSets.sets,
+            std::vector<DescriptorCreateInfo>{
+                targetImageDescriptorInfo(renderer),
+                visibilityDescriptorInfo(renderer),
+                blockDepthDescriptorInfo(renderer)});
+    }else{
+        cleanupCamInfoBuffers(renderer);
+        createCamInfoBuffers(renderer);
+        cleanupBlockFeedbackBuffers(renderer);
+        createBlockFeedbackBuffers(renderer);
+        reallocateDescriptorSets(
+            renderer->device,
+            &renderer->descriptorSets,
+            renderDescriptorInfos(renderer),
+            renderer->swapchain.imageCount());
+        setGpuProfilerSlotCount(renderer->device, &renderer->profiler, renderer->swapchain.imageCount() + 1);
+    }
+
+    vkFreeCommandBuffers(
+        renderer->device,
+        renderer->computeCommandPool,
+        renderer->renderCommandBuffers.size(),
+        renderer->renderCommandBuffers.data());
+    createTargetCommandBuffers(renderer);
+
+    if (!renderer->cpuFrameBuffers.empty()){
+        cleanupCpuPresentResources(renderer);
+        createCpuPresentResources(renderer);
+    }
+
+    renderer->imagesInFlight = std::vector<VkFence>(renderer->swapchain.imageCount(), VK_NULL_HANDLE);
+}
+
+void enableCpuPresent(Renderer *renderer)
+{
+    if (renderer->cpuFrameBuffers.empty())
+        createCpuPresentResources(renderer);
+}
+
+// Waits for the frame slot and acquires the next swapchain image. Returns false if
+// the swapchain had to be recreated and the frame is skipped.
+bool acquireFrame(Renderer *renderer, FrameTimings *timings, uint32_t *imageIndex)
+{
+    std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
     vkWaitForFences(renderer->device, 1, &renderer->inFlightFences[renderer->currentFrame], VK_TRUE, UINT64_MAX);
+    timings->milliseconds[FRAME_STAGE_FENCE_WAIT] = millisecondsSince(stageStart);
 
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(
+    stageStart = std::chrono::steady_clock::now();
+    VkResult acquireResult = vkAcquireNextImageKHR(
         renderer->device,
         renderer->swapchain.swapchain,
         UINT64_MAX,
         renderer->imageAvailableSemaphores[renderer->currentFrame],
         VK_NULL_HANDLE,
-        &imageIndex);
+        imageIndex);
+    timings->milliseconds[FRAME_STAGE_ACQUIRE] = millisecondsSince(stageStart);
 
-    if(renderer->imagesInFlight[imageIndex] != VK_NULL_HANDLE){
-        vkWaitForFences(renderer->device, 1, &renderer->imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+    if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR){
+        recreateSwapchain(renderer);
+        return false;
     }
-    renderer->imagesInFlight[imageIndex] = renderer->inFlightFences[renderer->currentFrame];
-    vkResetFences(renderer->device, 1, &renderer->inFlightFences[renderer->currentFrame]);
+    // A suboptimal swapchain can still be presented to, it is recreated after present.
+    if (acquireResult != VK_SUBOPTIMAL_KHR)
+        handleVkResult(acquireResult, "acquiring swapchain image");
 
-    // TODO: "push constants" are faster way to push small buffers to shaders
-    void *data;
-    vkMapMemory(renderer->device, renderer->camInfoBuffersMemory[imageIndex], 0, sizeof(*camInfo), 0, &data);
-    memcpy(data, camInfo, sizeof(*camInfo));
-    vkUnmapMemory(renderer->device, renderer->camInfoBuffersMemory[imageIndex]);
+    stageStart = std::chrono::steady_clock::now();
+    if(renderer->imagesInFlight[*imageIndex] != VK_NULL_HANDLE){
+        vkWaitForFences(renderer->device, 1, &renderer->imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+    }
+    timings->milliseconds[FRAME_STAGE_FENCE_WAIT] += millisecondsSince(stageStart);
+    collectProfilerSlot(renderer->device, &renderer->profiler, *imageIndex);
+    renderer->imagesInFlight[*imageIndex] = renderer->inFlightFences[renderer->currentFrame];
+    if (renderer->latencyProbe != nullptr)
+        releaseFrameLatencyFence(renderer->latencyProbe, renderer->inFlightFences[renderer->currentFrame]);
+    vkResetFences(renderer->device, 1, &renderer->inFlightFences[renderer->currentFrame]);
+    return true;
+}
 
+// profiled is set for command buffers that write the profiler slot of imageIndex.
+void submitAndPresentFrame(
+    Renderer *renderer,
+    VkCommandBuffer commandBuffer,
+    uint32_t imageIndex,
+    bool profiled,
+    FrameTimings *timings)
+{
+    std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT};
 
     submitCommandBuffers(
         renderer->computeAndPresentQueue,
-         1, &renderer->renderCommandBuffers[imageIndex],
+         1, &commandBuffer,
          1, &renderer->imageAvailableSemaphores[renderer->currentFrame], waitStages,
          1, &renderer->renderFinishSemaphores[renderer->currentFrame],
          renderer->inFlightFences[renderer->currentFrame]);
-
+    renderer->slotFrames[renderer->currentFrame] = renderer->submittedFrames++;
+    if (profiled)
+        markProfilerSlotSubmitted(&renderer->profiler, imageIndex);
+    if (renderer->latencyProbe != nullptr)
+        watchFrameLatency(renderer->latencyProbe, renderer->inFlightFences[renderer->currentFrame], timings->inputTime);
+    timings->milliseconds[FRAME_STAGE_SUBMIT] += millisecondsSince(stageStart);
+
+    stageStart = std::chrono::steady_clock::now();
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -446,17 +1871,193 @@ void drawFrame(Renderer *renderer, CamInfoBuffer *camInfo)
     presentInfo.waitSemaphoreCount = 1;
     presentInfo.pWaitSemaphores = &renderer->renderFinishSemaphores[renderer->currentFrame];
 
-    vkQueuePresentKHR(renderer->computeAndPresentQueue, &presentInfo);
+    VkResult presentResult = vkQueuePresentKHR(renderer->computeAndPresentQueue, &presentInfo);
+
+    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR ||
+        presentResult == VK_SUBOPTIMAL_KHR ||
+        renderer->framebufferResized){
+        renderer->framebufferResized = false;
+        recreateSwapchain(renderer);
+    }else{
+        handleVkResult(presentResult, "presenting swapchain image");
+    }
+    timings->milliseconds[FRAME_STAGE_PRESENT] = millisecondsSince(stageStart);
 
     renderer->currentFrame = (renderer->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
+void drawFrame(Renderer *renderer, CamInfoBuffer *camInfo, FrameTimings *timings)
+{
+    // Filled into a local when the caller does not want timings.
+    FrameTimings unusedTimings{};
+    if (timings == nullptr)
+        timings = &unusedTimings;
+
+    uint32_t imageIndex;
+    if (!acquireFrame(renderer, timings, &imageIndex))
+        return;
+
+    std::chrono::steady_clock::time_point uploadStart = std::chrono::steady_clock::now();
+    // TODO: "push constants" are faster way to push small buffers to shaders
+    void *data;
+    vkMapMemory(renderer->device, renderer->camInfoBuffersMemory[imageIndex], 0, sizeof(*camInfo), 0, &data);
+    memcpy(data, camInfo, sizeof(*camInfo));
+    vkUnmapMemory(renderer->device, renderer->camInfoBuffersMemory[imageIndex]);
+    timings->milliseconds[FRAME_STAGE_SUBMIT] = millisecondsSince(uploadStart);
+
+    submitAndPresentFrame(renderer, renderer->renderCommandBuffers[imageIndex], imageIndex, true, timings);
+}
+
+void drawLatchedFrame(Renderer *renderer, std::function<void(CamInfoBuffer *camInfo)> latch, FrameTimings *timings)
+{
+    FrameTimings unusedTimings{};
+    if (timings == nullptr)
+        timings = &unusedTimings;
+
+    uint32_t imageIndex;
+    if (!acquireFrame(renderer, timings, &imageIndex))
+        return;
+
+    // Input sampled behind a queue of frames waits for all of them on the gpu, so
+    // wait here instead, where it does not count towards the latency. The slot's
+    // fence was never reset without a submit, so it always signals.
+    std::chrono::steady_clock::time_point stageStart = std::chrono::steady_clock::now();
+    uint32_t previousFrame = (renderer->currentFrame + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT;
+    vkWaitForFences(renderer->device, 1, &renderer->inFlightFences[previousFrame], VK_TRUE, UINT64_MAX);
+    timings->milliseconds[FRAME_STAGE_FENCE_WAIT] += millisecondsSince(stageStart);
+
+    CamInfoBuffer camInfo;
+    latch(&camInfo);
+
+    stageStart = std::chrono::steady_clock::now();
+    void *data;
+    vkMapMemory(renderer->device, renderer->camInfoBuffersMemory[imageIndex], 0, sizeof(camInfo), 0, &data);
+    memcpy(data, &camInfo, sizeof(camInfo));
+    vkUnmapMemory(renderer->device, renderer->camInfoBuffersMemory[imageIndex]);
+    timings->milliseconds[FRAME_STAGE_SUBMIT] = millisecondsSince(stageStart);
+
+    submitAndPresentFrame(renderer, renderer->renderCommandBuffers[imageIndex], imageIndex, true, timings);
+}
+
+void drawCpuFrame(Renderer *renderer, const CpuFramebuffer *framebuffer, FrameTimings *timings)
+{
+    FrameTimings unusedTimings{};
+    if (timings == nullptr)
+        timings = &unusedTimings;
+
+    // After a resize the caller renders the next frame at the new extent.
+    if (framebuffer->width != renderer->swapchain.extent.width ||
+        framebuffer->height != renderer->swapchain.extent.height)
+        return;
+
+    uint32_t imageIndex;
+    if (!acquireFrame(renderer, timings, &imageIndex))
+        return;
+
+    std::chrono::steady_clock::time_point uploadStart = std::chrono::steady_clock::now();
+    uint8_t *data;
+    vkMapMemory(renderer->device, renderer->cpuFrameBuffersMemory[imageIndex], 0, VK_WHOLE_SIZE, 0, (void **)&data);
+    VkFormat format = renderer->swapchain.surfaceFormat.format;
+    if (format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB){
+        const uint8_t *pixels = framebuffer->pixels.data();
+        for (size_t i = 0; i < framebuffer->pixels.size(); i += 4){
+            data[i] = pixels[i + 2];
+            data[i + 1] = pixels[i + 1];
+            data[i + 2] = pixels[i];
+            data[i + 3] = pixels[i + 3];
+        }
+    }else{
+        memcpy(data, framebuffer->pixels.data(), framebuffer->pixels.size());
+    }
+    vkUnmapMemory(renderer->device, renderer->cpuFrameBuffersMemory[imageIndex]);
+    timings->milliseconds[FRAME_STAGE_SUBMIT] = millisecondsSince(uploadStart);
+
+    submitAndPresentFrame(renderer, renderer->cpuPresentCommandBuffers[imageIndex], imageIndex, false, timings);
+}
+
+void deliverOffscreenFrame(Renderer *renderer, uint32_t slot, OffscreenFrameCallback callback)
+{
+    if (renderer->offscreenFrameIds[slot] < 0)
+        return;
+
+    void *pixels;
+    vkMapMemory(
+        renderer->device,
+        renderer->offscreen.readbackBuffersMemory[slot],
+        0,
+        VK_WHOLE_SIZE,
+        0,
+        &pixels);
+    callback(renderer->offscreenFrameIds[slot], (const uint8_t *)pixels, renderer->offscreen.extent);
+    vkUnmapMemory(renderer->device, renderer->offscreen.readbackBuffersMemory[slot]);
+
+    renderer->offscreenFrameIds[slot] = -1;
+}
+
+void drawOffscreenFrame(Renderer *renderer, CamInfoBuffer *camInfo, int64_t frameId, OffscreenFrameCallback callback)
+{
+    uint32_t slot = renderer->currentFrame;
+
+    // The previous frame rendered in this slot is read back only once the slot is
+    // needed again, so the GPU keeps MAX_FRAMES_IN_FLIGHT frames ahead of the readback.
+    vkWaitForFences(renderer->device, 1, &renderer->inFlightFences[slot], VK_TRUE, UINT64_MAX);
+    collectProfilerSlot(renderer->device, &renderer->profiler, slot);
+    deliverOffscreenFrame(renderer, slot, callback);
+    vkResetFences(renderer->device, 1, &renderer->inFlightFences[slot]);
+
+    void *data;
+    vkMapMemory(renderer->device, renderer->camInfoBuffersMemory[slot], 0, sizeof(*camInfo), 0, &data);
+    memcpy(data, camInfo, sizeof(*camInfo));
+    vkUnmapMemory(renderer->device, renderer->camInfoBuffersMemory[slot]);
+
+    submitCommandBuffers(
+        renderer->computeAndPresentQueue,
+        1, &renderer->renderCommandBuffers[slot],
+        0, nullptr, nullptr,
+        0, nullptr,
+        renderer->inFlightFences[slot]);
+    renderer->slotFrames[slot] = renderer->submittedFrames++;
+    markProfilerSlotSubmitted(&renderer->profiler, slot);
+
+    renderer->offscreenFrameIds[slot] = frameId;
+    renderer->currentFrame = (renderer->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+void finishOffscreenFrames(Renderer *renderer, OffscreenFrameCallback callback)
+{
+    // Oldest frame first so frames are delivered in submission order.
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++){
+        uint32_t slot = (renderer->currentFrame + i) % MAX_FRAMES_IN_FLIGHT;
+        vkWaitForFences(renderer->device, 1, &renderer->inFlightFences[slot], VK_TRUE, UINT64_MAX);
+        collectProfilerSlot(renderer->device, &renderer->profiler, slot);
+        deliverOffscreenFrame(renderer, slot, callback);
+    }
+}
+
+double offscreenFrameGpuMilliseconds(Renderer *renderer, uint32_t slot)
+{
+    if (renderer->profiler.timestampPool == VK_NULL_HANDLE)
+        return -1;
+    double milliseconds = 0;
+    for (uint32_t pass = 0; pass < PROFILED_PASS_COUNT; pass++)
+        if (pass != PASS_READBACK)
+            milliseconds += renderer->profiler.slotMilliseconds[slot][pass];
+    return milliseconds;
+}
+
 void cleanupRenderer(Renderer *renderer)
 {
+    cleanupCpuPresentResources(renderer);
+
     for(int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++){
         vkDestroySemaphore(renderer->device, renderer->imageAvailableSemaphores[i], nullptr);
         vkDestroySemaphore(renderer->device, renderer->renderFinishSemaphores[i], nullptr);
         vkDestroyFence(renderer->device, renderer->inFlightFences[i], nullptr);
+        if (renderer->sceneLimits.streamed){
+            vkDestroyFence(renderer->device, renderer->streamFences[i], nullptr);
+            vkDestroyBuffer(renderer->device, renderer->streamStagingBuffers[i], nullptr);
+            vkFreeMemory(renderer->device, renderer->streamStagingBuffersMemory[i], nullptr);
+        }
     }
 
     vkDestroyCommandPool(renderer->device, renderer->computeCommandPool, nullptr);
@@ -471,9 +2072,23 @@ void cleanupRenderer(Renderer *renderer)
     vkDestroyBuffer(renderer->device, renderer->voxBlocksBuffer, nullptr);
     vkFreeMemory(renderer->device, renderer->voxBlocksBufferMemory, nullptr);
 
+    vkDestroyBuffer(renderer->device, renderer->voxBlockMipsBuffer, nullptr);
+    vkFreeMemory(renderer->device, renderer->voxBlockMipsBufferMemory, nullptr);
+
+    vkDestroyBuffer(renderer->device, renderer->voxBlockSlotsBuffer, nullptr);
+    vkFreeMemory(renderer->device, renderer->voxBlockSlotsBufferMemory, nullptr);
+
+    vkDestroyBuffer(renderer->device, renderer->voxBlockLightBuffer, nullptr);
+    vkFreeMemory(renderer->device, renderer->voxBlockLightBufferMemory, nullptr);
+
     vkDestroyBuffer(renderer->device, renderer->objectInfoBuffer, nullptr);
     vkFreeMemory(renderer->device, renderer->objectInfoBufferMemory, nullptr);
 
+    vkDestroyBuffer(renderer->device, renderer->blockBoundsBuffer, nullptr);
+    vkFreeMemory(renderer->device, renderer->blockBoundsBufferMemory, nullptr);
+    cleanupDepthTarget(renderer->device, renderer->blockDepth);
+    vkDestroyRenderPass(renderer->device, renderer->blockBoundsRenderPass, nullptr);
+
     vkDestroyBuffer(renderer->device, renderer->paletteStagingBuffer, nullptr);
     vkFreeMemory(renderer->device, renderer->paletteStagingBufferMemory, nullptr);
 
@@ -481,17 +2096,29 @@ void cleanupRenderer(Renderer *renderer)
     vkDestroyImage(renderer->device, renderer->paletteImage, nullptr);
     vkFreeMemory(renderer->device, renderer->paletteImageMemory, nullptr);
 
-    for (int i = 0; i < renderer->swapchain.imageCount(); i++)
-    {
-        vkDestroyBuffer(renderer->device, renderer->camInfoBuffers[i], nullptr);
-        vkFreeMemory(renderer->device, renderer->camInfoBuffersMemory[i], nullptr);
-    }
+    cleanupCamInfoBuffers(renderer);
+    cleanupBlockFeedbackBuffers(renderer);
+    cleanupVisibilityBuffers(renderer);
+    cleanupGpuProfiler(renderer->device, &renderer->profiler);
 
     vkDestroyPipeline(renderer->device, renderer->pipeline.pipeline, nullptr);
     vkDestroyPipelineLayout(renderer->device, renderer->pipeline.layout, nullptr);
+    vkDestroyPipeline(renderer->device, renderer->shadingPipeline.pipeline, nullptr);
+    vkDestroyPipelineLayout(renderer->device, renderer->shadingPipeline.layout, nullptr);
+    if (renderer->sceneLimits.blockRaster){
+        vkDestroyPipeline(renderer->device, renderer->blockBoundsPipeline.pipeline, nullptr);
+        vkDestroyPipelineLayout(renderer->device, renderer->blockBoundsPipeline.layout, nullptr);
+    }
+
+    savePipelineCache(renderer->device, renderer->physicalDevice, renderer->pipelineCache, PIPELINE_CACHE_FILE);
+    vkDestroyPipelineCache(renderer->device, renderer->pipelineCache, nullptr);
 
-    cleanupSwapchain(renderer->device, renderer->swapchain);
+    if (renderer->headless)
+        cleanupOffscreenTarget(renderer->device, renderer->offscreen);
+    else
+        cleanupSwapchain(renderer->device, renderer->swapchain);
     vkDestroyDevice(renderer->device, nullptr);
-    vkDestroySurfaceKHR(renderer->instance, renderer->surface, nullptr);
+    if (!renderer->headless)
+        vkDestroySurfaceKHR(renderer->instance, renderer->surface, nullptr);
     vkDestroyInstance(renderer->instance, nullptr);
 }
@@ -7,25 +7,82 @@
 #include <glm/gtx/quaternion.hpp>
 
 #include <string>
+#include <functional>
 
 #include "vk/swapchain.hpp"
 #include "vk/device.hpp"
 #include "vk/descriptor_set.hpp"
 #include "vk/pipeline.hpp"
+#include "vk/depth_target.hpp"
 #include "vk/synchronization.hpp"
 #include "vk/command_buffers.hpp"
+#include "vk/offscreen.hpp"
+#include "vk/profiler.hpp"
 #include "vox_object.hpp"
+#include "vox_block_encoding.hpp"
+#include "cam_info.hpp"
+#include "palette_cache.hpp"
+#include "timing.hpp"
+#include "frame_telemetry.hpp"
+#include "frame_latency.hpp"
+#include "cpu/tile_renderer.hpp"
 
 const size_t MAX_FRAMES_IN_FLIGHT = 3;
+// Blocks copied per transfer by updateBlocks.
+const uint32_t VOX_BLOCK_UPLOAD_BATCH = 256;
+// Rows of the palette image voxObjectLimits asks for.
+const uint32_t DEFAULT_PALETTE_ROWS = 64;
 
-struct CamInfoBuffer
+// Order shader.comp's invocations visit pixels in. Neighbouring invocations run
+// together, so compact groups of pixels touch fewer blocks at a time.
+enum PixelOrder
 {
-    glm::vec4 camPos;
-    glm::mat4 camRotMat;
+    // Each workgroup traces 64 pixels of one row.
+    PIXEL_ORDER_ROW_MAJOR,
+    // Each workgroup traces an 8x8 tile in Morton order.
+    PIXEL_ORDER_MORTON
+};
+
+const PixelOrder DEFAULT_PIXEL_ORDER = PIXEL_ORDER_ROW_MAJOR;
+
+PixelOrder parsePixelOrder(std::string name);
+const char *pixelOrderName(PixelOrder order);
+
+// Sizes of the scene buffers, fixed for the lifetime of a renderer.
+struct SceneLimits
+{
+    // Objects drawn must all use this block scale, the shader is specialized for it.
+    uint32_t blockScale;
+    uint32_t voxBlockCount;
+    // Words of the voxBlocks buffer blocks are encoded into, see vox_block_encoding.hpp.
+    uint32_t voxBlockWords;
+    uint32_t objectBlockCount;
+    // Distinct palettes the palette image holds at once.
+    uint32_t paletteCount;
+    // Mip levels kept per block for distant rays, 0 traces every ray at full resolution.
+    uint32_t mipCount;
+    // The shader reports the blocks it traces at full resolution, and blocks not
+    // resident in voxBlocks are drawn from their first mip. See block_residency.hpp.
+    bool blockFeedback;
+    // Hits are shaded with light baked per cell, see vox_light.hpp.
+    bool bakedLight;
+    // The bounding boxes of the grid's blocks are rasterized first and each ray
+    // starts at the nearest one, skipping the empty grid in front of it.
+    bool blockRaster;
+    // Blocks and the grid are replaced while frames are in flight with
+    // streamObjectUpdate, which keeps a staging buffer per frame slot.
+    bool streamed;
 };
 
 struct Renderer
 {
+    // Headless renderers have no window, surface or swapchain and render into offscreen.
+    bool headless;
+    GLFWwindow *window;
+    bool framebufferResized;
+    SceneLimits sceneLimits;
+    PixelOrder pixelOrder;
+
     VkInstance instance;
     VkPhysicalDevice physicalDevice;
     VkDevice device;
@@ -34,34 +91,85 @@ struct Renderer
     VkQueue computeAndPresentQueue;
 
     Swapchain swapchain;
+    OffscreenTarget offscreen;
+    // Frame id rendering in each offscreen slot, -1 when the slot holds no unread frame.
+    std::vector<int64_t> offscreenFrameIds;
 
     DescriptorSets descriptorSets;
 
     std::vector<VkBuffer> camInfoBuffers;
     std::vector<VkDeviceMemory> camInfoBuffersMemory;
 
+    // One bit per pool block, set by the shader for blocks it traced at full
+    // resolution. One buffer per target image, accumulated until it is read.
+    std::vector<VkBuffer> blockFeedbackBuffers;
+    std::vector<VkDeviceMemory> blockFeedbackBuffersMemory;
+
+    // Voxel, face and distance each pixel's ray hit, written by the visibility pass
+    // and read by the shading pass. One buffer per target image, sized to its extent.
+    std::vector<VkBuffer> visibilityBuffers;
+    std::vector<VkDeviceMemory> visibilityBuffersMemory;
+
     VkBuffer voxBlockStagingBuffer;
     VkDeviceMemory voxBlockStagingBufferMemory;
 
     VkBuffer voxBlocksBuffer;
     VkDeviceMemory voxBlocksBufferMemory;
+    VoxBlockHeap voxBlockHeap;
+
+    // The slot of each pool block in voxBlocksBuffer, indexed like the mips.
+    VkBuffer voxBlockSlotsBuffer;
+    VkDeviceMemory voxBlockSlotsBufferMemory;
+    std::vector<VoxBlockSlot> voxBlockSlots;
+
+    // Levels 1 to mipCount of each block, built when the block is uploaded.
+    VkBuffer voxBlockMipsBuffer;
+    VkDeviceMemory voxBlockMipsBufferMemory;
+
+    // Baked light of each block, indexed like the mips. Empty without bakedLight.
+    VkBuffer voxBlockLightBuffer;
+    VkDeviceMemory voxBlockLightBufferMemory;
 
     VkBuffer paletteStagingBuffer;
     VkDeviceMemory paletteStagingBufferMemory;
 
+    // 256 x paletteCount, one palette per row, indexed by the object's paletteIndex.
     VkImage paletteImage;
     VkDeviceMemory paletteImageMemory;
     VkImageView paletteImageView;
+    PaletteCache paletteCache;
 
     VkBuffer objectInfoBuffer;
     VkDeviceMemory objectInfoBufferMemory;
 
+    // The draw of the grid's block bounding boxes and the depth they are drawn
+    // into, see block_bounds.vert. Without blockRaster nothing is drawn and the
+    // depth images are 1x1, only there to fill their descriptors.
+    VkBuffer blockBoundsBuffer;
+    VkDeviceMemory blockBoundsBufferMemory;
+    VkRenderPass blockBoundsRenderPass;
+    DepthTarget blockDepth;
+
+    VkPipelineCache pipelineCache;
+    // shader.comp specialized as the visibility pass, which traces the rays, and as
+    // the shading pass, which colours the target image from what they hit.
     Pipeline pipeline;
+    Pipeline shadingPipeline;
+    // Only created with blockRaster.
+    Pipeline blockBoundsPipeline;
 
     VkCommandPool computeCommandPool;
     VkCommandPool transientComputeCommandPool;
 
     std::vector<VkCommandBuffer> renderCommandBuffers;
+    // One query slot per target image plus one for uploads.
+    GpuProfiler profiler;
+
+    // Cpu rendered frames are copied to the swapchain from these, one per swapchain
+    // image. Empty unless enableCpuPresent was called.
+    std::vector<VkBuffer> cpuFrameBuffers;
+    std::vector<VkDeviceMemory> cpuFrameBuffersMemory;
+    std::vector<VkCommandBuffer> cpuPresentCommandBuffers;
 
     VkSemaphore imageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];
     VkSemaphore renderFinishSemaphores[MAX_FRAMES_IN_FLIGHT];
@@ -69,13 +177,96 @@ struct Renderer
     std::vector<VkFence> imagesInFlight;
 
     uint32_t currentFrame;
+    // Frames submitted so far and the number of the one last submitted on each
+    // frame slot, older ones on the slot are done. See framesFinishedBefore.
+    uint64_t submittedFrames;
+    uint64_t slotFrames[MAX_FRAMES_IN_FLIGHT];
+
+    // Only created with streamed limits, one of each per update in flight.
+    VkBuffer streamStagingBuffers[MAX_FRAMES_IN_FLIGHT];
+    VkDeviceMemory streamStagingBuffersMemory[MAX_FRAMES_IN_FLIGHT];
+    VkCommandBuffer streamCommandBuffers[MAX_FRAMES_IN_FLIGHT];
+    VkFence streamFences[MAX_FRAMES_IN_FLIGHT];
+    uint64_t streamedUpdates;
+    // Null unless the caller started one, then every windowed frame is watched.
+    FrameLatencyProbe *latencyProbe;
 };
 
-Renderer createRenderer(GLFWwindow *window, bool enableValidationLayers);
+// Receives a finished offscreen frame as tightly packed RGBA8 rows. pixels is only
+// valid for the duration of the call.
+typedef std::function<void(int64_t frameId, const uint8_t *pixels, VkExtent2D extent)> OffscreenFrameCallback;
+
+// The smallest limits object fits in, with room for its blocks to be edited.
+// voxBlocks holds every block of the pool back to back, see voxBlockBytes.
+SceneLimits voxObjectLimits(VoxObject object, const unsigned char *voxBlocks);
+
+// startupTimer may be null, otherwise each stage of renderer creation is marked on it.
+Renderer createRenderer(
+    GLFWwindow *window, SceneLimits sceneLimits, PixelOrder pixelOrder, bool enableValidationLayers, PhaseTimer *startupTimer);
+// Renders into offscreen images without a window, works on software drivers such as lavapipe.
+Renderer createHeadlessRenderer(
+    VkExtent2D extent, SceneLimits sceneLimits, PixelOrder pixelOrder, bool enableValidationLayers, PhaseTimer *startupTimer);
 
-void updateObject(Renderer *renderer, VoxObject object);
-void updateBlock(Renderer *renderer, int32_t blockIndex, VoxBlock *block);
-void updatePalette(Renderer *renderer, Palette *palette);
+// paletteRow is the palette image row from updatePalette, written in place of object.paletteIndex.
+// Waits for the frames in flight first, they read the block grid.
+void updateObject(Renderer *renderer, VoxObject object, uint32_t paletteRow);
+// voxels holds blockScale^3 bytes. The block is re-encoded and moves to a new
+// slot if it needs a different number of bits.
+void updateBlock(Renderer *renderer, int32_t blockIndex, const unsigned char *voxels);
+// updateBlock for many blocks, VOX_BLOCK_UPLOAD_BATCH at a time.
+void updateBlocks(Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *voxels);
+// Frees the gpu slot of a pool block that is no longer in the grid.
+void releaseBlock(Renderer *renderer, uint32_t blockIndex);
+// updateBlocks for at most VOX_BLOCK_UPLOAD_BATCH blocks followed by updateObject,
+// queued behind the frames in flight instead of waiting for them. Needs
+// sceneLimits.streamed. The blocks must not be read by any frame in flight, so
+// pool blocks and slots that left the grid are only reused once framesFinishedBefore
+// the submittedFrames of when they left.
+void streamObjectUpdate(
+    Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *voxels,
+    VoxObject object, uint32_t paletteRow);
+// True once every frame numbered below frame has finished on the gpu. Does not wait.
+bool framesFinishedBefore(Renderer *renderer, uint64_t frame);
+// light holds voxBlockLightSize bytes per block. Needs sceneLimits.bakedLight.
+void updateBlockLight(Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *light);
+// Uploads only the mips of blocks, which are left without a slot until updateBlocks
+// makes them resident. Needs sceneLimits.blockFeedback.
+void updateBlockMips(Renderer *renderer, uint32_t count, const uint32_t *blockIndices, const unsigned char *const *voxels);
+// Frees the slots of blocks still in the grid, the shader falls back to their mips.
+// Needs sceneLimits.blockFeedback, waits for the frames in flight first.
+void evictBlocks(Renderer *renderer, uint32_t count, const uint32_t *blockIndices);
+// ORs the feedback of every target image that is not in flight into bits, one bit
+// per pool block, and clears it. Returns false if every image was in flight.
+bool readBlockFeedback(Renderer *renderer, std::vector<uint32_t> *bits);
+// Makes each palette resident and writes its palette image row to rows. Palettes
+// already resident are not uploaded again, the rest go in a single transfer.
+void updatePalettes(Renderer *renderer, uint32_t count, const Palette *const *palettes, uint32_t *rows);
+uint32_t updatePalette(Renderer *renderer, const Palette *palette);
+// Uploads every block, the block grid and the palette of object. With block
+// feedback only the mips of the blocks are uploaded.
+// voxBlocks holds every block of the pool back to back, see voxBlockBytes.
+void uploadVoxObject(Renderer *renderer, VoxObject object, const unsigned char *voxBlocks, MemPool<Palette> *palettes);
+// Uploads the baked light of every block of object, light is indexed like voxBlocks.
+void uploadVoxObjectLight(Renderer *renderer, VoxObject object, const unsigned char *light);
 
-void drawFrame(Renderer *rendrer, CamInfoBuffer *camInfo);
+// Rebuilds the swapchain and everything tied to its extent.
+void recreateSwapchain(Renderer *renderer);
+// timings may be null, otherwise its fence wait, acquire, submit and present stages are filled.
+void drawFrame(Renderer *rendrer, CamInfoBuffer *camInfo, FrameTimings *timings);
+// drawFrame for low latency: once an image is acquired and the previous frame is
+// done on the gpu, latch is called to sample input and fill camInfo right before
+// submit. Keeps a single frame queued on the gpu instead of MAX_FRAMES_IN_FLIGHT.
+void drawLatchedFrame(Renderer *renderer, std::function<void(CamInfoBuffer *camInfo)> latch, FrameTimings *timings);
+// Presents frames rendered by the cpu backend instead of the compute shader.
+void enableCpuPresent(Renderer *renderer);
+// Frames whose size does not match the swapchain extent are skipped.
+void drawCpuFrame(Renderer *renderer, const CpuFramebuffer *framebuffer, FrameTimings *timings);
+// Submits a headless frame. Readback is asynchronous: callback is invoked with
+// earlier frames as their slots are reused, finishOffscreenFrames flushes the rest.
+void drawOffscreenFrame(Renderer *renderer, CamInfoBuffer *camInfo, int64_t frameId, OffscreenFrameCallback callback);
+void finishOffscreenFrames(Renderer *renderer, OffscreenFrameCallback callback);
+// Gpu time of the frame last delivered from slot, the slot drawOffscreenFrame
+// used is the renderer's currentFrame before the call. The readback copy is not
+// counted. Negative when the gpu has no timestamps. Valid during the callback.
+double offscreenFrameGpuMilliseconds(Renderer *renderer, uint32_t slot);
 void cleanupRenderer(Renderer *renderPipeline);
\ No newline at end of file
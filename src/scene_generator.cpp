@@ -0,0 +1,258 @@
+#include "scene_generator.hpp"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+const uint32_t TERRAIN_OCTAVES = 5;
+// Width in voxels of the largest terrain noise feature.
+const float TERRAIN_FEATURE_SIZE = 128.0f;
+
+SceneGeneratorOptions defaultSceneGeneratorOptions()
+{
+    SceneGeneratorOptions options{};
+    options.kind = SCENE_TERRAIN;
+    options.width = 256;
+    options.height = 64;
+    options.depth = 256;
+    options.density = 0.5f;
+    options.seed = 1;
+    return options;
+}
+
+SceneKind parseSceneKind(std::string name)
+{
+    if (name == "terrain")
+        return SCENE_TERRAIN;
+    if (name == "menger")
+        return SCENE_MENGER;
+    if (name == "sparse")
+        return SCENE_SPARSE;
+    if (name == "solid")
+        return SCENE_SOLID;
+    throw std::runtime_error("unknown scene " + name + ", expected terrain, menger, sparse or solid");
+}
+
+uint32_t sceneBlockCount(uint32_t voxels, uint32_t blockScale)
+{
+    return (voxels + blockScale - 1) / blockScale;
+}
+
+size_t sceneBlockCapacity(SceneGeneratorOptions options, uint32_t blockScale)
+{
+    return (size_t)sceneBlockCount(options.width, blockScale) *
+        sceneBlockCount(options.height, blockScale) *
+        sceneBlockCount(options.depth, blockScale);
+}
+
+uint32_t hashVoxel(uint32_t seed, uint32_t x, uint32_t y, uint32_t z)
+{
+    uint32_t h = seed * 0x9E3779B1u ^ x * 0x85EBCA77u ^ y * 0xC2B2AE3Du ^ z * 0x27D4EB2Fu;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    h *= 0x297A2D39u;
+    h ^= h >> 15;
+    return h;
+}
+
+float hashUnit(uint32_t seed, uint32_t x, uint32_t y, uint32_t z)
+{
+    return (hashVoxel(seed, x, y, z) >> 8) * (1.0f / (1 << 24));
+}
+
+// Smoothly interpolated lattice noise in [0, 1].
+float valueNoise(uint32_t seed, float x, float z)
+{
+    float fx = floorf(x);
+    float fz = floorf(z);
+    float tx = x - fx;
+    float tz = z - fz;
+    tx = tx * tx * (3 - 2 * tx);
+    tz = tz * tz * (3 - 2 * tz);
+    uint32_t ix = (uint32_t)(int32_t)fx;
+    uint32_t iz = (uint32_t)(int32_t)fz;
+
+    float a = hashUnit(seed, ix, 0, iz);
+    float b = hashUnit(seed, ix + 1, 0, iz);
+    float c = hashUnit(seed, ix, 0, iz + 1);
+    float d = hashUnit(seed, ix + 1, 0, iz + 1);
+    return (a + (b - a) * tx) + ((c + (d - c) * tx) - (a + (b - a) * tx)) * tz;
+}
+
+// Ground height in voxels at column x, z.
+float terrainHeight(SceneGeneratorOptions *options, uint32_t x, uint32_t z)
+{
+    float noise = 0;
+    float amplitude = 0.5f;
+    float frequency = 1.0f / TERRAIN_FEATURE_SIZE;
+    for (uint32_t octave = 0; octave < TERRAIN_OCTAVES; octave++){
+        noise += amplitude * valueNoise(options->seed + octave, x * frequency, z * frequency);
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    // The octaves sum to just under 1, centred around density.
+    return options->height * (options->density + (noise - 0.5f));
+}
+
+bool inMengerSponge(uint32_t size, uint32_t x, uint32_t y, uint32_t z)
+{
+    if (x >= size || y >= size || z >= size)
+        return false;
+    // A voxel is removed if two of its coordinates are in a middle third at any level.
+    while (x > 0 || y > 0 || z > 0){
+        if ((x % 3 == 1) + (y % 3 == 1) + (z % 3 == 1) >= 2)
+            return false;
+        x /= 3;
+        y /= 3;
+        z /= 3;
+    }
+    return true;
+}
+
+uint32_t mengerSpongeSize(SceneGeneratorOptions *options)
+{
+    uint32_t smallestSide = std::min(options->width, std::min(options->height, options->depth));
+    uint32_t size = 1;
+    while (size * 3 <= smallestSide)
+        size *= 3;
+    return size;
+}
+
+void fillPalette(Palette *palette)
+{
+    memset(palette, 0, sizeof(Palette));
+    // Material 1 up to 8 from low to high ground.
+    const Material colors[] = {
+        {70, 60, 50, 255},
+        {95, 80, 60, 255},
+        {60, 110, 45, 255},
+        {75, 130, 55, 255},
+        {95, 145, 70, 255},
+        {130, 130, 125, 255},
+        {165, 165, 160, 255},
+        {235, 235, 240, 255}};
+    for (uint32_t i = 0; i < 8; i++)
+        palette->mats[i] = colors[i];
+}
+
+// Material index plus one, or 0 for empty.
+unsigned char generateVoxel(SceneGeneratorOptions *options, uint32_t mengerSize, float height, uint32_t x, uint32_t y, uint32_t z)
+{
+    // Voxels in the padding up to whole blocks stay empty.
+    if (x >= options->width || y >= options->height || z >= options->depth)
+        return 0;
+    unsigned char heightMaterial = 1 + y * 8 / options->height;
+    switch (options->kind){
+    case SCENE_TERRAIN:
+        return y < height ? heightMaterial : 0;
+    case SCENE_MENGER:
+        return inMengerSponge(mengerSize, x, y, z) ? heightMaterial : 0;
+    case SCENE_SPARSE:
+        return hashUnit(options->seed, x, y, z) < options->density ? heightMaterial : 0;
+    case SCENE_SOLID:
+        return heightMaterial;
+    }
+    return 0;
+}
+
+// Terrain heights of the voxel columns of the block column at blockX, blockZ.
+template<uint32_t N>
+void generateBlockColumnHeights(SceneGeneratorOptions *options, uint32_t blockX, uint32_t blockZ, float heights[N][N])
+{
+    for (uint32_t z = 0; z < N; z++)
+        for (uint32_t x = 0; x < N; x++)
+            heights[z][x] = options->kind == SCENE_TERRAIN ?
+                terrainHeight(options, blockX * N + x, blockZ * N + z) : 0;
+}
+
+// Returns whether the block was left empty.
+template<uint32_t N>
+bool generateVoxBlock(
+    SceneGeneratorOptions *options, uint32_t mengerSize, const float heights[N][N],
+    uint32_t blockX, uint32_t blockY, uint32_t blockZ, VoxBlock<N> *block)
+{
+    bool empty = true;
+    for (uint32_t z = 0; z < N; z++)
+        for (uint32_t y = 0; y < N; y++)
+            for (uint32_t x = 0; x < N; x++){
+                unsigned char voxel = generateVoxel(
+                    options, mengerSize, heights[z][x],
+                    blockX * N + x,
+                    blockY * N + y,
+                    blockZ * N + z);
+                block->voxels[VoxBlock<N>::index(x, y, z)] = voxel;
+                empty = empty && voxel == 0;
+            }
+    return empty;
+}
+
+template<uint32_t N>
+void generateVoxBlockColumn(
+    SceneGeneratorOptions options, uint32_t blockX, uint32_t blockZ, uint32_t blockHeight, VoxBlock<N> *blocks, bool *empty)
+{
+    float heights[N][N];
+    generateBlockColumnHeights<N>(&options, blockX, blockZ, heights);
+    uint32_t mengerSize = mengerSpongeSize(&options);
+    for (uint32_t blockY = 0; blockY < blockHeight; blockY++)
+        empty[blockY] = generateVoxBlock<N>(&options, mengerSize, heights, blockX, blockY, blockZ, &blocks[blockY]);
+}
+
+template<uint32_t N>
+void generateVoxObject(
+    SceneGeneratorOptions options,
+    WorkerPool *pool,
+    MemPool<VoxBlock<N>> *voxBlocks,
+    MemPool<Palette> *palettes,
+    VoxObject *voxObject)
+{
+    voxObject->paletteIndex = palettes->allocateBlock();
+    fillPalette(palettes->getBlock(voxObject->paletteIndex));
+
+    voxObject->blockScale = N;
+    voxObject->blockWidth = sceneBlockCount(options.width, N);
+    voxObject->blockHeight = sceneBlockCount(options.height, N);
+    voxObject->blockDepth = sceneBlockCount(options.depth, N);
+    voxObject->blockIndices = (uint32_t *)calloc(sceneBlockCapacity(options, N), sizeof(uint32_t));
+    uint32_t blockWidth = voxObject->blockWidth;
+    uint32_t blockHeight = voxObject->blockHeight;
+
+    uint32_t mengerSize = mengerSpongeSize(&options);
+    // MemPool is not thread safe, only allocation is serialised. Blocks are
+    // filled on the stack first so empty ones are never allocated.
+    std::mutex allocationMutex;
+
+    // One task per column of blocks, so terrain heights are computed once per voxel column.
+    parallelFor(pool, blockWidth * voxObject->blockDepth, [&](uint32_t task, uint32_t){
+        uint32_t blockX = task % blockWidth;
+        uint32_t blockZ = task / blockWidth;
+
+        float heights[N][N];
+        generateBlockColumnHeights<N>(&options, blockX, blockZ, heights);
+
+        for (uint32_t blockY = 0; blockY < blockHeight; blockY++){
+            VoxBlock<N> block;
+            if (generateVoxBlock<N>(&options, mengerSize, heights, blockX, blockY, blockZ, &block))
+                continue;
+
+            size_t poolIndex;
+            {
+                std::lock_guard<std::mutex> lock(allocationMutex);
+                poolIndex = voxBlocks->allocateBlock();
+            }
+            memcpy(voxBlocks->getBlock(poolIndex), &block, sizeof(VoxBlock<N>));
+            voxObject->blockIndices[blockX + blockY * blockWidth + blockZ * blockWidth * blockHeight] =
+                poolIndex + 1;
+        }
+    });
+}
+
+template void generateVoxObject<8>(SceneGeneratorOptions, WorkerPool *, MemPool<VoxBlock<8>> *, MemPool<Palette> *, VoxObject *);
+template void generateVoxObject<16>(SceneGeneratorOptions, WorkerPool *, MemPool<VoxBlock<16>> *, MemPool<Palette> *, VoxObject *);
+template void generateVoxObject<32>(SceneGeneratorOptions, WorkerPool *, MemPool<VoxBlock<32>> *, MemPool<Palette> *, VoxObject *);
+
+template void generateVoxBlockColumn<8>(SceneGeneratorOptions, uint32_t, uint32_t, uint32_t, VoxBlock<8> *, bool *);
+template void generateVoxBlockColumn<16>(SceneGeneratorOptions, uint32_t, uint32_t, uint32_t, VoxBlock<16> *, bool *);
+template void generateVoxBlockColumn<32>(SceneGeneratorOptions, uint32_t, uint32_t, uint32_t, VoxBlock<32> *, bool *);
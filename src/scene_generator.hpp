@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "vox_object.hpp"
+#include "cpu/worker_pool.hpp"
+
+enum SceneKind
+{
+    // Hills from layered value noise, density is the average fraction of the height filled.
+    SCENE_TERRAIN,
+    // Menger sponge, the largest power of 3 that fits the smallest side.
+    SCENE_MENGER,
+    // Independent random voxels, density is the chance each is filled.
+    SCENE_SPARSE,
+    // Every voxel filled.
+    SCENE_SOLID
+};
+
+struct SceneGeneratorOptions
+{
+    SceneKind kind;
+    // Size of the object in voxels, rounded up to whole blocks. The voxels are
+    // the same whatever the block scale, so scales can be compared on one scene.
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    float density;
+    // The same seed and size always generate the same voxels.
+    uint32_t seed;
+};
+
+SceneGeneratorOptions defaultSceneGeneratorOptions();
+SceneKind parseSceneKind(std::string name);
+// The most blocks of scale blockScale a generated object can need, for sizing the voxBlocks pool.
+size_t sceneBlockCapacity(SceneGeneratorOptions options, uint32_t blockScale);
+
+// Fills blocks in parallel on pool and writes only the blocks that end up with
+// voxels into voxBlocks, so sparse scenes use little memory. Block pool indices
+// depend on thread timing but the voxels never do.
+template<uint32_t N>
+void generateVoxObject(
+    SceneGeneratorOptions options,
+    WorkerPool *pool,
+    MemPool<VoxBlock<N>> *voxBlocks,
+    MemPool<Palette> *palettes,
+    VoxObject *voxObject);
+
+// Materials 1 to 8 from low to high ground, the palette generated objects use.
+void fillPalette(Palette *palette);
+// Generates the blockHeight blocks of the column at blockX, blockZ bottom up and
+// sets empty for those left without voxels. The voxels match generateVoxObject's.
+// width and depth of options can be UINT32_MAX to generate an unbounded world.
+template<uint32_t N>
+void generateVoxBlockColumn(
+    SceneGeneratorOptions options, uint32_t blockX, uint32_t blockZ, uint32_t blockHeight, VoxBlock<N> *blocks, bool *empty);
@@ -0,0 +1,38 @@
+#include "timing.hpp"
+
+#include <stdio.h>
+
+PhaseTimer startPhaseTimer()
+{
+    PhaseTimer timer{};
+    timer.start = std::chrono::steady_clock::now();
+    timer.last = timer.start;
+    return timer;
+}
+
+void markPhase(PhaseTimer *timer, std::string name)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    timer->names.push_back(name);
+    timer->milliseconds.push_back(
+        std::chrono::duration<double, std::milli>(now - timer->last).count());
+    timer->last = now;
+}
+
+void printPhaseTimes(const PhaseTimer *timer, std::string title)
+{
+    double total = std::chrono::duration<double, std::milli>(timer->last - timer->start).count();
+    printf("%s: %.1f ms\n", title.c_str(), total);
+    for (int i = 0; i < timer->names.size(); i++)
+        printf("\t%-24s %8.1f ms\n", timer->names[i].c_str(), timer->milliseconds[i]);
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double sortedPercentile(const std::vector<double> &values, uint32_t percent)
+{
+    return values[(values.size() - 1) * percent / 100];
+}
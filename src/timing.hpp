@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Splits a span of wall clock time into named consecutive phases.
+struct PhaseTimer
+{
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point last;
+    std::vector<std::string> names;
+    std::vector<double> milliseconds;
+};
+
+PhaseTimer startPhaseTimer();
+// Ends the current phase and names it.
+void markPhase(PhaseTimer *timer, std::string name);
+void printPhaseTimes(const PhaseTimer *timer, std::string title);
+
+double millisecondsSince(std::chrono::steady_clock::time_point start);
+// values must be sorted and not empty.
+double sortedPercentile(const std::vector<double> &values, uint32_t percent);
@@ -52,7 +52,10 @@ void bufferTransfer(
     uint32_t copyRegionsCount,
     VkBufferCopy *copyRegions,
     VkBuffer srcBuffer,
-    VkBuffer dstBuffer)
+    VkBuffer dstBuffer,
+    GpuProfiler *profiler,
+    uint32_t profilerSlot,
+    uint32_t profilerPass)
 {
     VkCommandBuffer commandBuffer;
     allocateCommandBuffers(
@@ -67,8 +70,16 @@ void bufferTransfer(
         VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
     );
 
+    if (profiler != nullptr){
+        recordProfilerReset(profiler, commandBuffer, profilerSlot);
+        recordPassBegin(profiler, commandBuffer, profilerSlot, profilerPass);
+    }
+
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, copyRegionsCount, copyRegions);
 
+    if (profiler != nullptr)
+        recordPassEnd(profiler, commandBuffer, profilerSlot, profilerPass);
+
     handleVkResult(
         vkEndCommandBuffer(commandBuffer),
         "recording buffer transfer command");
@@ -83,4 +94,9 @@ void bufferTransfer(
     );
 
     vkQueueWaitIdle(queue);
+
+    if (profiler != nullptr){
+        markProfilerSlotSubmitted(profiler, profilerSlot);
+        collectProfilerSlot(device, profiler, profilerSlot);
+    }
 }
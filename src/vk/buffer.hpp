@@ -2,6 +2,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include "profiler.hpp"
+
 void createBuffer(
     VkDevice device,
     VkPhysicalDevice physicalDevice,
@@ -19,4 +21,7 @@ void bufferTransfer(
     uint32_t copyRegionsCount,
     VkBufferCopy *copyRegions,
     VkBuffer srcBuffer,
-    VkBuffer dstBuffer);
+    VkBuffer dstBuffer,
+    GpuProfiler *profiler = nullptr,
+    uint32_t profilerSlot = 0,
+    uint32_t profilerPass = 0);
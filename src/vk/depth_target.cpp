@@ -0,0 +1,159 @@
+#include "depth_target.hpp"
+
+#include <stdexcept>
+
+#include "image.hpp"
+#include "exceptions.hpp"
+
+VkRenderPass createDepthRenderPass(VkDevice device, VkFormat format)
+{
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = format;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference depthReference{};
+    depthReference.attachment = 0;
+    depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 0;
+    subpass.pDepthStencilAttachment = &depthReference;
+
+    // The previous frame's compute reads finish before the clear, and the depth
+    // writes before this frame's compute reads.
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &depthAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+
+    VkRenderPass renderPass;
+    handleVkResult(
+        vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass),
+        "creating depth render pass");
+
+    return renderPass;
+}
+
+void checkDepthTargetFormat(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    if ((formatProperties.optimalTilingFeatures & needed) != needed)
+        throw std::runtime_error("depth format can not be rendered to and sampled on this device");
+}
+
+DepthTarget createDepthTarget(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    VkQueue queue,
+    VkCommandPool commandPool,
+    VkRenderPass renderPass,
+    VkFormat format,
+    VkExtent2D extent,
+    uint32_t imageCount)
+{
+    DepthTarget target{};
+    target.extent = extent;
+    target.format = format;
+
+    target.images.resize(imageCount);
+    target.imagesMemory.resize(imageCount);
+    target.imageViews.resize(imageCount);
+    target.framebuffers.resize(imageCount);
+
+    VkImageSubresourceRange depthRange = createImageSubresourceRange(
+        VK_IMAGE_ASPECT_DEPTH_BIT,
+        0, 1,
+        0, 1);
+
+    for (int i = 0; i < imageCount; i++)
+    {
+        createImage(
+            device,
+            physicalDevice,
+            VK_IMAGE_TYPE_2D,
+            format,
+            VkExtent3D{extent.width, extent.height, 1},
+            0,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            1,
+            1,
+            VK_SAMPLE_COUNT_1_BIT,
+            VK_IMAGE_TILING_OPTIMAL,
+            false,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &target.images[i],
+            &target.imagesMemory[i]);
+
+        target.imageViews[i] = createImageView(
+            device,
+            target.images[i],
+            format,
+            VK_IMAGE_VIEW_TYPE_2D,
+            depthRange);
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &target.imageViews[i];
+        framebufferInfo.width = extent.width;
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;
+        handleVkResult(
+            vkCreateFramebuffer(device, &framebufferInfo, nullptr, &target.framebuffers[i]),
+            "creating depth framebuffer");
+
+        transitionImageLayout(
+            device,
+            queue,
+            commandPool,
+            target.images[i],
+            depthRange,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            0,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    return target;
+}
+
+void cleanupDepthTarget(VkDevice device, DepthTarget target)
+{
+    for (int i = 0; i < target.imageCount(); i++)
+    {
+        vkDestroyFramebuffer(device, target.framebuffers[i], nullptr);
+        vkDestroyImageView(device, target.imageViews[i], nullptr);
+        vkDestroyImage(device, target.images[i], nullptr);
+        vkFreeMemory(device, target.imagesMemory[i], nullptr);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// Depth images written by a depth only render pass and then sampled by compute
+// shaders, each with its own framebuffer. Between passes the images are in
+// VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL.
+struct DepthTarget
+{
+    std::vector<VkImage> images;
+    std::vector<VkDeviceMemory> imagesMemory;
+    std::vector<VkImageView> imageViews;
+    std::vector<VkFramebuffer> framebuffers;
+    VkExtent2D extent;
+    VkFormat format;
+
+    uint32_t imageCount() { return images.size(); };
+};
+
+// A single subpass writing only a depth attachment of format, which compute
+// shaders read after the pass.
+VkRenderPass createDepthRenderPass(VkDevice device, VkFormat format);
+// Throws if format cannot be both a depth attachment and sampled on physicalDevice.
+void checkDepthTargetFormat(VkPhysicalDevice physicalDevice, VkFormat format);
+// The images are moved to their read only layout on queue, so compute shaders
+// may sample them before the first render pass writes them.
+DepthTarget createDepthTarget(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    VkQueue queue,
+    VkCommandPool commandPool,
+    VkRenderPass renderPass,
+    VkFormat format,
+    VkExtent2D extent,
+    uint32_t imageCount);
+void cleanupDepthTarget(VkDevice device, DepthTarget target);
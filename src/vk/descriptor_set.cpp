@@ -185,4 +185,18 @@ DescriptorSets createDescriptorSets(VkDevice device, std::vector<DescriptorCreat
         allocateDescriptorSets(device, descriptorSets.pool, descriptorSets.layout, setCount);
     writeDescriptorSets(device, descriptorSets.sets, descriptorInfos);
     return descriptorSets;
-}
\ No newline at end of file
+}
+
+void reallocateDescriptorSets(
+    VkDevice device,
+    DescriptorSets *descriptorSets,
+    std::vector<DescriptorCreateInfo> descriptorInfos,
+    uint32_t setCount)
+{
+    vkDestroyDescriptorPool(device, descriptorSets->pool, nullptr);
+
+    descriptorSets->pool = createDescriptorPool(device, descriptorInfos, setCount);
+    descriptorSets->sets =
+        allocateDescriptorSets(device, descriptorSets->pool, descriptorSets->layout, setCount);
+    writeDescriptorSets(device, descriptorSets->sets, descriptorInfos);
+}
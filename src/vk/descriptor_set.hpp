@@ -27,3 +27,16 @@ DescriptorSets createDescriptorSets(
     VkDevice device,
     std::vector<DescriptorCreateInfo> descriptorInfos,
     uint32_t setCount);
+
+void writeDescriptorSets(
+    VkDevice device,
+    std::vector<VkDescriptorSet> descriptorSets,
+    std::vector<DescriptorCreateInfo> descriptorInfos);
+
+// Replaces the pool and sets of descriptorSets but keeps its layout so
+// pipelines created against it stay valid.
+void reallocateDescriptorSets(
+    VkDevice device,
+    DescriptorSets *descriptorSets,
+    std::vector<DescriptorCreateInfo> descriptorInfos,
+    uint32_t setCount);
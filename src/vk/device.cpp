@@ -51,7 +51,7 @@ bool checkValidationLayerSupport()
     return true;
 }
 
-VkInstance createInstance(const bool enableValidationLayers)
+VkInstance createInstance(const bool enableValidationLayers, const bool headless)
 {
     VkApplicationInfo appInfo{};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -65,9 +65,11 @@ VkInstance createInstance(const bool enableValidationLayers)
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
+    // Headless instances never create a surface so they do not need glfw initialised.
     uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char **glfwExtensions = nullptr;
+    if (!headless)
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
     createInfo.enabledExtensionCount = glfwExtensionCount;
     createInfo.ppEnabledExtensionNames = glfwExtensions;
@@ -128,12 +130,35 @@ bool isPhysicalDeviceSuitable(VkPhysicalDevice physicalDevice, VkSurfaceKHR surf
 
     QueueFamilyInfo computeAndPresentFamily = pickComputeAndPresentFamily(physicalDevice, surface);
 
+    if (surface == VK_NULL_HANDLE)
+        return computeAndPresentFamily.found;
+
     return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
            computeAndPresentFamily.found &&
            checkDeviceExtensionSupport(physicalDevice) &&
            checkSwapchainSupport(physicalDevice, surface);
 }
 
+uint32_t scorePhysicalDeviceType(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+    switch (deviceProperties.deviceType)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return 5;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return 4;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return 3;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
 VkPhysicalDevice pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface)
 {
     uint32_t physicalDeviceCount = 0;
@@ -145,20 +170,29 @@ VkPhysicalDevice pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface)
 
     std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
     vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices.data());
+
+    // Without a surface any device type will do, including software drivers such as lavapipe.
+    VkPhysicalDevice bestDevice = VK_NULL_HANDLE;
+    uint32_t bestScore = 0;
     for (const auto &physicalDevice : physicalDevices)
     {
-        if (isPhysicalDeviceSuitable(physicalDevice, surface))
+        uint32_t score = scorePhysicalDeviceType(physicalDevice);
+        if (isPhysicalDeviceSuitable(physicalDevice, surface) && score > bestScore)
         {
-            return physicalDevice;
+            bestDevice = physicalDevice;
+            bestScore = score;
         }
     }
 
-    throw std::runtime_error("failed to find suitable GPU");
+    if (bestDevice == VK_NULL_HANDLE)
+        throw std::runtime_error("failed to find suitable GPU");
+    return bestDevice;
 }
 
 VkDevice createLogicalDevice(
     VkPhysicalDevice physicalDevice,
     bool enableValidationLayers,
+    bool enableSwapchain,
     uint32_t queueFamilyIndiciesCount,
     uint32_t *queueFamilyIndices)
 {
@@ -176,8 +210,13 @@ VkDevice createLogicalDevice(
         queueCreateInfos[i] = queueCreateInfo;
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+    // Optional, the gpu profiler only counts shader invocations when it is enabled.
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.pNext = nullptr;
@@ -188,8 +227,15 @@ VkDevice createLogicalDevice(
 
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    if (enableSwapchain)
+    {
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    }
+    else
+    {
+        createInfo.enabledExtensionCount = 0;
+    }
 
     if (enableValidationLayers)
     {
@@ -215,10 +261,12 @@ uint32_t scoreComputeAndPresentFamily(VkPhysicalDevice physicalDevice, uint32_t
     if ((properties.queueFlags & VK_QUEUE_COMPUTE_BIT) == 0)
         return 0;
 
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, index, surface, &presentSupport);
-    if (!presentSupport)
-        return 0;
+    if (surface != VK_NULL_HANDLE){
+        VkBool32 presentSupport = false;
+        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, index, surface, &presentSupport);
+        if (!presentSupport)
+            return 0;
+    }
 
     uint32_t score = 1;
     if((properties.queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0)
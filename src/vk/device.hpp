@@ -11,13 +11,16 @@ struct QueueFamilyInfo{
     uint32_t score;
 };
 
-VkInstance createInstance(const bool enableValidationLayers);
+VkInstance createInstance(const bool enableValidationLayers, const bool headless);
 VkSurfaceKHR createSurface(VkInstance instance, GLFWwindow *window);
+// A null surface picks a device for headless rendering which only needs compute.
 VkPhysicalDevice pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface);
 VkDevice createLogicalDevice(
     VkPhysicalDevice physicalDevice,
     bool enableValidationLayers,
+    bool enableSwapchain,
     uint32_t queueFamilyIndiciesCount,
     uint32_t *queueFamilyIndices);
+// A null surface ignores present support.
 QueueFamilyInfo pickComputeAndPresentFamily(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
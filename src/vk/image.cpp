@@ -12,7 +12,7 @@ VkImageSubresourceRange createImageSubresourceRange(
     uint32_t arrayLayerCount)
 {
     VkImageSubresourceRange subresourceRange{};
-    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresourceRange.aspectMask = aspectMask;
     subresourceRange.baseMipLevel = baseMipLevel;
     subresourceRange.levelCount = mipLevelCount;
     subresourceRange.baseArrayLayer = baseArrayLayer;
@@ -0,0 +1,75 @@
+#include "offscreen.hpp"
+
+#include "image.hpp"
+#include "buffer.hpp"
+
+OffscreenTarget createOffscreenTarget(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    VkExtent2D extent,
+    uint32_t imageCount)
+{
+    OffscreenTarget target{};
+    target.extent = extent;
+    target.format = VK_FORMAT_R8G8B8A8_UNORM;
+
+    target.images.resize(imageCount);
+    target.imagesMemory.resize(imageCount);
+    target.imageViews.resize(imageCount);
+    target.readbackBuffers.resize(imageCount);
+    target.readbackBuffersMemory.resize(imageCount);
+
+    for (int i = 0; i < imageCount; i++)
+    {
+        createImage(
+            device,
+            physicalDevice,
+            VK_IMAGE_TYPE_2D,
+            target.format,
+            VkExtent3D{extent.width, extent.height, 1},
+            0,
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            1,
+            1,
+            VK_SAMPLE_COUNT_1_BIT,
+            VK_IMAGE_TILING_OPTIMAL,
+            false,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &target.images[i],
+            &target.imagesMemory[i]);
+
+        target.imageViews[i] = createImageView(
+            device,
+            target.images[i],
+            target.format,
+            VK_IMAGE_VIEW_TYPE_2D,
+            createImageSubresourceRange(
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                0, 1,
+                0, 1));
+
+        createBuffer(
+            device,
+            physicalDevice,
+            extent.width * extent.height * 4,
+            0,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &target.readbackBuffers[i],
+            &target.readbackBuffersMemory[i]);
+    }
+
+    return target;
+}
+
+void cleanupOffscreenTarget(VkDevice device, OffscreenTarget target)
+{
+    for (int i = 0; i < target.imageCount(); i++)
+    {
+        vkDestroyImageView(device, target.imageViews[i], nullptr);
+        vkDestroyImage(device, target.images[i], nullptr);
+        vkFreeMemory(device, target.imagesMemory[i], nullptr);
+        vkDestroyBuffer(device, target.readbackBuffers[i], nullptr);
+        vkFreeMemory(device, target.readbackBuffersMemory[i], nullptr);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// Storage images rendered to in place of swapchain images, each with a host
+// visible buffer that the finished frame is copied into for readback.
+struct OffscreenTarget
+{
+    std::vector<VkImage> images;
+    std::vector<VkDeviceMemory> imagesMemory;
+    std::vector<VkImageView> imageViews;
+    std::vector<VkBuffer> readbackBuffers;
+    std::vector<VkDeviceMemory> readbackBuffersMemory;
+    VkExtent2D extent;
+    VkFormat format;
+
+    uint32_t imageCount() { return images.size(); };
+};
+
+OffscreenTarget createOffscreenTarget(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    VkExtent2D extent,
+    uint32_t imageCount);
+void cleanupOffscreenTarget(VkDevice device, OffscreenTarget target);
@@ -4,18 +4,20 @@
 
 #include "exceptions.hpp"
 
-VkPipelineLayout createPipelineLayout(VkDevice device, const PipelineCreateInfo *info)
+VkPipelineLayout createPipelineLayout(
+    VkDevice device,
+    const std::vector<VkDescriptorSetLayout> *descriptorSetLayouts,
+    const std::vector<VkPushConstantRange> *pushConstantRanges)
 {
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.pNext = nullptr;
     // flags is reserved for future use
     pipelineLayoutInfo.flags = 0;
-    pipelineLayoutInfo.setLayoutCount = info->descriptorSetLayouts.size();
-    pipelineLayoutInfo.pSetLayouts = info->descriptorSetLayouts.data();
-    // TODO: support push constants
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    pipelineLayoutInfo.setLayoutCount = descriptorSetLayouts->size();
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts->data();
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantRanges->size();
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges->data();
 
     VkPipelineLayout pipelineLayout;
     handleVkResult(
@@ -34,8 +36,7 @@ VkPipeline createComputePipeline(VkDevice device, VkPipelineLayout pipelineLayou
     shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
     shaderStageInfo.module = info->computeShader;
     shaderStageInfo.pName = "main";
-    // TODO: support shader specialization
-    shaderStageInfo.pSpecializationInfo = nullptr;
+    shaderStageInfo.pSpecializationInfo = info->specializationInfo;
 
     VkComputePipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -47,7 +48,7 @@ VkPipeline createComputePipeline(VkDevice device, VkPipelineLayout pipelineLayou
 
     VkPipeline pipeline;
     handleVkResult(
-        vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline),
+        vkCreateComputePipelines(device, info->pipelineCache, 1, &pipelineInfo, nullptr, &pipeline),
         "creating compute pipeline");
 
     return pipeline;
@@ -55,7 +56,7 @@ VkPipeline createComputePipeline(VkDevice device, VkPipelineLayout pipelineLayou
 
 Pipeline createPipeline(VkDevice device, PipelineCreateInfo info)
 {
-    VkPipelineLayout layout = createPipelineLayout(device, &info);
+    VkPipelineLayout layout = createPipelineLayout(device, &info.descriptorSetLayouts, &info.pushConstantRanges);
     VkPipeline vkPipeline = createComputePipeline(device, layout, &info);
 
     Pipeline pipeline{};
@@ -64,3 +65,91 @@ Pipeline createPipeline(VkDevice device, PipelineCreateInfo info)
 
     return pipeline;
 }
+
+Pipeline createDepthPipeline(VkDevice device, DepthPipelineCreateInfo info)
+{
+    VkPipelineLayout layout = createPipelineLayout(device, &info.descriptorSetLayouts, &info.pushConstantRanges);
+
+    VkPipelineShaderStageCreateInfo vertexStageInfo{};
+    vertexStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertexStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertexStageInfo.module = info.vertexShader;
+    vertexStageInfo.pName = "main";
+    vertexStageInfo.pSpecializationInfo = info.specializationInfo;
+
+    // Vertices are generated in the shader from gl_VertexIndex.
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{};
+    inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportInfo{};
+    viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportInfo.viewportCount = 1;
+    viewportInfo.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationInfo{};
+    rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationInfo.depthClampEnable = VK_FALSE;
+    rasterizationInfo.rasterizerDiscardEnable = VK_FALSE;
+    rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationInfo.cullMode = info.cullMode;
+    rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationInfo.depthBiasEnable = VK_FALSE;
+    rasterizationInfo.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleInfo{};
+    multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampleInfo.sampleShadingEnable = VK_FALSE;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilInfo{};
+    depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilInfo.depthTestEnable = VK_TRUE;
+    depthStencilInfo.depthWriteEnable = VK_TRUE;
+    depthStencilInfo.depthCompareOp = info.depthCompareOp;
+    depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilInfo.stencilTestEnable = VK_FALSE;
+
+    // No color attachments, so no blend attachment states.
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo{};
+    colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendInfo.attachmentCount = 0;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicStateInfo{};
+    dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateInfo.dynamicStateCount = sizeof(dynamicStates) / sizeof(VkDynamicState);
+    dynamicStateInfo.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &vertexStageInfo;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
+    pipelineInfo.pViewportState = &viewportInfo;
+    pipelineInfo.pRasterizationState = &rasterizationInfo;
+    pipelineInfo.pMultisampleState = &multisampleInfo;
+    pipelineInfo.pDepthStencilState = &depthStencilInfo;
+    pipelineInfo.pColorBlendState = &colorBlendInfo;
+    pipelineInfo.pDynamicState = &dynamicStateInfo;
+    pipelineInfo.layout = layout;
+    pipelineInfo.renderPass = info.renderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    VkPipeline vkPipeline;
+    handleVkResult(
+        vkCreateGraphicsPipelines(device, info.pipelineCache, 1, &pipelineInfo, nullptr, &vkPipeline),
+        "creating depth pipeline");
+
+    Pipeline pipeline{};
+    pipeline.layout = layout;
+    pipeline.pipeline = vkPipeline;
+
+    return pipeline;
+}
@@ -10,8 +10,28 @@ struct PipelineCreateInfo
 {
     VkShaderModule computeShader;
     std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+    std::vector<VkPushConstantRange> pushConstantRanges;
     VkPipelineShaderStageCreateFlags computeShaderStageCreateFlags;
     VkPipelineCreateFlags pipelineCreateFlags;
+    VkPipelineCache pipelineCache;
+    // Constants the compute shader is specialized with, may be null.
+    const VkSpecializationInfo *specializationInfo;
+};
+
+// A pipeline that only writes depth: a vertex shader, no fragment shader and a
+// single depth attachment. Viewport and scissor are dynamic so the pipeline
+// survives target resizes.
+struct DepthPipelineCreateInfo
+{
+    VkShaderModule vertexShader;
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+    std::vector<VkPushConstantRange> pushConstantRanges;
+    VkRenderPass renderPass;
+    VkCullModeFlags cullMode;
+    VkCompareOp depthCompareOp;
+    VkPipelineCache pipelineCache;
+    // Constants the vertex shader is specialized with, may be null.
+    const VkSpecializationInfo *specializationInfo;
 };
 
 struct Pipeline
@@ -20,4 +40,5 @@ struct Pipeline
     VkPipeline pipeline;
 };
 
-Pipeline createPipeline(VkDevice device, PipelineCreateInfo info);
\ No newline at end of file
+Pipeline createPipeline(VkDevice device, PipelineCreateInfo info);
+Pipeline createDepthPipeline(VkDevice device, DepthPipelineCreateInfo info);
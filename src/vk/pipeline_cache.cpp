@@ -0,0 +1,126 @@
+#include "pipeline_cache.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+
+#include "exceptions.hpp"
+
+const uint32_t PIPELINE_CACHE_FILE_MAGIC = 0x43505652; // "RVPC"
+
+// Written in front of the driver's cache data. The driver header inside the data
+// has no driver version, so a driver update would otherwise go unnoticed.
+struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+};
+
+PipelineCacheFileHeader createPipelineCacheFileHeader(VkPhysicalDevice physicalDevice, uint64_t dataSize)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    PipelineCacheFileHeader header{};
+    header.magic = PIPELINE_CACHE_FILE_MAGIC;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = dataSize;
+    return header;
+}
+
+bool pipelineCacheFileHeaderMatches(PipelineCacheFileHeader *fileHeader, PipelineCacheFileHeader *deviceHeader)
+{
+    return fileHeader->magic == deviceHeader->magic &&
+           fileHeader->vendorID == deviceHeader->vendorID &&
+           fileHeader->deviceID == deviceHeader->deviceID &&
+           fileHeader->driverVersion == deviceHeader->driverVersion &&
+           memcmp(fileHeader->pipelineCacheUUID, deviceHeader->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+std::vector<char> readPipelineCacheFile(VkPhysicalDevice physicalDevice, std::string filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cout << "No pipeline cache at " << filename << ", starting cold" << std::endl;
+        return std::vector<char>();
+    }
+
+    PipelineCacheFileHeader fileHeader{};
+    file.read((char *)&fileHeader, sizeof(fileHeader));
+
+    PipelineCacheFileHeader deviceHeader = createPipelineCacheFileHeader(physicalDevice, 0);
+    if (!file || !pipelineCacheFileHeaderMatches(&fileHeader, &deviceHeader))
+    {
+        std::cout << "Pipeline cache " << filename << " is for another device or driver, ignoring it" << std::endl;
+        return std::vector<char>();
+    }
+
+    std::vector<char> data(fileHeader.dataSize);
+    file.read(data.data(), data.size());
+    if (!file)
+    {
+        std::cout << "Pipeline cache " << filename << " is truncated, ignoring it" << std::endl;
+        return std::vector<char>();
+    }
+
+    std::cout << "Loaded pipeline cache " << filename << " (" << data.size() << " bytes)" << std::endl;
+    return data;
+}
+
+VkPipelineCache loadPipelineCache(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    std::string filename)
+{
+    std::vector<char> data = readPipelineCacheFile(physicalDevice, filename);
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.flags = 0;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    VkPipelineCache pipelineCache;
+    handleVkResult(
+        vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache),
+        "creating pipeline cache");
+
+    return pipelineCache;
+}
+
+void savePipelineCache(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    VkPipelineCache pipelineCache,
+    std::string filename)
+{
+    size_t dataSize;
+    handleVkResult(
+        vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr),
+        "getting pipeline cache size");
+    std::vector<char> data(dataSize);
+    handleVkResult(
+        vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()),
+        "getting pipeline cache data");
+
+    PipelineCacheFileHeader header = createPipelineCacheFileHeader(physicalDevice, dataSize);
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to write pipeline cache " << filename << std::endl;
+        return;
+    }
+    file.write((char *)&header, sizeof(header));
+    file.write(data.data(), dataSize);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+// Creates a pipeline cache seeded from filename. The file is only used if it
+// was written for the same device, pipeline cache UUID and driver version,
+// otherwise the cache starts empty.
+VkPipelineCache loadPipelineCache(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    std::string filename);
+
+void savePipelineCache(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    VkPipelineCache pipelineCache,
+    std::string filename);
@@ -0,0 +1,292 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "exceptions.hpp"
+
+VkQueryPool createQueryPool(
+    VkDevice device,
+    VkQueryType queryType,
+    uint32_t queryCount,
+    VkQueryPipelineStatisticFlags pipelineStatistics)
+{
+    VkQueryPoolCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.flags = 0;
+    createInfo.queryType = queryType;
+    createInfo.queryCount = queryCount;
+    createInfo.pipelineStatistics = pipelineStatistics;
+
+    VkQueryPool queryPool;
+    handleVkResult(
+        vkCreateQueryPool(device, &createInfo, nullptr, &queryPool),
+        "creating query pool");
+    return queryPool;
+}
+
+void cleanupQueryPools(VkDevice device, GpuProfiler *profiler)
+{
+    if (profiler->timestampPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device, profiler->timestampPool, nullptr);
+    if (profiler->statisticsPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device, profiler->statisticsPool, nullptr);
+}
+
+void createQueryPools(VkDevice device, GpuProfiler *profiler, bool statistics)
+{
+    uint32_t queryCount = profiler->slotCount * profiler->passCount();
+
+    // Two timestamps per pass, one statistics query per pass.
+    profiler->timestampPool = createQueryPool(device, VK_QUERY_TYPE_TIMESTAMP, queryCount * 2, 0);
+    profiler->statisticsPool = statistics
+        ? createQueryPool(
+            device,
+            VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            queryCount,
+            VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT)
+        : VK_NULL_HANDLE;
+
+    profiler->slotPasses = std::vector<uint32_t>(profiler->slotCount, 0);
+    profiler->slotSubmitted = std::vector<bool>(profiler->slotCount, false);
+    profiler->slotMilliseconds = std::vector<std::vector<double>>(
+        profiler->slotCount, std::vector<double>(profiler->passCount()));
+}
+
+GpuProfiler createGpuProfiler(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    uint32_t queueFamily,
+    std::vector<std::string> passNames,
+    uint32_t slotCount)
+{
+    if (passNames.size() > 32)
+        throw std::runtime_error("gpu profiler supports at most 32 passes");
+
+    GpuProfiler profiler{};
+    profiler.passNames = passNames;
+    profiler.slotCount = slotCount;
+    profiler.timestampPool = VK_NULL_HANDLE;
+    profiler.statisticsPool = VK_NULL_HANDLE;
+
+    profiler.milliseconds = std::vector<std::vector<double>>(passNames.size(), std::vector<double>(GPU_PROFILER_HISTORY_LENGTH));
+    profiler.invocations = std::vector<std::vector<uint64_t>>(passNames.size(), std::vector<uint64_t>(GPU_PROFILER_HISTORY_LENGTH));
+    profiler.sampleCounts = std::vector<uint32_t>(passNames.size(), 0);
+    profiler.nextSamples = std::vector<uint32_t>(passNames.size(), 0);
+
+    uint32_t queueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    uint32_t timestampValidBits = queueFamilies[queueFamily].timestampValidBits;
+
+    if (timestampValidBits == 0){
+        printf("gpu profiler disabled, queue family %u has no timestamp support\n", queueFamily);
+        profiler.slotPasses = std::vector<uint32_t>(slotCount, 0);
+        profiler.slotSubmitted = std::vector<bool>(slotCount, false);
+        profiler.slotMilliseconds = std::vector<std::vector<double>>(slotCount, std::vector<double>(passNames.size()));
+        return profiler;
+    }
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    profiler.nanosecondsPerTick = deviceProperties.limits.timestampPeriod;
+    profiler.timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (1ull << timestampValidBits) - 1;
+
+    // Enabled by createLogicalDevice whenever it is supported.
+    VkPhysicalDeviceFeatures deviceFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+
+    createQueryPools(device, &profiler, deviceFeatures.pipelineStatisticsQuery);
+    return profiler;
+}
+
+void setGpuProfilerSlotCount(VkDevice device, GpuProfiler *profiler, uint32_t slotCount)
+{
+    profiler->slotCount = slotCount;
+    if (profiler->timestampPool == VK_NULL_HANDLE){
+        profiler->slotPasses = std::vector<uint32_t>(slotCount, 0);
+        profiler->slotSubmitted = std::vector<bool>(slotCount, false);
+        profiler->slotMilliseconds = std::vector<std::vector<double>>(slotCount, std::vector<double>(profiler->passCount()));
+        return;
+    }
+
+    bool statistics = profiler->statisticsPool != VK_NULL_HANDLE;
+    cleanupQueryPools(device, profiler);
+    createQueryPools(device, profiler, statistics);
+}
+
+void cleanupGpuProfiler(VkDevice device, GpuProfiler *profiler)
+{
+    cleanupQueryPools(device, profiler);
+    profiler->timestampPool = VK_NULL_HANDLE;
+    profiler->statisticsPool = VK_NULL_HANDLE;
+}
+
+void recordProfilerReset(GpuProfiler *profiler, VkCommandBuffer commandBuffer, uint32_t slot)
+{
+    if (profiler->timestampPool == VK_NULL_HANDLE)
+        return;
+
+    uint32_t firstQuery = slot * profiler->passCount();
+    vkCmdResetQueryPool(commandBuffer, profiler->timestampPool, firstQuery * 2, profiler->passCount() * 2);
+    if (profiler->statisticsPool != VK_NULL_HANDLE)
+        vkCmdResetQueryPool(commandBuffer, profiler->statisticsPool, firstQuery, profiler->passCount());
+}
+
+void recordPassBegin(GpuProfiler *profiler, VkCommandBuffer commandBuffer, uint32_t slot, uint32_t pass)
+{
+    if (profiler->timestampPool == VK_NULL_HANDLE)
+        return;
+
+    uint32_t query = slot * profiler->passCount() + pass;
+    profiler->slotPasses[slot] |= 1u << pass;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->timestampPool, query * 2);
+    if (profiler->statisticsPool != VK_NULL_HANDLE)
+        vkCmdBeginQuery(commandBuffer, profiler->statisticsPool, query, 0);
+}
+
+void recordPassEnd(GpuProfiler *profiler, VkCommandBuffer commandBuffer, uint32_t slot, uint32_t pass)
+{
+    if (profiler->timestampPool == VK_NULL_HANDLE)
+        return;
+
+    uint32_t query = slot * profiler->passCount() + pass;
+
+    if (profiler->statisticsPool != VK_NULL_HANDLE)
+        vkCmdEndQuery(commandBuffer, profiler->statisticsPool, query);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->timestampPool, query * 2 + 1);
+}
+
+void markProfilerSlotSubmitted(GpuProfiler *profiler, uint32_t slot)
+{
+    profiler->slotSubmitted[slot] = true;
+}
+
+void collectProfilerSlot(VkDevice device, GpuProfiler *profiler, uint32_t slot)
+{
+    if (profiler->timestampPool == VK_NULL_HANDLE || !profiler->slotSubmitted[slot])
+        return;
+    profiler->slotSubmitted[slot] = false;
+
+    for (uint32_t pass = 0; pass < profiler->passCount(); pass++){
+        profiler->slotMilliseconds[slot][pass] = 0;
+        if ((profiler->slotPasses[slot] & (1u << pass)) == 0)
+            continue;
+        uint32_t query = slot * profiler->passCount() + pass;
+
+        uint64_t timestamps[2];
+        VkResult result = vkGetQueryPoolResults(
+            device,
+            profiler->timestampPool,
+            query * 2, 2,
+            sizeof(timestamps), timestamps, sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT);
+        if (result == VK_NOT_READY)
+            continue;
+        handleVkResult(result, "reading timestamp queries");
+
+        uint64_t invocations = 0;
+        if (profiler->statisticsPool != VK_NULL_HANDLE){
+            result = vkGetQueryPoolResults(
+                device,
+                profiler->statisticsPool,
+                query, 1,
+                sizeof(invocations), &invocations, sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT);
+            if (result == VK_NOT_READY)
+                invocations = 0;
+            else
+                handleVkResult(result, "reading pipeline statistics queries");
+        }
+
+        uint64_t ticks = (timestamps[1] - timestamps[0]) & profiler->timestampMask;
+        uint32_t sample = profiler->nextSamples[pass];
+        profiler->milliseconds[pass][sample] = ticks * profiler->nanosecondsPerTick / 1e6;
+        profiler->slotMilliseconds[slot][pass] = profiler->milliseconds[pass][sample];
+        profiler->invocations[pass][sample] = invocations;
+        profiler->nextSamples[pass] = (sample + 1) % GPU_PROFILER_HISTORY_LENGTH;
+        profiler->sampleCounts[pass] = std::min(profiler->sampleCounts[pass] + 1, GPU_PROFILER_HISTORY_LENGTH);
+    }
+}
+
+GpuPassStats getGpuPassStats(GpuProfiler *profiler, uint32_t pass)
+{
+    GpuPassStats stats{};
+    stats.name = profiler->passNames[pass];
+    stats.sampleCount = profiler->sampleCounts[pass];
+    if (stats.sampleCount == 0)
+        return stats;
+
+    std::vector<double> milliseconds(
+        profiler->milliseconds[pass].begin(),
+        profiler->milliseconds[pass].begin() + stats.sampleCount);
+    std::sort(milliseconds.begin(), milliseconds.end());
+
+    double totalMilliseconds = 0;
+    double totalInvocations = 0;
+    for (uint32_t i = 0; i < stats.sampleCount; i++){
+        totalMilliseconds += milliseconds[i];
+        totalInvocations += profiler->invocations[pass][i];
+    }
+
+    stats.minMilliseconds = milliseconds.front();
+    stats.avgMilliseconds = totalMilliseconds / stats.sampleCount;
+    stats.p99Milliseconds = milliseconds[(stats.sampleCount - 1) * 99 / 100];
+    stats.avgInvocations = totalInvocations / stats.sampleCount;
+    return stats;
+}
+
+GpuProfilerOutput openGpuProfilerOutput(bool print, std::string csvFilename)
+{
+    GpuProfilerOutput output{};
+    output.print = print;
+    output.csvFile = nullptr;
+    if (csvFilename.empty())
+        return output;
+
+    if ((output.csvFile = fopen(csvFilename.c_str(), "w")) == NULL)
+        throw std::runtime_error("cant open profiler csv file " + csvFilename);
+    fprintf(output.csvFile, "time,pass,samples,min_ms,avg_ms,p99_ms,avg_invocations\n");
+    return output;
+}
+
+void reportGpuProfiler(GpuProfiler *profiler, GpuProfilerOutput *output, double time)
+{
+    if (!output->print && output->csvFile == nullptr)
+        return;
+
+    if (output->print)
+        printf("gpu passes (last %u frames):\n", GPU_PROFILER_HISTORY_LENGTH);
+
+    for (uint32_t pass = 0; pass < profiler->passCount(); pass++){
+        GpuPassStats stats = getGpuPassStats(profiler, pass);
+        if (stats.sampleCount == 0)
+            continue;
+
+        if (output->print)
+            printf(
+                "\t%-16s min %7.3f ms  avg %7.3f ms  p99 %7.3f ms  %10.0f invocations\n",
+                stats.name.c_str(),
+                stats.minMilliseconds, stats.avgMilliseconds, stats.p99Milliseconds,
+                stats.avgInvocations);
+        if (output->csvFile != nullptr)
+            fprintf(
+                output->csvFile, "%.3f,%s,%u,%.4f,%.4f,%.4f,%.0f\n",
+                time, stats.name.c_str(), stats.sampleCount,
+                stats.minMilliseconds, stats.avgMilliseconds, stats.p99Milliseconds,
+                stats.avgInvocations);
+    }
+
+    if (output->csvFile != nullptr)
+        fflush(output->csvFile);
+}
+
+void closeGpuProfilerOutput(GpuProfilerOutput *output)
+{
+    if (output->csvFile != nullptr)
+        fclose(output->csvFile);
+    output->csvFile = nullptr;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+const uint32_t GPU_PROFILER_HISTORY_LENGTH = 256;
+
+// Times passes recorded into command buffers with timestamp queries and counts
+// their compute shader invocations with pipeline statistics queries.
+//
+// Each command buffer that is recorded once and resubmitted owns a query slot.
+// Results of a slot are collected once its previous submission is known to have
+// finished, and kept in a rolling history of the last GPU_PROFILER_HISTORY_LENGTH
+// samples per pass.
+struct GpuProfiler
+{
+    // Null when the queue family does not support timestamps, profiling is then a no-op.
+    VkQueryPool timestampPool;
+    // Null when the pipelineStatisticsQuery feature is unsupported.
+    VkQueryPool statisticsPool;
+    double nanosecondsPerTick;
+    uint64_t timestampMask;
+
+    std::vector<std::string> passNames;
+    uint32_t slotCount;
+    // Bit per pass recorded into each slot.
+    std::vector<uint32_t> slotPasses;
+    std::vector<bool> slotSubmitted;
+    // Times of the passes of each slot's last collected submission, indexed
+    // [slot][pass]. Zero for passes it did not record.
+    std::vector<std::vector<double>> slotMilliseconds;
+
+    // Indexed [pass][sample].
+    std::vector<std::vector<double>> milliseconds;
+    std::vector<std::vector<uint64_t>> invocations;
+    std::vector<uint32_t> sampleCounts;
+    std::vector<uint32_t> nextSamples;
+
+    uint32_t passCount() { return passNames.size(); };
+};
+
+struct GpuPassStats
+{
+    std::string name;
+    uint32_t sampleCount;
+    double minMilliseconds;
+    double avgMilliseconds;
+    double p99Milliseconds;
+    double avgInvocations;
+};
+
+GpuProfiler createGpuProfiler(
+    VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    uint32_t queueFamily,
+    std::vector<std::string> passNames,
+    uint32_t slotCount);
+// Recreates the query slots, for when the command buffers are recorded again for a
+// different number of target images. The device must be idle. History is kept.
+void setGpuProfilerSlotCount(VkDevice device, GpuProfiler *profiler, uint32_t slotCount);
+void cleanupGpuProfiler(VkDevice device, GpuProfiler *profiler);
+
+// Must be recorded before any pass of slot in the command buffer.
+void recordProfilerReset(GpuProfiler *profiler, VkCommandBuffer commandBuffer, uint32_t slot);
+void recordPassBegin(GpuProfiler *profiler, VkCommandBuffer commandBuffer, uint32_t slot, uint32_t pass);
+void recordPassEnd(GpuProfiler *profiler, VkCommandBuffer commandBuffer, uint32_t slot, uint32_t pass);
+
+// Call when the command buffer of slot is submitted.
+void markProfilerSlotSubmitted(GpuProfiler *profiler, uint32_t slot);
+// Adds the results of the last submission of slot to the history. The submission
+// must have finished, e.g. its fence waited on.
+void collectProfilerSlot(VkDevice device, GpuProfiler *profiler, uint32_t slot);
+
+GpuPassStats getGpuPassStats(GpuProfiler *profiler, uint32_t pass);
+
+// Where periodic profiler reports go, csvFile is null when not writing csv.
+struct GpuProfilerOutput
+{
+    bool print;
+    FILE *csvFile;
+};
+
+GpuProfilerOutput openGpuProfilerOutput(bool print, std::string csvFilename);
+// Prints and/or appends one csv row per pass, time is seconds since startup.
+void reportGpuProfiler(GpuProfiler *profiler, GpuProfilerOutput *output, double time);
+void closeGpuProfilerOutput(GpuProfilerOutput *output);
@@ -131,7 +131,8 @@ Swapchain createSwapchain(
     VkDevice device,
     VkPhysicalDevice physicalDevice,
     GLFWwindow *window,
-    VkSurfaceKHR surface)
+    VkSurfaceKHR surface,
+    VkSwapchainKHR oldSwapchain)
 {
     Swapchain swapchain;
 
@@ -153,13 +154,17 @@ Swapchain createSwapchain(
     // Number of layers each image consists of. 1 because we render to a 2d screen.
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    // Cpu rendered frames are copied into the swapchain images.
+    createInfo.imageUsage |=
+        supportDetails.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     createInfo.preTransform = supportDetails.surfaceCapabilities.currentTransform;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = swapchain.presentMode;
     // If another window is obscuring part of this image, we can clip it.
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // Handing over the retired swapchain lets the driver reuse its resources.
+    createInfo.oldSwapchain = oldSwapchain;
 
     handleVkResult(
         vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapchain.swapchain),
@@ -25,5 +25,6 @@ Swapchain createSwapchain(
     VkDevice device,
     VkPhysicalDevice physicalDevice,
     GLFWwindow *window,
-    VkSurfaceKHR surface);
+    VkSurfaceKHR surface,
+    VkSwapchainKHR oldSwapchain);
 void cleanupSwapchain(VkDevice device, Swapchain swapchain);
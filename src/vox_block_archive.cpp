@@ -0,0 +1,167 @@
+#include "vox_block_archive.hpp"
+
+#include <string.h>
+#include <stdexcept>
+
+#include "vox_object.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Largest block side archived, a slice of columns fits on the stack.
+const uint32_t MAX_ARCHIVED_BLOCK_SCALE = 32;
+
+// Returns false as soon as the runs would use more than maxBytes.
+bool encodeVoxBlockRuns(const unsigned char *voxels, uint32_t blockScale, size_t maxBytes, std::vector<unsigned char> *bytes)
+{
+    for (uint32_t z = 0; z < blockScale; z++)
+    for (uint32_t x = 0; x < blockScale; x++){
+        uint32_t y = 0;
+        while (y < blockScale){
+            unsigned char material = voxels[voxBlockOffset(x, y, z, blockScale)];
+            uint32_t length = 1;
+            while (y + length < blockScale && voxels[voxBlockOffset(x, y + length, z, blockScale)] == material)
+                length++;
+            if (bytes->size() + 2 > maxBytes)
+                return false;
+            bytes->push_back(length);
+            bytes->push_back(material);
+            y += length;
+        }
+    }
+    return true;
+}
+
+#ifdef __SSE2__
+// Transposes a 16x16 tile of bytes. Interleaving the rows with their partners 8
+// rows on 4 times moves every byte to its transposed position.
+void transposeByteTile16(const unsigned char *src, size_t srcStride, unsigned char *dst, size_t dstStride)
+{
+    __m128i rows[16];
+    __m128i interleaved[16];
+    for (uint32_t i = 0; i < 16; i++)
+        rows[i] = _mm_loadu_si128((const __m128i *)(src + i * srcStride));
+    for (uint32_t round = 0; round < 4; round++){
+        for (uint32_t i = 0; i < 8; i++){
+            interleaved[i * 2] = _mm_unpacklo_epi8(rows[i], rows[i + 8]);
+            interleaved[i * 2 + 1] = _mm_unpackhi_epi8(rows[i], rows[i + 8]);
+        }
+        memcpy(rows, interleaved, sizeof(rows));
+    }
+    for (uint32_t i = 0; i < 16; i++)
+        _mm_storeu_si128((__m128i *)(dst + i * dstStride), rows[i]);
+}
+#endif
+
+// dst[y * side + x] = src[x * side + y], turning a slice of y columns into x rows.
+void transposeVoxelSlice(const unsigned char *src, uint32_t side, unsigned char *dst)
+{
+#ifdef __SSE2__
+    if (side % 16 == 0){
+        for (uint32_t tileX = 0; tileX < side; tileX += 16)
+        for (uint32_t tileY = 0; tileY < side; tileY += 16)
+            transposeByteTile16(src + tileX * side + tileY, side, dst + tileY * side + tileX, side);
+        return;
+    }
+#endif
+    for (uint32_t x = 0; x < side; x++)
+        for (uint32_t y = 0; y < side; y++)
+            dst[y * side + x] = src[x * side + y];
+}
+
+// Writes a run of up to MAX_ARCHIVED_BLOCK_SCALE voxels. The SSE2 version always
+// stores that many, runs are decoded in order so the spill is overwritten by the
+// runs after it.
+inline void fillVoxelRun(unsigned char *voxels, unsigned char material, uint32_t length)
+{
+#ifdef __SSE2__
+    (void)length;
+    __m128i fill = _mm_set1_epi8(material);
+    _mm_storeu_si128((__m128i *)voxels, fill);
+    _mm_storeu_si128((__m128i *)(voxels + 16), fill);
+#else
+    memset(voxels, material, length);
+#endif
+}
+
+void decodeVoxBlockRuns(const std::vector<unsigned char> &bytes, uint32_t blockScale, unsigned char *voxels)
+{
+    // A slice's columns are filled run by run, then transposed into the layout.
+    // Runs of the last column spill up to MAX_ARCHIVED_BLOCK_SCALE bytes past the slice.
+    unsigned char columns[MAX_ARCHIVED_BLOCK_SCALE * (MAX_ARCHIVED_BLOCK_SCALE + 1)];
+    unsigned char slice[MAX_ARCHIVED_BLOCK_SCALE * MAX_ARCHIVED_BLOCK_SCALE];
+    const unsigned char *run = bytes.data();
+    const unsigned char *end = run + bytes.size();
+    for (uint32_t z = 0; z < blockScale; z++){
+        for (uint32_t x = 0; x < blockScale; x++){
+            unsigned char *column = columns + x * blockScale;
+            uint32_t y = 0;
+            while (y < blockScale){
+                if (end - run < 2 || run[0] == 0 || run[0] > blockScale - y)
+                    throw std::runtime_error("archived vox block has malformed runs");
+                fillVoxelRun(column + y, run[1], run[0]);
+                y += run[0];
+                run += 2;
+            }
+        }
+
+        unsigned char *rows = VOX_BLOCK_MORTON ? slice : voxels + z * blockScale * blockScale;
+        transposeVoxelSlice(columns, blockScale, rows);
+        if (VOX_BLOCK_MORTON)
+            for (uint32_t y = 0; y < blockScale; y++)
+                for (uint32_t x = 0; x < blockScale; x++)
+                    voxels[voxBlockOffset(x, y, z, blockScale)] = slice[y * blockScale + x];
+    }
+    if (run != end)
+        throw std::runtime_error("archived vox block has malformed runs");
+}
+
+ArchivedVoxBlock archiveVoxBlock(const unsigned char *voxels, uint32_t blockScale)
+{
+    if (blockScale > MAX_ARCHIVED_BLOCK_SCALE)
+        throw std::runtime_error("vox block scale is too large to archive");
+
+    size_t pointCount = (size_t)blockScale * blockScale * blockScale;
+    ArchivedVoxBlock block{};
+    block.storage = VOX_BLOCK_STORAGE_RLE;
+    if (encodeVoxBlockRuns(voxels, blockScale, pointCount / 2, &block.bytes))
+        return block;
+
+    block.storage = VOX_BLOCK_STORAGE_DENSE;
+    block.bytes.resize(pointCount);
+    if (!VOX_BLOCK_MORTON){
+        memcpy(block.bytes.data(), voxels, pointCount);
+        return block;
+    }
+    for (uint32_t z = 0; z < blockScale; z++)
+        for (uint32_t y = 0; y < blockScale; y++)
+            for (uint32_t x = 0; x < blockScale; x++)
+                block.bytes[x + y * blockScale + z * blockScale * blockScale] =
+                    voxels[voxBlockOffset(x, y, z, blockScale)];
+    return block;
+}
+
+void unarchiveVoxBlock(const ArchivedVoxBlock *block, uint32_t blockScale, unsigned char *voxels)
+{
+    if (blockScale > MAX_ARCHIVED_BLOCK_SCALE)
+        throw std::runtime_error("vox block scale is too large to archive");
+
+    if (block->storage == VOX_BLOCK_STORAGE_RLE){
+        decodeVoxBlockRuns(block->bytes, blockScale, voxels);
+        return;
+    }
+
+    size_t pointCount = (size_t)blockScale * blockScale * blockScale;
+    if (block->bytes.size() != pointCount)
+        throw std::runtime_error("archived vox block has the wrong size");
+    if (!VOX_BLOCK_MORTON){
+        memcpy(voxels, block->bytes.data(), pointCount);
+        return;
+    }
+    for (uint32_t z = 0; z < blockScale; z++)
+        for (uint32_t y = 0; y < blockScale; y++)
+            for (uint32_t x = 0; x < blockScale; x++)
+                voxels[voxBlockOffset(x, y, z, blockScale)] =
+                    block->bytes[x + y * blockScale + z * blockScale * blockScale];
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// How a block is kept while it is not being uploaded or edited.
+enum VoxBlockStorage
+{
+    // Voxels x fastest then y then z, whatever the in memory layout.
+    VOX_BLOCK_STORAGE_DENSE,
+    // Each column along y is a list of (length, material) byte pairs. Columns
+    // go x fastest then z. Terrain columns are a few long runs of ground and air.
+    VOX_BLOCK_STORAGE_RLE
+};
+
+// A block in its compact host form, used for cold blocks and in scene files.
+struct ArchivedVoxBlock
+{
+    VoxBlockStorage storage;
+    std::vector<unsigned char> bytes;
+};
+
+// Run-length encodes voxels if that at least halves them, otherwise keeps them dense.
+ArchivedVoxBlock archiveVoxBlock(const unsigned char *voxels, uint32_t blockScale);
+// Writes the blockScale^3 voxels of block in the VoxBlock layout. Throws if the
+// runs do not fill the block, so corrupt files are caught on load.
+void unarchiveVoxBlock(const ArchivedVoxBlock *block, uint32_t blockScale, unsigned char *voxels);
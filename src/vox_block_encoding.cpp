@@ -0,0 +1,143 @@
+#include "vox_block_encoding.hpp"
+
+#include <string.h>
+#include <stdexcept>
+
+// Entries of the local palette at the front of a block, 0 for raw blocks.
+uint32_t voxBlockPaletteSize(uint32_t encoding)
+{
+    return encoding == VOX_BLOCK_ENCODING_RAW ? 0 : 1 << (1 << encoding);
+}
+
+uint32_t chooseVoxBlockEncoding(const unsigned char *voxels, uint32_t blockScale)
+{
+    bool used[256] = {};
+    uint32_t materialCount = 0;
+    for (uint32_t i = 0; i < blockScale * blockScale * blockScale; i++){
+        materialCount += !used[voxels[i]];
+        used[voxels[i]] = true;
+    }
+    uint32_t encoding = 0;
+    while (encoding < VOX_BLOCK_ENCODING_RAW && voxBlockPaletteSize(encoding) < materialCount)
+        encoding++;
+    return encoding;
+}
+
+uint32_t encodedVoxBlockWords(uint32_t blockScale, uint32_t encoding)
+{
+    uint32_t pointCount = blockScale * blockScale * blockScale;
+    return (voxBlockPaletteSize(encoding) + 3) / 4 + pointCount * (1 << encoding) / 32;
+}
+
+void encodeVoxBlock(const unsigned char *voxels, uint32_t blockScale, uint32_t encoding, uint32_t *words)
+{
+    uint32_t pointCount = blockScale * blockScale * blockScale;
+    if (encoding == VOX_BLOCK_ENCODING_RAW){
+        memcpy(words, voxels, pointCount);
+        return;
+    }
+
+    uint32_t paletteWords = (voxBlockPaletteSize(encoding) + 3) / 4;
+    memset(words, 0, encodedVoxBlockWords(blockScale, encoding) * sizeof(uint32_t));
+
+    // Materials get indices in the order they first appear.
+    uint32_t indices[256];
+    uint32_t paletteSize = 0;
+    for (uint32_t i = 0; i < 256; i++)
+        indices[i] = UINT32_MAX;
+    uint32_t bits = 1 << encoding;
+    for (uint32_t i = 0; i < pointCount; i++){
+        unsigned char material = voxels[i];
+        if (indices[material] == UINT32_MAX){
+            if (paletteSize == voxBlockPaletteSize(encoding))
+                throw std::runtime_error("vox block has more materials than its encoding holds");
+            indices[material] = paletteSize;
+            words[paletteSize / 4] |= (uint32_t)material << (paletteSize % 4 * 8);
+            paletteSize++;
+        }
+        uint32_t bit = i * bits;
+        words[paletteWords + bit / 32] |= indices[material] << (bit % 32);
+    }
+}
+
+VoxBlockHeap createVoxBlockHeap(uint32_t blockScale, uint32_t capacity)
+{
+    VoxBlockHeap heap{};
+    heap.blockScale = blockScale;
+    heap.capacity = capacity;
+    heap.top = 0;
+    heap.freeWords = 0;
+    return heap;
+}
+
+void addFreeRun(VoxBlockHeap *heap, uint32_t offset, uint32_t words)
+{
+    heap->freeRuns[offset] = words;
+    heap->freeRunsBySize.insert({words, offset});
+    heap->freeWords += words;
+}
+
+void removeFreeRun(VoxBlockHeap *heap, std::map<uint32_t, uint32_t>::iterator run)
+{
+    heap->freeWords -= run->second;
+    heap->freeRunsBySize.erase({run->second, run->first});
+    heap->freeRuns.erase(run);
+}
+
+VoxBlockSlot allocateVoxBlockSlot(VoxBlockHeap *heap, uint32_t encoding)
+{
+    uint32_t words = encodedVoxBlockWords(heap->blockScale, encoding);
+    auto fit = heap->freeRunsBySize.lower_bound({words, 0});
+    if (fit != heap->freeRunsBySize.end()){
+        uint32_t runWords = fit->first;
+        uint32_t offset = fit->second;
+        removeFreeRun(heap, heap->freeRuns.find(offset));
+        if (runWords > words)
+            addFreeRun(heap, offset + words, runWords - words);
+        return packVoxBlockSlot(offset, encoding);
+    }
+
+    if (words > heap->capacity - heap->top)
+        throw std::runtime_error("vox block heap is full");
+    uint32_t offset = heap->top;
+    heap->top += words;
+    return packVoxBlockSlot(offset, encoding);
+}
+
+bool voxBlockHeapHasRoom(const VoxBlockHeap *heap, uint32_t encoding)
+{
+    uint32_t words = encodedVoxBlockWords(heap->blockScale, encoding);
+    return heap->freeRunsBySize.lower_bound({words, 0}) != heap->freeRunsBySize.end() ||
+        words <= heap->capacity - heap->top;
+}
+
+uint32_t voxBlockHeapFreeWords(const VoxBlockHeap *heap)
+{
+    return heap->capacity - heap->top + heap->freeWords;
+}
+
+void freeVoxBlockSlot(VoxBlockHeap *heap, VoxBlockSlot slot)
+{
+    uint32_t offset = voxBlockSlotOffset(slot);
+    uint32_t words = encodedVoxBlockWords(heap->blockScale, voxBlockSlotEncoding(slot));
+
+    auto next = heap->freeRuns.lower_bound(offset);
+    if (next != heap->freeRuns.end() && next->first == offset + words){
+        words += next->second;
+        removeFreeRun(heap, next);
+    }
+    auto previous = heap->freeRuns.lower_bound(offset);
+    if (previous != heap->freeRuns.begin()){
+        previous--;
+        if (previous->first + previous->second == offset){
+            offset = previous->first;
+            words += previous->second;
+            removeFreeRun(heap, previous);
+        }
+    }
+
+    if (offset + words == heap->top)
+        heap->top = offset;
+    else
+        addFreeRun(heap, offset, words);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+// On the gpu a block is a local palette of the materials it uses followed by an
+// index per voxel of 1, 2, 4 or 8 bits, the fewest that fit. Indices are packed
+// into words in voxBlockOffset order from the low bits up. 8 bit blocks store
+// their voxels directly and have no palette.
+//
+// An encoding is log2 of the index bits, 0 to 3.
+const uint32_t VOX_BLOCK_ENCODING_COUNT = 4;
+const uint32_t VOX_BLOCK_ENCODING_RAW = 3;
+
+// Where a block lives in the voxBlocks buffer: its word offset above the low 2
+// bits, which hold its encoding. Also the form shader.comp reads them in.
+typedef uint32_t VoxBlockSlot;
+const VoxBlockSlot VOX_BLOCK_SLOT_NONE = UINT32_MAX;
+
+inline VoxBlockSlot packVoxBlockSlot(uint32_t offset, uint32_t encoding){
+    return offset << 2 | encoding;
+}
+inline uint32_t voxBlockSlotOffset(VoxBlockSlot slot){
+    return slot >> 2;
+}
+inline uint32_t voxBlockSlotEncoding(VoxBlockSlot slot){
+    return slot & 3;
+}
+
+// The smallest encoding that holds every material in a block's voxels.
+uint32_t chooseVoxBlockEncoding(const unsigned char *voxels, uint32_t blockScale);
+uint32_t encodedVoxBlockWords(uint32_t blockScale, uint32_t encoding);
+// Writes encodedVoxBlockWords words to words.
+void encodeVoxBlock(const unsigned char *voxels, uint32_t blockScale, uint32_t encoding, uint32_t *words);
+
+// Hands out slots of the voxBlocks buffer. New slots come from the top of the
+// buffer. Freed slots are merged with the free runs next to them, or given back
+// to the top when they reach it, and a slot of any encoding is split off the
+// smallest free run it fits in.
+struct VoxBlockHeap
+{
+    uint32_t blockScale;
+    // Words in the buffer.
+    uint32_t capacity;
+    uint32_t top;
+    // Words below top in free runs.
+    uint32_t freeWords;
+    // The free runs by offset, with their words, and by words then offset.
+    std::map<uint32_t, uint32_t> freeRuns;
+    std::set<std::pair<uint32_t, uint32_t>> freeRunsBySize;
+};
+
+VoxBlockHeap createVoxBlockHeap(uint32_t blockScale, uint32_t capacity);
+// Throws if the buffer has no room for a block of encoding.
+VoxBlockSlot allocateVoxBlockSlot(VoxBlockHeap *heap, uint32_t encoding);
+// Whether allocateVoxBlockSlot would find a slot for encoding.
+bool voxBlockHeapHasRoom(const VoxBlockHeap *heap, uint32_t encoding);
+// Words not in a slot, whether or not they are together.
+uint32_t voxBlockHeapFreeWords(const VoxBlockHeap *heap);
+void freeVoxBlockSlot(VoxBlockHeap *heap, VoxBlockSlot slot);
@@ -0,0 +1,69 @@
+#include "vox_edit.hpp"
+
+#include <algorithm>
+
+#include "vox_light.hpp"
+#include "cpu/ray_query.hpp"
+
+template<uint32_t N>
+std::vector<uint32_t> carveVoxSphere(VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, glm::ivec3 center, int32_t radius)
+{
+    std::vector<uint32_t> edited;
+    for (int32_t z = -radius; z <= radius; z++)
+        for (int32_t y = -radius; y <= radius; y++)
+            for (int32_t x = -radius; x <= radius; x++){
+                if (x * x + y * y + z * z > radius * radius)
+                    continue;
+                // Negative coordinates wrap around to outside the object, where getVoxel is 0.
+                uint32_t voxelX = center.x + x;
+                uint32_t voxelY = center.y + y;
+                uint32_t voxelZ = center.z + z;
+                // setVoxel would allocate a block for a voxel that is already empty.
+                if (getVoxel(object, voxBlocks, voxelX, voxelY, voxelZ) == 0)
+                    continue;
+                edited.push_back(setVoxel(object, voxBlocks, voxelX, voxelY, voxelZ, 0));
+            }
+    std::sort(edited.begin(), edited.end());
+    edited.erase(std::unique(edited.begin(), edited.end()), edited.end());
+    return edited;
+}
+
+template<uint32_t N>
+bool digVoxHole(VoxEditor<N> *editor, Renderer *renderer, glm::vec3 origin, glm::vec3 direction)
+{
+    CpuScene scene = createCpuScene(*editor->object, voxBlockBytes(editor->voxBlocks), editor->palettes);
+    RayHit hit = raycastQuery(&scene, RayQuery{origin, direction, VOX_EDIT_REACH});
+    if (!hit.hit)
+        return false;
+
+    std::vector<uint32_t> edited = carveVoxSphere(editor->object, editor->voxBlocks, hit.position, VOX_DIG_RADIUS);
+    if (edited.empty())
+        return true;
+
+    // Frames in flight read the slots and light being replaced.
+    vkQueueWaitIdle(renderer->computeAndPresentQueue);
+    std::vector<const unsigned char *> voxels;
+    for (uint32_t block : edited)
+        voxels.push_back(editor->voxBlocks->getBlock(block)->voxels);
+    updateBlocks(renderer, edited.size(), edited.data(), voxels.data());
+
+    if (editor->light != nullptr){
+        glm::uvec3 minVoxel = glm::uvec3(glm::max(hit.position - VOX_DIG_RADIUS, glm::ivec3(0)));
+        glm::uvec3 maxVoxel = glm::uvec3(hit.position + VOX_DIG_RADIUS);
+        std::vector<uint32_t> relit = rebakeVoxLight(
+            editor->object, editor->voxBlocks, editor->pool, minVoxel, maxVoxel, editor->light);
+        std::vector<const unsigned char *> blockLight;
+        for (uint32_t block : relit)
+            blockLight.push_back(editor->light + block * voxBlockLightSize(N));
+        updateBlockLight(renderer, relit.size(), relit.data(), blockLight.data());
+    }
+    return true;
+}
+
+template std::vector<uint32_t> carveVoxSphere<8>(VoxObject *, MemPool<VoxBlock<8>> *, glm::ivec3, int32_t);
+template std::vector<uint32_t> carveVoxSphere<16>(VoxObject *, MemPool<VoxBlock<16>> *, glm::ivec3, int32_t);
+template std::vector<uint32_t> carveVoxSphere<32>(VoxObject *, MemPool<VoxBlock<32>> *, glm::ivec3, int32_t);
+
+template bool digVoxHole<8>(VoxEditor<8> *, Renderer *, glm::vec3, glm::vec3);
+template bool digVoxHole<16>(VoxEditor<16> *, Renderer *, glm::vec3, glm::vec3);
+template bool digVoxHole<32>(VoxEditor<32> *, Renderer *, glm::vec3, glm::vec3);
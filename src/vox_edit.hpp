@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vox_object.hpp"
+#include "renderer.hpp"
+#include "cpu/worker_pool.hpp"
+
+// Voxels from the camera within which a dig finds the surface it digs into.
+const float VOX_EDIT_REACH = 256.0f;
+const int32_t VOX_DIG_RADIUS = 4;
+
+// What editing a resident object touches.
+template<uint32_t N>
+struct VoxEditor
+{
+    VoxObject *object;
+    MemPool<VoxBlock<N>> *voxBlocks;
+    MemPool<Palette> *palettes;
+    // Bakes the light again, only used with light.
+    WorkerPool *pool;
+    // Baked light indexed like voxBlocks, null without baked light.
+    unsigned char *light;
+};
+
+// Empties the voxels within radius of center and returns the pool indices of the
+// blocks that changed. Blocks are never allocated, so the grid stays the same.
+template<uint32_t N>
+std::vector<uint32_t> carveVoxSphere(VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, glm::ivec3 center, int32_t radius);
+
+// Digs a VOX_DIG_RADIUS hole where the ray from origin along direction first
+// hits, uploads the changed blocks and, with light, bakes again and uploads the
+// light around them. Waits for the frames in flight. Returns false on a miss.
+template<uint32_t N>
+bool digVoxHole(VoxEditor<N> *editor, Renderer *renderer, glm::vec3 origin, glm::vec3 direction);
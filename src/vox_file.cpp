@@ -0,0 +1,159 @@
+#include "vox_file.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+
+#include "vox_block_archive.hpp"
+
+const char VOX_FILE_MAGIC[4] = {'V', 'X', 'S', 'C'};
+const uint32_t VOX_FILE_VERSION = 1;
+
+struct VoxFileHeader
+{
+    uint32_t blockScale;
+    uint32_t blockWidth;
+    uint32_t blockHeight;
+    uint32_t blockDepth;
+    uint32_t blockCount;
+};
+
+// Leaves file positioned after the header, closes it and throws if it is not a scene file.
+VoxFileHeader readVoxFileHeader(FILE *file, std::string filename)
+{
+    char magic[4];
+    uint32_t version;
+    VoxFileHeader header;
+    if (fread(magic, sizeof(magic), 1, file) != 1 ||
+        fread(&version, sizeof(version), 1, file) != 1 ||
+        memcmp(magic, VOX_FILE_MAGIC, sizeof(magic)) != 0){
+        fclose(file);
+        throw std::runtime_error(filename + " is not a scene file");
+    }
+    if (version != VOX_FILE_VERSION){
+        fclose(file);
+        throw std::runtime_error("scene file " + filename + " has unsupported version " + std::to_string(version));
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1){
+        fclose(file);
+        throw std::runtime_error("scene file " + filename + " is truncated");
+    }
+    return header;
+}
+
+VoxFileInfo readVoxFileInfo(std::string filename)
+{
+    FILE *file;
+    if ((file = fopen(filename.c_str(), "rb")) == NULL)
+        throw std::runtime_error("cant open scene file " + filename);
+    VoxFileHeader header = readVoxFileHeader(file, filename);
+    fclose(file);
+    return VoxFileInfo{header.blockScale, header.blockCount};
+}
+
+template<uint32_t N>
+void saveVoxFile(std::string filename, VoxObject object, MemPool<VoxBlock<N>> *voxBlocks, MemPool<Palette> *palettes)
+{
+    FILE *file;
+    if ((file = fopen(filename.c_str(), "wb")) == NULL)
+        throw std::runtime_error("cant open scene file " + filename);
+
+    uint32_t gridSize = object.blockWidth * object.blockHeight * object.blockDepth;
+    VoxFileHeader header{N, object.blockWidth, object.blockHeight, object.blockDepth, 0};
+    for (uint32_t i = 0; i < gridSize; i++)
+        header.blockCount = std::max(header.blockCount, object.blockIndices[i]);
+
+    fwrite(VOX_FILE_MAGIC, sizeof(VOX_FILE_MAGIC), 1, file);
+    fwrite(&VOX_FILE_VERSION, sizeof(VOX_FILE_VERSION), 1, file);
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(palettes->getBlock(object.paletteIndex), sizeof(Palette), 1, file);
+    fwrite(object.blockIndices, sizeof(uint32_t), gridSize, file);
+
+    uint32_t runBlocks = 0;
+    size_t archivedBytes = 0;
+    for (uint32_t i = 0; i < header.blockCount; i++){
+        ArchivedVoxBlock block = archiveVoxBlock(voxBlocks->getBlock(i)->voxels, N);
+        uint8_t storage = block.storage;
+        uint32_t size = block.bytes.size();
+        fwrite(&storage, sizeof(storage), 1, file);
+        fwrite(&size, sizeof(size), 1, file);
+        fwrite(block.bytes.data(), 1, size, file);
+        runBlocks += block.storage == VOX_BLOCK_STORAGE_RLE;
+        archivedBytes += size;
+    }
+    bool failed = ferror(file);
+    fclose(file);
+    if (failed)
+        throw std::runtime_error("cant write scene file " + filename);
+
+    printf(
+        "saved %u blocks to %s, %u run-length encoded, %.1f%% of their dense size\n",
+        header.blockCount, filename.c_str(), runBlocks,
+        header.blockCount == 0 ? 0.0 : 100.0 * archivedBytes / ((double)header.blockCount * sizeof(VoxBlock<N>)));
+}
+
+template<uint32_t N>
+void loadVoxFile(std::string filename, MemPool<VoxBlock<N>> *voxBlocks, MemPool<Palette> *palettes, VoxObject *voxObject)
+{
+    FILE *file;
+    if ((file = fopen(filename.c_str(), "rb")) == NULL)
+        throw std::runtime_error("cant open scene file " + filename);
+    VoxFileHeader header = readVoxFileHeader(file, filename);
+    if (header.blockScale != N){
+        fclose(file);
+        throw std::runtime_error(
+            "scene file " + filename + " has block scale " + std::to_string(header.blockScale) +
+            " but " + std::to_string(N) + " was asked for");
+    }
+
+    uint32_t gridSize = header.blockWidth * header.blockHeight * header.blockDepth;
+    voxObject->paletteIndex = palettes->allocateBlock();
+    voxObject->blockScale = N;
+    voxObject->blockWidth = header.blockWidth;
+    voxObject->blockHeight = header.blockHeight;
+    voxObject->blockDepth = header.blockDepth;
+    voxObject->blockIndices = (uint32_t *)calloc(gridSize, sizeof(uint32_t));
+
+    bool truncated =
+        fread(palettes->getBlock(voxObject->paletteIndex), sizeof(Palette), 1, file) != 1 ||
+        fread(voxObject->blockIndices, sizeof(uint32_t), gridSize, file) != gridSize;
+    for (uint32_t i = 0; i < gridSize && !truncated; i++)
+        truncated = voxObject->blockIndices[i] > header.blockCount;
+
+    // Blocks are read whole before any is decoded, so the file is closed by the time
+    // a malformed one throws.
+    std::vector<ArchivedVoxBlock> blocks(truncated ? 0 : header.blockCount);
+    for (uint32_t i = 0; i < blocks.size() && !truncated; i++){
+        uint8_t storage;
+        uint32_t size;
+        truncated =
+            fread(&storage, sizeof(storage), 1, file) != 1 || fread(&size, sizeof(size), 1, file) != 1 ||
+            storage > VOX_BLOCK_STORAGE_RLE || size > sizeof(VoxBlock<N>);
+        if (truncated)
+            break;
+        blocks[i].storage = (VoxBlockStorage)storage;
+        blocks[i].bytes.resize(size);
+        truncated = fread(blocks[i].bytes.data(), 1, size, file) != size;
+    }
+    fclose(file);
+    if (truncated)
+        throw std::runtime_error("scene file " + filename + " is truncated or corrupt");
+
+    // Blocks are allocated in file order, so grid entries keep pointing at the same blocks.
+    for (uint32_t i = 0; i < blocks.size(); i++){
+        if (voxBlocks->allocateBlock() != i)
+            throw std::runtime_error("scene file " + filename + " must be loaded into an empty pool");
+        unarchiveVoxBlock(&blocks[i], N, voxBlocks->getBlock(i)->voxels);
+    }
+}
+
+template void saveVoxFile<8>(std::string, VoxObject, MemPool<VoxBlock<8>> *, MemPool<Palette> *);
+template void saveVoxFile<16>(std::string, VoxObject, MemPool<VoxBlock<16>> *, MemPool<Palette> *);
+template void saveVoxFile<32>(std::string, VoxObject, MemPool<VoxBlock<32>> *, MemPool<Palette> *);
+
+template void loadVoxFile<8>(std::string, MemPool<VoxBlock<8>> *, MemPool<Palette> *, VoxObject *);
+template void loadVoxFile<16>(std::string, MemPool<VoxBlock<16>> *, MemPool<Palette> *, VoxObject *);
+template void loadVoxFile<32>(std::string, MemPool<VoxBlock<32>> *, MemPool<Palette> *, VoxObject *);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "vox_object.hpp"
+
+// The native scene file: a header, the object's palette and block grid, then
+// every pool block it uses as an ArchivedVoxBlock, in pool order. Written in the
+// machine's byte order.
+struct VoxFileInfo
+{
+    uint32_t blockScale;
+    // Pool blocks the file holds, the capacity loadVoxFile needs.
+    uint32_t blockCount;
+};
+
+VoxFileInfo readVoxFileInfo(std::string filename);
+
+template<uint32_t N>
+void saveVoxFile(std::string filename, VoxObject object, MemPool<VoxBlock<N>> *voxBlocks, MemPool<Palette> *palettes);
+// Throws if the file's block scale is not N.
+template<uint32_t N>
+void loadVoxFile(std::string filename, MemPool<VoxBlock<N>> *voxBlocks, MemPool<Palette> *palettes, VoxObject *voxObject);
@@ -0,0 +1,177 @@
+#include "vox_light.hpp"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+// Voxels a sky ray travels before it counts as reaching the sky.
+const uint32_t SKY_DISTANCE = 24;
+// Straight up, then 8 directions around it 45 degrees above the horizon.
+const uint32_t SKY_DIRECTION_COUNT = 9;
+// Light of a cell that sees no sky, so caves and overhangs are dim but not black.
+const float SKY_AMBIENT_FLOOR = 0.3f;
+// Solid neighbours of an empty cell in front of a flat surface: the 9 behind it.
+const uint32_t FLAT_SURFACE_NEIGHBOURS = 9;
+// Further solid neighbours that take a cell's occlusion to its darkest.
+const float FULL_OCCLUSION_NEIGHBOURS = 12.0f;
+const float DARKEST_OCCLUSION = 0.2f;
+// Voxels away from an edit whose light it can change: a sky ray's length and the
+// face averaging one voxel further.
+const uint32_t LIGHT_REACH = SKY_DISTANCE + 2;
+
+size_t voxBlockLightSize(uint32_t blockScale)
+{
+    return (size_t)blockScale * blockScale * blockScale / 2;
+}
+
+template<uint32_t N>
+bool isSolidVoxel(const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, int32_t x, int32_t y, int32_t z)
+{
+    // Negative coordinates wrap around to outside the object, which is empty.
+    return getVoxel(object, voxBlocks, (uint32_t)x, (uint32_t)y, (uint32_t)z) != 0;
+}
+
+// Fraction of sky directions in which the empty cell at x, y, z sees the sky.
+template<uint32_t N>
+float cellSkyVisibility(const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, int32_t x, int32_t y, int32_t z)
+{
+    static const float DIAGONAL = 0.70710678f;
+    uint32_t open = 0;
+    for (uint32_t direction = 0; direction < SKY_DIRECTION_COUNT; direction++){
+        glm::vec3 step(0, 1, 0);
+        if (direction != 0){
+            float angle = (direction - 1) * 0.78539816f;
+            step = glm::vec3(cosf(angle) * DIAGONAL, DIAGONAL, sinf(angle) * DIAGONAL);
+        }
+        glm::vec3 position = glm::vec3(x, y, z) + 0.5f;
+        bool blocked = false;
+        for (uint32_t t = 1; t <= SKY_DISTANCE && !blocked; t++){
+            glm::vec3 sample = glm::floor(position + step * (float)t);
+            blocked = isSolidVoxel(object, voxBlocks, sample.x, sample.y, sample.z);
+        }
+        open += !blocked;
+    }
+    return (float)open / SKY_DIRECTION_COUNT;
+}
+
+// Light level of the empty cell at x, y, z.
+template<uint32_t N>
+uint32_t cellLight(const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, int32_t x, int32_t y, int32_t z)
+{
+    uint32_t neighbours = 0;
+    for (int32_t dz = -1; dz <= 1; dz++)
+        for (int32_t dy = -1; dy <= 1; dy++)
+            for (int32_t dx = -1; dx <= 1; dx++)
+                neighbours += isSolidVoxel(object, voxBlocks, x + dx, y + dy, z + dz);
+    float occlusion = 1.0f - (std::max(neighbours, FLAT_SURFACE_NEIGHBOURS) - FLAT_SURFACE_NEIGHBOURS) / FULL_OCCLUSION_NEIGHBOURS;
+    occlusion = std::max(occlusion, DARKEST_OCCLUSION);
+    float sky = cellSkyVisibility(object, voxBlocks, x, y, z);
+    float light = occlusion * (SKY_AMBIENT_FLOOR + (1.0f - SKY_AMBIENT_FLOOR) * sky);
+    return std::min<uint32_t>(VOX_LIGHT_LEVELS - 1, lroundf(light * (VOX_LIGHT_LEVELS - 1)));
+}
+
+const int32_t FACE_NORMALS[6][3] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+// Bakes the block at blockX, blockY, blockZ of the grid into blockLight.
+template<uint32_t N>
+void bakeVoxBlockLight(
+    const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks,
+    uint32_t blockX, uint32_t blockY, uint32_t blockZ, unsigned char *blockLight)
+{
+    memset(blockLight, 0, voxBlockLightSize(N));
+    for (uint32_t z = 0; z < N; z++)
+        for (uint32_t y = 0; y < N; y++)
+            for (uint32_t x = 0; x < N; x++){
+                int32_t worldX = blockX * N + x;
+                int32_t worldY = blockY * N + y;
+                int32_t worldZ = blockZ * N + z;
+                bool solid = isSolidVoxel(object, voxBlocks, worldX, worldY, worldZ);
+
+                // Cells no ray ever reads the light of stay fully lit.
+                uint32_t light = VOX_LIGHT_LEVELS - 1;
+                uint32_t lightSum = 0;
+                uint32_t openFaces = 0;
+                bool openOutsideBlock = false;
+                bool nextToSolid = false;
+                for (uint32_t face = 0; face < 6; face++){
+                    int32_t neighbourX = worldX + FACE_NORMALS[face][0];
+                    int32_t neighbourY = worldY + FACE_NORMALS[face][1];
+                    int32_t neighbourZ = worldZ + FACE_NORMALS[face][2];
+                    bool neighbourSolid = isSolidVoxel(object, voxBlocks, neighbourX, neighbourY, neighbourZ);
+                    nextToSolid = nextToSolid || neighbourSolid;
+                    if (!solid || neighbourSolid)
+                        continue;
+                    openOutsideBlock = openOutsideBlock ||
+                        (uint32_t)neighbourX / N != blockX || (uint32_t)neighbourY / N != blockY || (uint32_t)neighbourZ / N != blockZ;
+                    lightSum += cellLight(object, voxBlocks, neighbourX, neighbourY, neighbourZ);
+                    openFaces++;
+                }
+                if (!solid && nextToSolid)
+                    light = cellLight(object, voxBlocks, worldX, worldY, worldZ);
+                else if (solid && openOutsideBlock)
+                    light = (lightSum + openFaces / 2) / openFaces;
+
+                size_t offset = VoxBlock<N>::index(x, y, z);
+                blockLight[offset / 2] |= light << (offset % 2 * 4);
+            }
+}
+
+// Bakes the grid blocks from minBlock to maxBlock that hold voxels and returns their pool indices.
+template<uint32_t N>
+std::vector<uint32_t> bakeVoxLightBlocks(
+    const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, WorkerPool *pool,
+    glm::uvec3 minBlock, glm::uvec3 maxBlock, unsigned char *light)
+{
+    std::vector<glm::uvec3> gridBlocks;
+    std::vector<uint32_t> poolIndices;
+    for (uint32_t z = minBlock.z; z <= maxBlock.z; z++)
+        for (uint32_t y = minBlock.y; y <= maxBlock.y; y++)
+            for (uint32_t x = minBlock.x; x <= maxBlock.x; x++){
+                uint32_t block = object->blockIndices[x + y * object->blockWidth + z * object->blockWidth * object->blockHeight];
+                if (block == 0)
+                    continue;
+                gridBlocks.push_back(glm::uvec3(x, y, z));
+                poolIndices.push_back(block - 1);
+            }
+
+    parallelFor(pool, gridBlocks.size(), [&](uint32_t task, uint32_t){
+        bakeVoxBlockLight<N>(
+            object, voxBlocks, gridBlocks[task].x, gridBlocks[task].y, gridBlocks[task].z,
+            light + poolIndices[task] * voxBlockLightSize(N));
+    });
+    return poolIndices;
+}
+
+template<uint32_t N>
+void bakeVoxLight(const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, WorkerPool *pool, unsigned char *light)
+{
+    if (object->blockWidth == 0 || object->blockHeight == 0 || object->blockDepth == 0)
+        return;
+    bakeVoxLightBlocks(
+        object, voxBlocks, pool, glm::uvec3(0),
+        glm::uvec3(object->blockWidth - 1, object->blockHeight - 1, object->blockDepth - 1), light);
+}
+
+template<uint32_t N>
+std::vector<uint32_t> rebakeVoxLight(
+    const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, WorkerPool *pool,
+    glm::uvec3 minVoxel, glm::uvec3 maxVoxel, unsigned char *light)
+{
+    glm::uvec3 lastBlock(object->blockWidth - 1, object->blockHeight - 1, object->blockDepth - 1);
+    glm::uvec3 minBlock = (glm::max(minVoxel, glm::uvec3(LIGHT_REACH)) - LIGHT_REACH) / N;
+    glm::uvec3 maxBlock = glm::min((maxVoxel + LIGHT_REACH) / N, lastBlock);
+    if (minBlock.x > maxBlock.x || minBlock.y > maxBlock.y || minBlock.z > maxBlock.z)
+        return std::vector<uint32_t>();
+    return bakeVoxLightBlocks(object, voxBlocks, pool, minBlock, maxBlock, light);
+}
+
+template void bakeVoxLight<8>(const VoxObject *, MemPool<VoxBlock<8>> *, WorkerPool *, unsigned char *);
+template void bakeVoxLight<16>(const VoxObject *, MemPool<VoxBlock<16>> *, WorkerPool *, unsigned char *);
+template void bakeVoxLight<32>(const VoxObject *, MemPool<VoxBlock<32>> *, WorkerPool *, unsigned char *);
+
+template std::vector<uint32_t> rebakeVoxLight<8>(
+    const VoxObject *, MemPool<VoxBlock<8>> *, WorkerPool *, glm::uvec3, glm::uvec3, unsigned char *);
+template std::vector<uint32_t> rebakeVoxLight<16>(
+    const VoxObject *, MemPool<VoxBlock<16>> *, WorkerPool *, glm::uvec3, glm::uvec3, unsigned char *);
+template std::vector<uint32_t> rebakeVoxLight<32>(
+    const VoxObject *, MemPool<VoxBlock<32>> *, WorkerPool *, glm::uvec3, glm::uvec3, unsigned char *);
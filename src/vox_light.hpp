@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vox_object.hpp"
+#include "cpu/worker_pool.hpp"
+
+// Ambient light baked on the cpu, so shader.comp shades hits with a lookup
+// instead of tracing shadow or occlusion rays. Every cell of a block gets 4 bits,
+// two cells per byte with the even offset in the low bits, in voxBlockOffset
+// order. An empty cell next to a voxel holds the light of the voxel face it is
+// in front of: how much of the sky it sees, darkened by the voxels around it. A
+// ray hitting a voxel reads the light of the cell it came from, so each face is
+// lit on its own. Voxels on the faces of a block hold the average of their open
+// faces, for rays that come from a block that is empty.
+const uint32_t VOX_LIGHT_LEVELS = 16;
+
+// Bytes of baked light per block.
+size_t voxBlockLightSize(uint32_t blockScale);
+
+// Bakes every block of object in parallel on pool. light holds voxBlockLightSize
+// bytes per pool block, indexed like voxBlocks.
+template<uint32_t N>
+void bakeVoxLight(const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, WorkerPool *pool, unsigned char *light);
+// Bakes again the blocks whose light voxels minVoxel to maxVoxel can reach, after
+// they were edited. Returns their pool indices, for updateBlockLight.
+template<uint32_t N>
+std::vector<uint32_t> rebakeVoxLight(
+    const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, WorkerPool *pool,
+    glm::uvec3 minVoxel, glm::uvec3 maxVoxel, unsigned char *light);
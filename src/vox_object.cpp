@@ -1,13 +1,70 @@
 #include "vox_object.hpp"
 
 #include <stdio.h>
+#include <string.h>
 #include <limits.h>
 #include <iostream>
 
 char END_HEADER[] = "end_header\n";
 
-size_t voxBlockIndex(unsigned int x, unsigned int y, unsigned int z){
-    return x + y * VOX_BLOCK_SCALE + z * VOX_BLOCK_SCALE * VOX_BLOCK_SCALE;
+bool isSupportedVoxBlockScale(uint32_t blockScale)
+{
+    return blockScale == 8 || blockScale == 16 || blockScale == 32;
+}
+
+uint32_t voxBlockMipCount(uint32_t blockScale)
+{
+    uint32_t count = 0;
+    while ((blockScale >> count) > 1)
+        count++;
+    return count;
+}
+
+uint32_t voxBlockMipSize(uint32_t blockScale, uint32_t mipCount)
+{
+    uint32_t size = 0;
+    for (uint32_t level = 1; level <= mipCount; level++){
+        uint32_t side = blockScale >> level;
+        size += side * side * side;
+    }
+    return (size + 3) / 4 * 4;
+}
+
+void buildVoxBlockMips(const unsigned char *voxels, uint32_t blockScale, uint32_t mipCount, unsigned char *mips)
+{
+    const unsigned char *finer = voxels;
+    unsigned char *coarser = mips;
+    for (uint32_t level = 1; level <= mipCount; level++){
+        uint32_t finerSide = blockScale >> (level - 1);
+        uint32_t side = blockScale >> level;
+        for (uint32_t z = 0; z < side; z++)
+        for (uint32_t y = 0; y < side; y++)
+        for (uint32_t x = 0; x < side; x++){
+            unsigned char children[8];
+            for (uint32_t i = 0; i < 8; i++)
+                children[i] = finer[voxBlockOffset(
+                    x * 2 + (i & 1), y * 2 + ((i >> 1) & 1), z * 2 + (i >> 2), finerSide)];
+
+            // The first material to reach the highest count wins, so ties are deterministic.
+            unsigned char majority = 0;
+            uint32_t majorityCount = 0;
+            for (uint32_t i = 0; i < 8; i++){
+                if (children[i] == 0)
+                    continue;
+                uint32_t count = 0;
+                for (uint32_t j = 0; j < 8; j++)
+                    count += children[j] == children[i];
+                if (count > majorityCount){
+                    majority = children[i];
+                    majorityCount = count;
+                }
+            }
+            coarser[voxBlockOffset(x, y, z, side)] = majority;
+        }
+        finer = coarser;
+        coarser += side * side * side;
+    }
+    memset(coarser, 0, mips + voxBlockMipSize(blockScale, mipCount) - coarser);
 }
 
 long int skipPlyHeader(FILE* file){
@@ -23,10 +80,11 @@ long int skipPlyHeader(FILE* file){
     return ftell(file);
 }
 
+template<uint32_t N>
 void loadPlyVoxObject (
     char *filename,
-    MemPool<VoxBlock> voxBlocks,
-    MemPool<Palette> palettes,
+    MemPool<VoxBlock<N>> *voxBlocks,
+    MemPool<Palette> *palettes,
     VoxObject *voxObject)
 {
     FILE *file;
@@ -61,15 +119,16 @@ void loadPlyVoxObject (
     unsigned int modelHeight = maxY - minY + 1;
     unsigned int modelDepth = maxZ - minZ + 1;
 
-    voxObject->paletteIndex = palettes.allocateBlock();
-    voxObject->blockWidth =  (modelWidth + VOX_BLOCK_SCALE - 1) / VOX_BLOCK_SCALE;
-    voxObject->blockHeight = (modelHeight + VOX_BLOCK_SCALE - 1) / VOX_BLOCK_SCALE;
-    voxObject->blockDepth =  (modelDepth + VOX_BLOCK_SCALE - 1) / VOX_BLOCK_SCALE;
+    voxObject->paletteIndex = palettes->allocateBlock();
+    voxObject->blockScale = N;
+    voxObject->blockWidth =  (modelWidth + N - 1) / N;
+    voxObject->blockHeight = (modelHeight + N - 1) / N;
+    voxObject->blockDepth =  (modelDepth + N - 1) / N;
     voxObject->blockIndices = (unsigned int *)calloc(
         voxObject->blockWidth * voxObject->blockHeight * voxObject->blockDepth,
         sizeof(unsigned int));
 
-    Palette *palette = palettes.getBlock(voxObject->paletteIndex);
+    Palette *palette = palettes->getBlock(voxObject->paletteIndex);
 
     fseek(file, headerEndLocation, SEEK_SET);
 
@@ -96,22 +155,51 @@ void loadPlyVoxObject (
         y -= minY;
         z -= minZ;
 
-        unsigned int blockX = x / VOX_BLOCK_SCALE;
-        unsigned int blockY = y  / VOX_BLOCK_SCALE;
-        unsigned int blockZ = z  / VOX_BLOCK_SCALE;
-
-        unsigned int blockLocalX = x % VOX_BLOCK_SCALE;
-        unsigned int blockLocalY = y % VOX_BLOCK_SCALE;
-        unsigned int blockLocalZ = z % VOX_BLOCK_SCALE;
-
-        size_t blockObjectIndex = 
-            blockX + blockY * voxObject->blockWidth + blockZ * voxObject->blockWidth * voxObject->blockHeight;
-        
-        if(voxObject->blockIndices[blockObjectIndex] == 0)
-            voxObject->blockIndices[blockObjectIndex] = voxBlocks.allocateBlock() + 1;
-        
-        VoxBlock *block = voxBlocks.getBlock(voxObject->blockIndices[blockObjectIndex] - 1);
-        block->voxels[voxBlockIndex(blockLocalX, blockLocalY, blockLocalZ)] = matIndex + 1;
+        setVoxel(voxObject, voxBlocks, x, y, z, matIndex + 1);
     }
     fclose(file);
 }
+
+size_t objectBlockIndex(const VoxObject *object, uint32_t x, uint32_t y, uint32_t z)
+{
+    uint32_t scale = object->blockScale;
+    return x / scale + y / scale * object->blockWidth + z / scale * object->blockWidth * object->blockHeight;
+}
+
+template<uint32_t N>
+unsigned char getVoxel(const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, uint32_t x, uint32_t y, uint32_t z)
+{
+    if (x >= N * object->blockWidth || y >= N * object->blockHeight || z >= N * object->blockDepth)
+        return 0;
+    uint32_t block = object->blockIndices[objectBlockIndex(object, x, y, z)];
+    if (block == 0)
+        return 0;
+    return voxBlocks->getBlock(block - 1)->voxels[VoxBlock<N>::index(x % N, y % N, z % N)];
+}
+
+template<uint32_t N>
+size_t setVoxel(VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, uint32_t x, uint32_t y, uint32_t z, unsigned char value)
+{
+    if (x >= N * object->blockWidth || y >= N * object->blockHeight || z >= N * object->blockDepth)
+        throw std::runtime_error("voxel is outside the vox object");
+
+    uint32_t *block = &object->blockIndices[objectBlockIndex(object, x, y, z)];
+    if (*block == 0){
+        size_t poolIndex = voxBlocks->allocateBlock();
+        memset(voxBlocks->getBlock(poolIndex), 0, sizeof(VoxBlock<N>));
+        *block = poolIndex + 1;
+    }
+    voxBlocks->getBlock(*block - 1)->voxels[VoxBlock<N>::index(x % N, y % N, z % N)] = value;
+    return *block - 1;
+}
+
+template unsigned char getVoxel<8>(const VoxObject *, MemPool<VoxBlock<8>> *, uint32_t, uint32_t, uint32_t);
+template unsigned char getVoxel<16>(const VoxObject *, MemPool<VoxBlock<16>> *, uint32_t, uint32_t, uint32_t);
+template unsigned char getVoxel<32>(const VoxObject *, MemPool<VoxBlock<32>> *, uint32_t, uint32_t, uint32_t);
+template size_t setVoxel<8>(VoxObject *, MemPool<VoxBlock<8>> *, uint32_t, uint32_t, uint32_t, unsigned char);
+template size_t setVoxel<16>(VoxObject *, MemPool<VoxBlock<16>> *, uint32_t, uint32_t, uint32_t, unsigned char);
+template size_t setVoxel<32>(VoxObject *, MemPool<VoxBlock<32>> *, uint32_t, uint32_t, uint32_t, unsigned char);
+
+template void loadPlyVoxObject<8>(char *, MemPool<VoxBlock<8>> *, MemPool<Palette> *, VoxObject *);
+template void loadPlyVoxObject<16>(char *, MemPool<VoxBlock<16>> *, MemPool<Palette> *, VoxObject *);
+template void loadPlyVoxObject<32>(char *, MemPool<VoxBlock<32>> *, MemPool<Palette> *, VoxObject *);
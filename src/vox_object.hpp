@@ -1,14 +1,52 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "memory_pool.hpp"
 
-const int VOX_BLOCK_SCALE = 16;
-const int VOX_BLOCK_POINT_COUNT = VOX_BLOCK_SCALE * VOX_BLOCK_SCALE * VOX_BLOCK_SCALE;
+const uint32_t DEFAULT_VOX_BLOCK_SCALE = 16;
 
+// Voxels inside a block are stored x fastest then y then z, unless built with
+// VOX_BLOCK_MORTON_LAYOUT (make VOX_LAYOUT=morton), which interleaves the bits
+// of x, y and z so a step along any axis stays close in memory. The renderer
+// passes the layout on to shader.comp so both always agree.
+#ifdef VOX_BLOCK_MORTON_LAYOUT
+const bool VOX_BLOCK_MORTON = true;
+#else
+const bool VOX_BLOCK_MORTON = false;
+#endif
+
+// Moves bit i of the low 10 bits of v to bit 3i.
+constexpr uint32_t spreadMortonBits(uint32_t v){
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    return (v | (v << 2)) & 0x09249249;
+}
+
+// Offset of a voxel in a cube of side scale, in either layout. In Morton order
+// the offset does not depend on the side, so mip levels share it.
+constexpr size_t voxBlockOffset(uint32_t x, uint32_t y, uint32_t z, uint32_t scale){
+    return VOX_BLOCK_MORTON ?
+        spreadMortonBits(x) | spreadMortonBits(y) << 1 | spreadMortonBits(z) << 2 :
+        x + y * scale + z * scale * scale;
+}
+
+// A cube of N^3 voxels laid out by voxBlockOffset. N is a power of two so block
+// and voxel coordinates split with shifts and masks. Scales 8, 16 and 32 are
+// instantiated.
+template<uint32_t N>
 struct VoxBlock{
-    unsigned char voxels[VOX_BLOCK_POINT_COUNT];
+    static constexpr uint32_t SCALE = N;
+    static constexpr uint32_t POINT_COUNT = N * N * N;
+    static_assert((N & (N - 1)) == 0 && N >= 4, "vox block scale must be a power of two of at least 4");
+
+    unsigned char voxels[POINT_COUNT];
+
+    static constexpr size_t index(uint32_t x, uint32_t y, uint32_t z){
+        return voxBlockOffset(x, y, z, N);
+    }
 };
 
 struct Material{
@@ -24,14 +62,43 @@ struct Palette{
 
 struct VoxObject{
     uint32_t paletteIndex;
+    // Side of each block in voxels, the N its VoxBlocks were built with.
+    uint32_t blockScale;
     uint32_t blockWidth;
     uint32_t blockHeight;
     uint32_t blockDepth;
     uint32_t *blockIndices;
 };
 
+bool isSupportedVoxBlockScale(uint32_t blockScale);
+// Levels below a block of side blockScale down to a single voxel.
+uint32_t voxBlockMipCount(uint32_t blockScale);
+// Bytes of mip levels 1 to mipCount of one block, padded to whole words.
+uint32_t voxBlockMipSize(uint32_t blockScale, uint32_t mipCount);
+// Writes mip levels 1 to mipCount of a block's voxels into mips, finest first,
+// each laid out by voxBlockOffset.
+// A cell takes the most common material of the 8 below it and is only empty if
+// all of them are, so thin surfaces do not vanish at a distance.
+void buildVoxBlockMips(const unsigned char *voxels, uint32_t blockScale, uint32_t mipCount, unsigned char *mips);
+
+// The voxels of every block in the pool back to back, the form the renderers
+// read blocks in whatever their scale.
+template<uint32_t N>
+const unsigned char *voxBlockBytes(MemPool<VoxBlock<N>> *voxBlocks){
+    return voxBlocks->getBlock(0)->voxels;
+}
+
+// Voxel at x, y, z of object, 0 if empty or outside it.
+template<uint32_t N>
+unsigned char getVoxel(const VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, uint32_t x, uint32_t y, uint32_t z);
+// Sets the voxel at x, y, z of object, allocating a cleared block if there is
+// none yet. Returns the pool index of the block written, for updateBlock.
+template<uint32_t N>
+size_t setVoxel(VoxObject *object, MemPool<VoxBlock<N>> *voxBlocks, uint32_t x, uint32_t y, uint32_t z, unsigned char value);
+
+template<uint32_t N>
 void loadPlyVoxObject(
     char *filename,
-    MemPool<VoxBlock> voxBlocks,
-    MemPool<Palette> palettes,
+    MemPool<VoxBlock<N>> *voxBlocks,
+    MemPool<Palette> *palettes,
     VoxObject *voxObject);
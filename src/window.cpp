@@ -6,7 +6,19 @@ GLFWwindow *createWindow(std::string title, uint32_t width, uint32_t height)
 {
     // Dont use opengl
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
     return glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
 }
+
+void framebufferResizeCallback(GLFWwindow *window, int, int)
+{
+    bool *resizedFlag = (bool *)glfwGetWindowUserPointer(window);
+    *resizedFlag = true;
+}
+
+void trackFramebufferResize(GLFWwindow *window, bool *resizedFlag)
+{
+    glfwSetWindowUserPointer(window, resizedFlag);
+    glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+}
@@ -6,3 +6,5 @@
 #include <string>
 
 GLFWwindow *createWindow(std::string title, uint32_t width, uint32_t height);
+// Sets *resizedFlag to true whenever the framebuffer of window changes size.
+void trackFramebufferResize(GLFWwindow *window, bool *resizedFlag);
@@ -0,0 +1,118 @@
+// Runs block residency's host side over a scene of mixed encodings in a
+// voxBlocks budget, the way updateBlockResidency does between frames, and checks
+// that every block the shader reports ends up resident.
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "block_residency_plan.hpp"
+
+const uint32_t BLOCK_SCALE = 8;
+const uint32_t BLOCK_SIZE = BLOCK_SCALE * BLOCK_SCALE * BLOCK_SCALE;
+
+// Fills block with materials distinct materials.
+void fillBlock(unsigned char *block, uint32_t materials)
+{
+    for (uint32_t i = 0; i < BLOCK_SIZE; i++)
+        block[i] = 1 + i % materials;
+}
+
+// Feedback with a bit set for each of blocks.
+std::vector<uint32_t> reportBlocks(uint32_t blockCount, const std::vector<uint32_t> &blocks)
+{
+    std::vector<uint32_t> feedback((blockCount + 31) / 32, 0);
+    for (uint32_t block : blocks)
+        feedback[block / 32] |= 1u << (block % 32);
+    return feedback;
+}
+
+std::vector<uint32_t> blockRange(uint32_t first, uint32_t end)
+{
+    std::vector<uint32_t> blocks;
+    for (uint32_t block = first; block < end; block++)
+        blocks.push_back(block);
+    return blocks;
+}
+
+// Whether the resident blocks' slots overlap or leave the heap.
+bool slotsOverlap(const VoxBlockHeap *heap, const std::vector<VoxBlockSlot> &slots)
+{
+    std::vector<bool> used(heap->capacity, false);
+    for (VoxBlockSlot slot : slots){
+        if (slot == VOX_BLOCK_SLOT_NONE)
+            continue;
+        uint32_t offset = voxBlockSlotOffset(slot);
+        uint32_t words = encodedVoxBlockWords(heap->blockScale, voxBlockSlotEncoding(slot));
+        if (offset + words > heap->top)
+            return true;
+        for (uint32_t word = offset; word < offset + words; word++){
+            if (used[word])
+                return true;
+            used[word] = true;
+        }
+    }
+    return false;
+}
+
+int main()
+{
+    // 2, 16 and 256 material blocks, 17, 68 and 128 words each.
+    const uint32_t blockCount = 64;
+    std::vector<unsigned char> voxBlocks(blockCount * BLOCK_SIZE);
+    for (uint32_t block = 0; block < blockCount; block++)
+        fillBlock(&voxBlocks[block * BLOCK_SIZE], block < 32 ? 2 : block < 48 ? 16 : 255);
+
+    // Room for the 16 raw blocks and not a word more, so they only fit once every
+    // smaller block is gone and the runs they leave are merged.
+    VoxBlockHeap heap = createVoxBlockHeap(
+        BLOCK_SCALE, 16 * encodedVoxBlockWords(BLOCK_SCALE, VOX_BLOCK_ENCODING_RAW));
+    std::vector<VoxBlockSlot> slots(blockCount, VOX_BLOCK_SLOT_NONE);
+    std::vector<uint32_t> lastNeeded(blockCount, 0);
+    std::vector<uint32_t> residentBlocks;
+
+    ResidencyOptions options{};
+    options.readbackInterval = 1;
+    options.evictAfterReadbacks = 4;
+    options.maxLoadsPerReadback = 1024;
+    options.budgetMegabytes = 0;
+
+    // The camera looks at the small blocks, then only at the raw ones, then at a
+    // mix of all three. Each view fits the budget.
+    std::vector<std::vector<uint32_t>> views = {blockRange(0, 48), blockRange(48, 64), blockRange(24, 54)};
+    uint32_t readback = 0;
+    int failures = 0;
+    for (size_t view = 0; view < views.size(); view++){
+        std::vector<uint32_t> feedback = reportBlocks(blockCount, views[view]);
+        for (uint32_t frame = 0; frame < 3; frame++){
+            ResidencyPlan plan = planBlockResidency(
+                options, ++readback, feedback, voxBlocks.data(), residentBlocks, &lastNeeded, &heap, &slots);
+            // updateBlocks moves each loaded or moved block into a slot of the same size.
+            std::vector<uint32_t> uploaded = plan.loaded;
+            uploaded.insert(uploaded.end(), plan.moved.begin(), plan.moved.end());
+            for (uint32_t block : uploaded){
+                freeVoxBlockSlot(&heap, slots[block]);
+                slots[block] = allocateVoxBlockSlot(
+                    &heap, chooseVoxBlockEncoding(&voxBlocks[block * BLOCK_SIZE], BLOCK_SCALE));
+            }
+            residentBlocks = plan.residentBlocks;
+            if (slotsOverlap(&heap, slots)){
+                printf("view %zu readback %u: resident blocks overlap in the heap\n", view, readback);
+                failures++;
+            }
+        }
+
+        uint32_t missing = 0;
+        for (uint32_t block : views[view])
+            missing += slots[block] == VOX_BLOCK_SLOT_NONE;
+        if (missing != 0){
+            printf("view %zu: %u of %zu reported blocks are not resident\n", view, missing, views[view].size());
+            failures++;
+        }
+    }
+
+    if (failures != 0)
+        return 1;
+    printf("block residency test passed\n");
+    return 0;
+}